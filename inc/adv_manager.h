@@ -0,0 +1,38 @@
+#pragma once
+#include <stdint.h>
+#include "mem_cache.h"
+
+/*
+ * Manufacturer specific data of the advertisement (little-endian). With
+ * CONFIG_BOND readings only go over encrypted links, so the latest one is
+ * left out and the summary ends after the backlog.
+ */
+typedef struct __attribute__((packed)) {
+    uint16_t company;                 /* CONFIG_ADV_MANAGER_COMPANY_ID */
+    uint8_t flags;                    /* ADV_SUMMARY_FLAG_* */
+    uint16_t backlog;                 /* Samples waiting in RAM and flash, saturated */
+#if !defined(CONFIG_BOND)
+    uint32_t seq;                     /* Sequence number of the latest sample */
+    int16_t temp[TEMP_SAMPLE_LEN];    /* Latest temperatures in 0.01 degC */
+#endif /* !CONFIG_BOND */
+} adv_summary_t;
+
+#define ADV_SUMMARY_FLAG_URGENT  0x01   /* Backlog reached the threshold, advertising fast */
+#define ADV_SUMMARY_FLAG_FLASH   0x02   /* Part of the backlog is in the flash tier */
+#define ADV_SUMMARY_FLAG_LATEST  0x04   /* seq and temp hold a reading, never with CONFIG_BOND */
+
+/* temp[] value of a NaN reading */
+#define ADV_SUMMARY_TEMP_INVALID INT16_MIN
+
+/**
+ * @brief Start connectable advertising.
+ *
+ * Advertises fast while the backlog is at least
+ * CONFIG_ADV_MANAGER_BACKLOG_THRESHOLD samples and slowly otherwise, and
+ * refreshes the manufacturer data summary every
+ * CONFIG_ADV_MANAGER_CHECK_INTERVAL_MS until a central connects.
+ *
+ * @return 0 on success, -EALREADY if advertising is running, or a
+ *         negative error code from bt_le_adv_start().
+ */
+int adv_manager_start(void);
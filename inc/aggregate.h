@@ -0,0 +1,106 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/bluetooth/gatt.h>
+#include "mem_cache.h"
+
+/* What the sampler hands to the cache */
+enum {
+    AGGREGATE_MODE_RAW,       /* Raw samples only, aggregation idle */
+    AGGREGATE_MODE_SUMMARY,   /* One summary record per window instead of the raw samples */
+    AGGREGATE_MODE_HYBRID,    /* Raw samples, summaries on the Aggregate Summary characteristic */
+    AGGREGATE_MODE_COUNT,
+};
+
+/* Runtime window limits in samples, match the CONFIG_AGGREGATE_WINDOW range */
+#define AGGREGATE_WINDOW_MIN 2U
+#define AGGREGATE_WINDOW_MAX 1024U
+
+/*
+ * A summary is a regular sensor_sample_t. IMU word i of a raw sample is
+ * channel i % CONFIG_AGGREGATE_CHANNELS; in a summary the IMU words hold
+ * per-channel statistics over the window, starting at the indices below,
+ * followed by the number of samples summarized. The timestamp and the
+ * temperatures are those of the last sample of the window.
+ *
+ * Records are numbered as they are stored, so the sequence numbers of the
+ * data stream stay contiguous in every mode; summaries notified in hybrid
+ * mode count on their own. Summary records look like raw samples, clients
+ * tell them apart by SAMPLE_FORMAT_FLAG_SUMMARY and the first_seq of the
+ * Aggregate Control characteristic.
+ */
+#define AGGREGATE_IMU_MIN    0
+#define AGGREGATE_IMU_MAX    (1 * CONFIG_AGGREGATE_CHANNELS)
+#define AGGREGATE_IMU_MEAN   (2 * CONFIG_AGGREGATE_CHANNELS)   /* Rounded */
+#define AGGREGATE_IMU_RMS    (3 * CONFIG_AGGREGATE_CHANNELS)   /* Rounded */
+#define AGGREGATE_IMU_COUNT  (4 * CONFIG_AGGREGATE_CHANNELS)
+
+/**
+ * @brief Pass a burst of samples through the aggregation stage.
+ *
+ * Called by the sampling thread between the FIFO read and the cache. In
+ * summary mode the burst is replaced, in place, by the summaries of the
+ * windows it completed; otherwise only the sequence numbers of the
+ * samples are rewritten. Either way the records come back numbered from
+ * @p seq on.
+ *
+ * @param samples Samples, oldest first.
+ * @param n       Number of samples.
+ * @param seq     Sequence number of the first record to store.
+ * @return Number of records in @p samples to store in the cache.
+ */
+size_t aggregate_feed(sensor_sample_t *samples, size_t n, uint32_t seq);
+
+/**
+ * @brief Change the aggregation mode and window.
+ *
+ * Applied by the sampling thread on its next burst. The window in
+ * progress is discarded. Starts out in raw mode with
+ * CONFIG_AGGREGATE_WINDOW samples.
+ *
+ * @param mode   AGGREGATE_MODE_*.
+ * @param window Samples per summary.
+ * @return 0 on success, or -EINVAL if either is out of range.
+ */
+int aggregate_set_mode(uint8_t mode, uint16_t window);
+
+/**
+ * @brief Get the aggregation mode.
+ *
+ * @return AGGREGATE_MODE_*, as last requested.
+ */
+uint8_t aggregate_get_mode(void);
+
+/**
+ * @brief Get the aggregation window.
+ *
+ * @return Samples per summary, as last requested.
+ */
+uint16_t aggregate_get_window(void);
+
+/**
+ * @brief Get the mode of the records handed to the cache.
+ *
+ * Follows aggregate_get_mode() once the sampling thread applied it.
+ *
+ * @param first_seq Set to the sequence number of the first record stored
+ *                  in that mode, may be NULL.
+ * @return AGGREGATE_MODE_* the sampling thread applied last.
+ */
+uint8_t aggregate_get_stored_mode(uint32_t *first_seq);
+
+/**
+ * @brief Get the most recent summary.
+ *
+ * @param out Filled with a copy of the summary.
+ * @return true on success, false if no window has completed yet.
+ */
+bool aggregate_get_summary(sensor_sample_t *out);
+
+/**
+ * @brief Set the characteristic summaries are notified on in hybrid mode.
+ *
+ * @param attr The Aggregate Summary characteristic value attribute.
+ */
+void aggregate_notify_init(const struct bt_gatt_attr *attr);
@@ -0,0 +1,34 @@
+#pragma once
+#include <stdint.h>
+
+/**
+ * @brief Advertising filter policy changed callback.
+ *
+ * Called when bond_adv_options() would return a different value, i.e.
+ * the first peer bonded or the pairing window closed, so a running
+ * advertiser should be restarted. Called from the system work queue or
+ * the Bluetooth RX thread; must not block.
+ */
+typedef void (*bond_policy_cb_t)(void);
+
+/**
+ * @brief Load the bonds from settings and open the pairing window.
+ *
+ * Must be called after bt_enable() and before advertising starts. Puts
+ * every bonded peer on the filter accept list.
+ *
+ * @param changed Called when the advertising filter policy changes.
+ * @return 0 on success or a negative error code from settings_load().
+ */
+int bond_load(bond_policy_cb_t changed);
+
+/**
+ * @brief Get the options to add to the next advertiser.
+ *
+ * Call right before bt_le_adv_start(); the accept list is brought up to
+ * date first if a bond could not be added to it earlier.
+ *
+ * @return BT_LE_ADV_OPT_FILTER_CONN once a peer is bonded and the
+ *         pairing window is closed, 0 otherwise.
+ */
+uint32_t bond_adv_options(void);
@@ -0,0 +1,25 @@
+#pragma once
+#include <stddef.h>
+#include <string.h>
+
+#if defined(CONFIG_DMA_COPY)
+/**
+ * @brief Copy a block of memory, with DMA for large blocks.
+ *
+ * Blocks of at least CONFIG_DMA_COPY_THRESHOLD bytes go through a
+ * memory-to-memory DMA channel while the calling thread sleeps; shorter
+ * ones, calls from ISR context, destinations that do not cover whole data
+ * cache lines and failed transfers use memcpy(). The areas must not
+ * overlap.
+ *
+ * @param dst Destination.
+ * @param src Source.
+ * @param len Number of bytes.
+ */
+void dma_copy(void *dst, const void *src, size_t len);
+#else
+static inline void dma_copy(void *dst, const void *src, size_t len)
+{
+    memcpy(dst, src, len);
+}
+#endif /* CONFIG_DMA_COPY */
@@ -0,0 +1,51 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "mem_cache.h"
+
+/* Flash tier fill level, see flash_tier_get_level() */
+typedef struct {
+    uint32_t stored;     /* Samples held in flash, not yet restored */
+    uint32_t capacity;   /* Approximate number of samples the partition holds */
+    uint32_t dropped;    /* Samples lost because flash was full */
+} flash_tier_level_t;
+
+/**
+ * @brief Move the oldest samples of the RAM cache to flash.
+ *
+ * Must be called by the cache consumer while it is not transmitting. Pops
+ * one batch of CONFIG_FLASH_TIER_BATCH samples once the cache holds at
+ * least CONFIG_FLASH_TIER_SPILL_THRESHOLD, and hands it to the flash tier
+ * thread. Does nothing while the previous batch is still being written,
+ * or at all if the partition could not be mounted.
+ *
+ * @return true if a batch was handed over.
+ */
+bool flash_tier_spill(void);
+
+/**
+ * @brief Get the oldest samples restored from flash.
+ *
+ * Restored samples are older than anything in the RAM cache and must be
+ * sent first.
+ *
+ * @param samples Set to the restored samples.
+ * @return Number of restored samples available, 0 if the flash tier is
+ *         empty or not mounted, or -EAGAIN if flash still holds older samples that are
+ *         not restored yet (the TX engine is kicked once they are).
+ */
+int flash_tier_peek(const sensor_sample_t **samples);
+
+/**
+ * @brief Release the @p n oldest samples obtained from flash_tier_peek().
+ *
+ * @param n Number of samples sent, at most the value flash_tier_peek() returned.
+ */
+void flash_tier_commit(size_t n);
+
+/**
+ * @brief Get the flash tier fill level.
+ *
+ * @param level Filled with the current counters.
+ */
+void flash_tier_get_level(flash_tier_level_t *level);
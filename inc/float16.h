@@ -0,0 +1,45 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Widen an IEEE-754 binary16 value to binary64.
+ *
+ * Builds the binary64 bit pattern directly from the sign, exponent and
+ * mantissa fields, so no floating-point arithmetic or libm call is
+ * involved. Exact for every input, including subnormals, infinities and
+ * NaN payloads.
+ *
+ * @param h Raw binary16 bits.
+ * @return The same value as a double.
+ */
+double float16_to_double(uint16_t h);
+
+/**
+ * @brief Widen an IEEE-754 binary16 value to binary32.
+ *
+ * Same as float16_to_double(), without the 64-bit patterns soft-float
+ * targets pay extra for.
+ *
+ * @param h Raw binary16 bits.
+ * @return The same value as a float.
+ */
+float float16_to_float(uint16_t h);
+
+/**
+ * @brief Widen an array of binary16 values to binary64.
+ *
+ * @param in  Raw binary16 bits.
+ * @param out Destination, @p n doubles.
+ * @param n   Number of values.
+ */
+void float16_to_double_n(const uint16_t *in, double *out, size_t n);
+
+/**
+ * @brief Widen an array of binary16 values to binary32.
+ *
+ * @param in  Raw binary16 bits.
+ * @param out Destination, @p n floats.
+ * @param n   Number of values.
+ */
+void float16_to_float_n(const uint16_t *in, float *out, size_t n);
@@ -0,0 +1,69 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "mem_cache.h"
+
+/* Record flag: IMU words are absolute values instead of deltas */
+#define IMU_CODEC_FLAG_KEYFRAME 0x01
+
+/* Worst-case varint length of one IMU word or delta (7 payload bits per byte) */
+#define IMU_CODEC_WORD_MAX_LEN (((sizeof(((sensor_sample_t *)0)->imu[0]) * 8) + 1 + 6) / 7)
+
+/* Worst-case varint length of a 32-bit header field or its delta */
+#define IMU_CODEC_HDR_FIELD_MAX_LEN 5
+
+/* Worst-case encoded record size: flags + seq + timestamp + varint per IMU word + raw temps */
+#define IMU_CODEC_MAX_LEN \
+    (1 + (2 * IMU_CODEC_HDR_FIELD_MAX_LEN) + (IMU_SAMPLE_LEN * IMU_CODEC_WORD_MAX_LEN) + \
+     sizeof(((sensor_sample_t *)0)->temp))
+
+/* Delta encoder/decoder state. Encoder and decoder each keep their own. */
+typedef struct {
+    sample_hdr_t prev_hdr;               /* Header of the previous record */
+    sample_imu_t prev[IMU_SAMPLE_LEN];   /* IMU words of the previous record */
+    uint16_t since_key;                  /* Records since the last keyframe */
+    bool synced;                         /* Decoder only: a keyframe has been seen */
+} imu_codec_t;
+
+/**
+ * @brief Reset a codec state.
+ *
+ * The next encoded record is a keyframe; a decoder drops delta records
+ * until it sees one.
+ *
+ * @param codec Codec state to reset.
+ */
+void imu_codec_reset(imu_codec_t *codec);
+
+/**
+ * @brief Encode one sample as a delta or keyframe record.
+ *
+ * The sequence number and timestamp are stored as varints of their
+ * forward difference to the previous record, each IMU word as the
+ * zigzag-varint of its difference (a keyframe stores plain values;
+ * compact samples wrap it at 16 bits, a no-op for 12-bit readings);
+ * temperatures are copied verbatim. Runs in a bounded number of steps and never allocates.
+ *
+ * @param codec  Encoder state, only advanced if the record fits.
+ * @param sample Sample to encode.
+ * @param out    Destination buffer.
+ * @param cap    Size of @p out in bytes.
+ * @return Encoded length in bytes, or 0 if the record does not fit in @p cap.
+ */
+size_t imu_codec_encode(imu_codec_t *codec, const sensor_sample_t *sample,
+                        uint8_t *out, size_t cap);
+
+/**
+ * @brief Decode one record produced by imu_codec_encode().
+ *
+ * @param codec  Decoder state.
+ * @param in     Encoded record.
+ * @param len    Bytes available at @p in.
+ * @param sample Decoded sample.
+ * @param used   Set to the record length, so the caller can step to the next one.
+ * @return 0 on success, -EAGAIN if a delta record arrived before any keyframe
+ *         (the record is skipped), or -EINVAL if it is truncated or malformed.
+ */
+int imu_codec_decode(imu_codec_t *codec, const uint8_t *in, size_t len,
+                     sensor_sample_t *sample, size_t *used);
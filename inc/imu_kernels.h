@@ -0,0 +1,117 @@
+#pragma once
+#include <stdint.h>
+#include "mem_cache.h"
+
+/*
+ * Kernels over the IMU block of a compact sample. Each has a portable
+ * scalar version and, on cores with the ARMv7E-M DSP extension, a SIMD
+ * version working on two 16-bit readings per instruction; the SIMD one
+ * is picked at compile time. Both give bit-identical results for the
+ * 12-bit readings of the compact format.
+ */
+
+#if defined(CONFIG_IMU_SIMD) && defined(__ARM_FEATURE_DSP)
+#define IMU_KERNEL_SIMD 1
+#else
+#define IMU_KERNEL_SIMD 0
+#endif /* CONFIG_IMU_SIMD && __ARM_FEATURE_DSP */
+
+/* Most channels imu_kernel_reduce() splits a sample into */
+#define IMU_KERNEL_MAX_CHANNELS 4
+
+/* Statistics of the readings of one sample, per channel */
+typedef struct {
+    uint16_t min[IMU_KERNEL_MAX_CHANNELS];
+    uint16_t max[IMU_KERNEL_MAX_CHANNELS];
+    uint32_t sum[IMU_KERNEL_MAX_CHANNELS];
+    uint32_t sumsq[IMU_KERNEL_MAX_CHANNELS];
+} imu_kernel_stats_t;
+
+/**
+ * @brief Zigzag-encoded differences of two IMU blocks, scalar version.
+ *
+ * Differences wrap at 16 bits, which for 12-bit readings is the plain
+ * difference.
+ *
+ * @param zz   Zigzag value of cur[i] - prev[i], per reading.
+ * @param cur  Readings of the current sample, 4-byte aligned.
+ * @param prev Readings of the previous sample, 4-byte aligned.
+ */
+void imu_kernel_delta_scalar(uint16_t zz[IMU_SAMPLE_LEN], const sample_imu_t cur[IMU_SAMPLE_LEN],
+                             const sample_imu_t prev[IMU_SAMPLE_LEN]);
+
+/**
+ * @brief Per-channel statistics of one IMU block, scalar version.
+ *
+ * Reading i belongs to channel i % @p channels.
+ *
+ * @param st       Minimum, maximum, sum and sum of squares of each channel.
+ * @param imu      Readings, 4-byte aligned, each below 2^12.
+ * @param channels 1 to IMU_KERNEL_MAX_CHANNELS, dividing IMU_SAMPLE_LEN.
+ */
+void imu_kernel_reduce_scalar(imu_kernel_stats_t *st, const sample_imu_t imu[IMU_SAMPLE_LEN],
+                              int channels);
+
+#if IMU_KERNEL_SIMD
+/**
+ * @brief Zigzag-encoded differences of two IMU blocks, SIMD version.
+ *
+ * @param zz   Zigzag value of cur[i] - prev[i], per reading.
+ * @param cur  Readings of the current sample, 4-byte aligned.
+ * @param prev Readings of the previous sample, 4-byte aligned.
+ */
+void imu_kernel_delta_simd(uint16_t zz[IMU_SAMPLE_LEN], const sample_imu_t cur[IMU_SAMPLE_LEN],
+                           const sample_imu_t prev[IMU_SAMPLE_LEN]);
+
+/**
+ * @brief Per-channel statistics of one IMU block, SIMD version.
+ *
+ * @param st       Minimum, maximum, sum and sum of squares of each channel.
+ * @param imu      Readings, 4-byte aligned, each below 2^12.
+ * @param channels 1, 2 or 4, dividing IMU_SAMPLE_LEN.
+ */
+void imu_kernel_reduce_simd(imu_kernel_stats_t *st, const sample_imu_t imu[IMU_SAMPLE_LEN],
+                            int channels);
+#endif /* IMU_KERNEL_SIMD */
+
+/**
+ * @brief Zigzag-encoded differences of two IMU blocks.
+ *
+ * @param zz   Zigzag value of cur[i] - prev[i], per reading.
+ * @param cur  Readings of the current sample, 4-byte aligned.
+ * @param prev Readings of the previous sample, 4-byte aligned.
+ */
+static inline void imu_kernel_delta(uint16_t zz[IMU_SAMPLE_LEN],
+                                    const sample_imu_t cur[IMU_SAMPLE_LEN],
+                                    const sample_imu_t prev[IMU_SAMPLE_LEN])
+{
+#if IMU_KERNEL_SIMD
+    imu_kernel_delta_simd(zz, cur, prev);
+#else
+    imu_kernel_delta_scalar(zz, cur, prev);
+#endif /* IMU_KERNEL_SIMD */
+}
+
+/**
+ * @brief Per-channel statistics of one IMU block.
+ *
+ * Three channels straddle the reading pairs of the SIMD kernel and always
+ * take the scalar one.
+ *
+ * @param st       Minimum, maximum, sum and sum of squares of each channel.
+ * @param imu      Readings, 4-byte aligned, each below 2^12.
+ * @param channels 1 to IMU_KERNEL_MAX_CHANNELS, dividing IMU_SAMPLE_LEN.
+ */
+static inline void imu_kernel_reduce(imu_kernel_stats_t *st,
+                                     const sample_imu_t imu[IMU_SAMPLE_LEN], int channels)
+{
+#if IMU_KERNEL_SIMD
+    if (channels == 3) {
+        imu_kernel_reduce_scalar(st, imu, channels);
+    } else {
+        imu_kernel_reduce_simd(st, imu, channels);
+    }
+#else
+    imu_kernel_reduce_scalar(st, imu, channels);
+#endif /* IMU_KERNEL_SIMD */
+}
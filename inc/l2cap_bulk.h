@@ -0,0 +1,56 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/kernel.h>
+#include <zephyr/net_buf.h>
+
+/* Bulk control point opcodes, first byte written to the control point */
+#define BULK_CP_OP_START   0x01   /* Stream the backlog, SDUs numbered from 0 */
+#define BULK_CP_OP_STOP    0x02   /* Stop streaming, live samples go back to notifications */
+#define BULK_CP_OP_RESUME  0x03   /* Stream the backlog, SDUs numbered from the le16 that follows */
+
+/* Bulk control point value returned on read (little-endian) */
+typedef struct __attribute__((packed)) {
+    uint16_t psm;        /* L2CAP PSM the bulk channel is served on */
+    uint8_t active;      /* 1 while a transfer is running */
+    uint16_t next_seq;   /* Sequence number of the next SDU */
+} bulk_cp_status_t;
+
+/**
+ * @brief Handle a write to the bulk control point.
+ *
+ * @param data Written value, opcode first.
+ * @param len  Length of @p data.
+ * @return 0 on success, -EINVAL for a malformed request, -ENOTSUP for an
+ *         unknown opcode, or -ENOTCONN if no bulk channel is connected.
+ */
+int l2cap_bulk_control(const uint8_t *data, size_t len);
+
+/**
+ * @brief Get the bulk control point value.
+ *
+ * @param status Filled with the current status.
+ */
+void l2cap_bulk_get_status(bulk_cp_status_t *status);
+
+/**
+ * @brief Allocate an SDU buffer for the bulk channel.
+ *
+ * Never blocks; the number of buffers bounds the SDUs in flight.
+ *
+ * @param cap Set to the largest SDU the peer accepts in this buffer.
+ * @return A buffer with the L2CAP headroom reserved, or NULL if all
+ *         buffers are in flight.
+ */
+struct net_buf *l2cap_bulk_alloc(size_t *cap);
+
+/**
+ * @brief Send an SDU on the bulk channel.
+ *
+ * The stack segments the SDU to the channel MPS and paces it with the
+ * peer's credits. The TX engine is kicked once it has been sent.
+ *
+ * @param buf SDU from l2cap_bulk_alloc(); consumed even on error.
+ * @return 0 on success or a negative error code.
+ */
+int l2cap_bulk_send(struct net_buf *buf);
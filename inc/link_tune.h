@@ -0,0 +1,53 @@
+#pragma once
+#include <stdint.h>
+#include <zephyr/bluetooth/conn.h>
+
+/* Negotiated link parameters, see link_tune_get_info() (little-endian) */
+typedef struct __attribute__((packed)) {
+    uint16_t interval;     /* Connection interval in 1.25 ms units */
+    uint16_t latency;      /* Peripheral latency in connection events */
+    uint16_t timeout;      /* Supervision timeout in 10 ms units */
+    uint8_t tx_phy;        /* BT_GAP_LE_PHY_* */
+    uint8_t rx_phy;        /* BT_GAP_LE_PHY_* */
+    uint16_t tx_max_len;   /* LL TX payload octets (Data Length Extension) */
+    uint16_t rx_max_len;   /* LL RX payload octets (Data Length Extension) */
+    uint16_t att_mtu;      /* Negotiated ATT MTU */
+    uint8_t profile;       /* LINK_TUNE_PROFILE_* currently requested */
+} link_tune_info_t;
+
+/* Connection parameter profiles */
+#define LINK_TUNE_PROFILE_NONE 0   /* Nothing requested yet */
+#define LINK_TUNE_PROFILE_FAST 1   /* Short interval while a backlog is pending */
+#define LINK_TUNE_PROFILE_SLOW 2   /* Long interval with peripheral latency when idle */
+
+/**
+ * @brief Start tuning a new connection.
+ *
+ * Requests the maximum data length and 2M PHY, then keeps switching the
+ * connection interval between the fast and slow profile depending on the
+ * backlog. Every connection is tuned on its own; calling this again for a
+ * connection already tuned does nothing.
+ *
+ * @param conn The connection to tune.
+ */
+void link_tune_start(struct bt_conn *conn);
+
+/**
+ * @brief Stop tuning and release the connection reference.
+ *
+ * Does nothing unless @p conn is being tuned.
+ *
+ * @param conn The connection going away.
+ */
+void link_tune_stop(struct bt_conn *conn);
+
+/**
+ * @brief Get the negotiated link parameters of a connection.
+ *
+ * Only the ATT MTU is filled in for a connection that is not tuned, the
+ * other fields are 0.
+ *
+ * @param conn The connection asking.
+ * @param info Filled with the current values.
+ */
+void link_tune_get_info(struct bt_conn *conn, link_tune_info_t *info);
@@ -1,16 +1,99 @@
 #pragma once
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <string.h>
 
-#define IMU_SAMPLE_LEN 20
-#define TEMP_SAMPLE_LEN 3
+#if defined(CONFIG_MEM_CACHE_BACKEND_SLAB)
+#include <zephyr/kernel.h>
+#endif /* CONFIG_MEM_CACHE_BACKEND_SLAB */
 
+/* Elements of each sample array, see SAMPLE_FIELDS() */
+#define IMU_SAMPLE_LEN CONFIG_SAMPLE_IMU_LEN
+#define TEMP_SAMPLE_LEN CONFIG_SAMPLE_TEMP_LEN
 
-typedef struct __attribute__((packed)) {
-    uint32_t imu[IMU_SAMPLE_LEN];
-    double temp[TEMP_SAMPLE_LEN];
+
+/* Per-sample header, lets the client detect gaps and reorders */
+typedef struct {
+    uint32_t seq;         /* Monotonic sample sequence number */
+    uint32_t timestamp;   /* k_uptime in milliseconds when sampled */
+} sample_hdr_t;
+
+#if defined(CONFIG_SAMPLE_FORMAT_COMPACT)
+typedef uint16_t sample_imu_t;    /* 12-bit IMU readings */
+typedef uint16_t sample_temp_t;   /* Raw IEEE-754 binary16 temperatures */
+#else
+typedef uint32_t sample_imu_t;
+#if defined(CONFIG_SAMPLE_TEMP_FLOAT)
+typedef float sample_temp_t;      /* Temperatures widened from binary16 */
+#else
+typedef double sample_temp_t;     /* Temperatures widened from binary16 */
+#endif /* CONFIG_SAMPLE_TEMP_FLOAT */
+#endif /* CONFIG_SAMPLE_FORMAT_COMPACT */
+
+/*
+ * Sample schema: X(name, type, len) for each array after the header, in
+ * wire order. The in-RAM sample, its wire twin and the layout checks are
+ * all generated from this list; a field with a length of 0 takes no
+ * bytes anywhere.
+ */
+#define SAMPLE_FIELDS(X) \
+    X(imu, sample_imu_t, IMU_SAMPLE_LEN) \
+    X(temp, sample_temp_t, TEMP_SAMPLE_LEN)
+
+#define SAMPLE_FIELD_DECLARE(name, type, len) type name[len];
+
+/*
+ * In-RAM sample. Naturally aligned and padded to CONFIG_SAMPLE_ALIGN, so
+ * cache slots, sample arrays and the copies between them move with
+ * aligned word accesses. Every field is at the offset it has on the
+ * wire; only the trailing padding is local, see SAMPLE_WIRE_LEN.
+ */
+typedef struct __attribute__((aligned(CONFIG_SAMPLE_ALIGN))) {
+    sample_hdr_t hdr;
+    SAMPLE_FIELDS(SAMPLE_FIELD_DECLARE)
 } sensor_sample_t;
 
+/* Wire layout of a sample, only used for its size and field offsets */
+typedef struct __attribute__((packed)) {
+    sample_hdr_t hdr;
+    SAMPLE_FIELDS(SAMPLE_FIELD_DECLARE)
+} sample_wire_t;
+
+/* Bytes of one sample on the wire and in flash: the fields without the slot
+ * padding (112 legacy, 100 legacy with float temperatures, 54 compact with
+ * the default schema) */
+#define SAMPLE_WIRE_LEN sizeof(sample_wire_t)
+
+/* True if a field sits in the RAM sample at its wire offset */
+#define SAMPLE_FIELD_AT_WIRE_OFFSET(name, type, len) \
+    && ((len) == 0 || offsetof(sensor_sample_t, name) == offsetof(sample_wire_t, name))
+
+/* True if the wire layout is a prefix of the RAM sample; checked at build time */
+#define SAMPLE_LAYOUT_GAP_FREE (1 SAMPLE_FIELDS(SAMPLE_FIELD_AT_WIRE_OFFSET))
+
+/**
+ * @brief Write a sample in its wire layout.
+ *
+ * @param buf    Destination of SAMPLE_WIRE_LEN bytes, any alignment.
+ * @param sample Sample to serialize.
+ */
+static inline void sample_serialize(void *buf, const sensor_sample_t *sample)
+{
+    memcpy(buf, sample, SAMPLE_WIRE_LEN);
+}
+
+/**
+ * @brief Read a sample from its wire layout.
+ *
+ * @param sample Sample to fill; the padding is left untouched.
+ * @param buf    Source of SAMPLE_WIRE_LEN bytes, any alignment.
+ */
+static inline void sample_deserialize(sensor_sample_t *sample, const void *buf)
+{
+    memcpy(sample, buf, SAMPLE_WIRE_LEN);
+}
+
 /**
  * @brief Push a sample into the FIFO cache.
  *
@@ -19,6 +102,19 @@ typedef struct __attribute__((packed)) {
  */
 bool mem_cache_push(const sensor_sample_t *sample);
 
+/**
+ * @brief Push a burst of samples into the FIFO cache.
+ *
+ * Cheaper than pushing one by one. Samples that do not fit are handled by
+ * the overflow policy like single pushes, so the burst may be added only
+ * partially.
+ *
+ * @param samples Samples to add, oldest first.
+ * @param n       Number of samples.
+ * @return The number of samples added.
+ */
+size_t mem_cache_push_n(const sensor_sample_t *samples, size_t n);
+
 /**
  * @brief Pop the oldest sample from the cache.
  *
@@ -27,9 +123,299 @@ bool mem_cache_push(const sensor_sample_t *sample);
  */
 bool mem_cache_pop(sensor_sample_t *out);
 
+/**
+ * @brief Pop up to @p max oldest samples from the cache in one call.
+ *
+ * Samples are written to @p out in FIFO order.
+ *
+ * @param out Array of at least @p max samples to receive the popped data.
+ * @param max Maximum number of samples to pop.
+ * @return The number of samples actually popped (0 if the cache is empty).
+ */
+size_t mem_cache_pop_n(sensor_sample_t *out, size_t max);
+
+/**
+ * @brief Reserve the next free slot for in-place writing.
+ *
+ * The producer fills the returned slot directly and then publishes it with
+ * mem_cache_commit_push(). Only one reservation may be outstanding.
+ *
+ * @return Pointer to the reserved slot, or NULL if the cache is full.
+ */
+sensor_sample_t *mem_cache_reserve(void);
+
+/**
+ * @brief Publish the slot obtained from mem_cache_reserve().
+ */
+void mem_cache_commit_push(void);
+
+/**
+ * @brief Get a pointer to the oldest sample without removing it.
+ *
+ * The slot stays valid and unchanged until mem_cache_commit_pop() is called.
+ * If the consumer does not commit, the same sample is returned by the next
+ * peek, so a failed transmission keeps the sample at the head of the FIFO.
+ *
+ * @param sample Set to the oldest sample in the cache.
+ * @return true if a sample is available, false if the cache is empty.
+ */
+bool mem_cache_peek(const sensor_sample_t **sample);
+
+/**
+ * @brief Release the sample obtained from mem_cache_peek().
+ */
+void mem_cache_commit_pop(void);
+
+/**
+ * @brief Get a pointer to the @p idx-th oldest sample without removing it.
+ *
+ * mem_cache_peek_at(0, ...) is equivalent to mem_cache_peek(). The slot
+ * stays valid until it is released with mem_cache_commit_pop_n().
+ *
+ * @param idx    Position from the head of the FIFO.
+ * @param sample Set to the requested sample.
+ * @return true if the sample exists, false if @p idx is past the newest sample.
+ */
+bool mem_cache_peek_at(size_t idx, const sensor_sample_t **sample);
+
+/**
+ * @brief Copy up to @p max oldest samples without removing them.
+ *
+ * Bulk counterpart of mem_cache_peek(). The samples stay in the cache until
+ * released with mem_cache_commit_pop_n().
+ *
+ * @param out Array of at least @p max samples to receive the data.
+ * @param max Maximum number of samples to copy.
+ * @return The number of samples copied (0 if the cache is empty).
+ */
+size_t mem_cache_peek_n(sensor_sample_t *out, size_t max);
+
+/**
+ * @brief Release the @p n oldest samples.
+ *
+ * @param n Number of samples to release, at most mem_cache_count().
+ */
+void mem_cache_commit_pop_n(size_t n);
+
 /**
  * @brief Get the current count of samples in the cache.
  *
  * @return The number of samples currently stored in the cache.
  */
 size_t mem_cache_count(void);
+
+/* Overflow counters, see CONFIG_MEM_CACHE_OVERFLOW */
+typedef struct {
+    uint32_t dropped;     /* Samples (records) lost because the cache was full */
+    uint32_t decimated;   /* Samples thinned out by the decimate policy */
+} mem_cache_stats_t;
+
+/**
+ * @brief Keep the oldest samples in place while reading them.
+ *
+ * The drop-oldest and decimate policies discard old samples from the
+ * producer side. A consumer that holds pointers from mem_cache_peek() or
+ * mem_cache_peek_at() must pin the cache until it has committed, so that
+ * overflow falls back to rejecting the newest sample meanwhile. No-op with
+ * the reject policy.
+ */
+void mem_cache_pin(void);
+
+/**
+ * @brief Release a pin taken with mem_cache_pin().
+ */
+void mem_cache_unpin(void);
+
+/**
+ * @brief Get the overflow counters.
+ *
+ * @param stats Filled with the current counters.
+ */
+void mem_cache_get_stats(mem_cache_stats_t *stats);
+
+#if defined(CONFIG_MEM_CACHE_ALERT)
+/*
+ * Alert stream. Samples that crossed an alert threshold are copied into a
+ * ring of their own, CONFIG_MEM_CACHE_ALERT_SIZE deep, next to the bulk
+ * cache above, and are read ahead of it. Consumers track their position by
+ * sequence number, so the ring needs no pinning. All calls are safe from
+ * any context.
+ */
+
+/**
+ * @brief Queue a copy of a sample on the alert stream.
+ *
+ * @param sample The sample that raised the alert.
+ * @return true if it was queued without loss, false if the oldest alert
+ *         was dropped to make room.
+ */
+bool mem_cache_alert_push(const sensor_sample_t *sample);
+
+/**
+ * @brief Copy the oldest alerts newer than a consumer's position.
+ *
+ * @param synced   false to start at the oldest alert held.
+ * @param last_seq Sequence number of the last alert the consumer got.
+ * @param out      Array of at least @p max samples to receive the alerts.
+ * @param max      Maximum number of alerts to copy.
+ * @return The number of alerts copied.
+ */
+size_t mem_cache_alert_peek(bool synced, uint32_t last_seq, sensor_sample_t *out, size_t max);
+
+/**
+ * @brief Release the alerts up to and including @p seq.
+ *
+ * @param seq Sequence number of the newest alert every consumer got.
+ */
+void mem_cache_alert_release(uint32_t seq);
+
+/**
+ * @brief Get the number of alerts held.
+ *
+ * @return Alerts not released yet.
+ */
+size_t mem_cache_alert_count(void);
+#endif /* CONFIG_MEM_CACHE_ALERT */
+
+#if defined(CONFIG_MEM_CACHE_BACKEND_ARENA)
+/*
+ * Variable-length record API, byte arena backend only.
+ *
+ * The sample API above keeps working on the arena, storing each
+ * sensor_sample_t as one record; mem_cache_count() then counts records.
+ * Records are released with mem_cache_commit_pop()/mem_cache_commit_pop_n().
+ */
+
+/**
+ * @brief Copy a record into the cache.
+ *
+ * @param rec Record payload.
+ * @param len Payload length in bytes.
+ * @return true if the record was added, false if the arena is full.
+ */
+bool mem_cache_push_record(const void *rec, size_t len);
+
+/**
+ * @brief Reserve contiguous space for a record of up to @p max_len bytes.
+ *
+ * Lets a producer encode straight into the arena when the final length is
+ * only known afterwards. Only one reservation may be outstanding.
+ *
+ * @param max_len Largest payload the producer may write.
+ * @return Pointer to the payload area, or NULL if the arena is full.
+ */
+uint8_t *mem_cache_reserve_record(size_t max_len);
+
+/**
+ * @brief Publish the record obtained from mem_cache_reserve_record().
+ *
+ * @param len Actual payload length, at most the reserved size.
+ */
+void mem_cache_commit_push_record(size_t len);
+
+/**
+ * @brief Get the oldest record without removing it.
+ *
+ * @param rec Set to the record payload, valid until it is released.
+ * @return Payload length, or 0 if the cache is empty.
+ */
+size_t mem_cache_peek_record(const uint8_t **rec);
+
+/**
+ * @brief Get the @p idx-th oldest record without removing it.
+ *
+ * @param idx Position from the head of the FIFO.
+ * @param rec Set to the record payload, valid until it is released.
+ * @return Payload length, or 0 if @p idx is past the newest record.
+ */
+size_t mem_cache_peek_record_at(size_t idx, const uint8_t **rec);
+
+/**
+ * @brief Pop the oldest record.
+ *
+ * @param buf Destination buffer.
+ * @param cap Size of @p buf in bytes.
+ * @return Payload length, or 0 if the cache is empty or the record does
+ *         not fit in @p cap (it is then left in place).
+ */
+size_t mem_cache_pop_record(void *buf, size_t cap);
+#endif /* CONFIG_MEM_CACHE_BACKEND_ARENA */
+
+#if defined(CONFIG_MEM_CACHE_BACKEND_SLAB)
+/*
+ * Runtime capacity, slab backend only.
+ *
+ * Samples live in blocks of CONFIG_CACHE_BLOCK_SAMPLES from a k_mem_slab
+ * pool shared with other subsystems. The cache takes blocks as it fills,
+ * up to its current capacity, and hands them back as they drain, keeping
+ * CONFIG_CACHE_MIN_BLOCKS for itself. Not for ISR context.
+ */
+
+/* Bytes of one pool block */
+#define MEM_CACHE_POOL_BLOCK_LEN (CONFIG_CACHE_BLOCK_SAMPLES * sizeof(sensor_sample_t))
+
+/**
+ * @brief Smallest capacity mem_cache_set_capacity() accepts.
+ *
+ * @return Samples in the blocks the cache always keeps.
+ */
+static inline size_t mem_cache_capacity_min(void)
+{
+    return CONFIG_CACHE_MIN_BLOCKS * CONFIG_CACHE_BLOCK_SAMPLES;
+}
+
+/**
+ * @brief Largest capacity mem_cache_set_capacity() accepts.
+ *
+ * @return Samples in CONFIG_CACHE_MAX_BLOCKS blocks.
+ */
+static inline size_t mem_cache_capacity_max(void)
+{
+    return CONFIG_CACHE_MAX_BLOCKS * CONFIG_CACHE_BLOCK_SAMPLES;
+}
+
+/**
+ * @brief Change the number of samples the cache may hold.
+ *
+ * Shrinking below the current fill level drops nothing: new samples are
+ * treated as overflow until the consumer has drained the excess.
+ *
+ * @param samples New capacity.
+ * @return 0 on success, or -EINVAL if @p samples is outside
+ *         [mem_cache_capacity_min(), mem_cache_capacity_max()].
+ */
+int mem_cache_set_capacity(size_t samples);
+
+/**
+ * @brief Get the number of samples the cache may hold.
+ *
+ * @return Current capacity, mem_cache_capacity_max() after boot.
+ */
+size_t mem_cache_capacity(void);
+
+/**
+ * @brief Get the number of pool blocks the cache holds.
+ *
+ * @return Blocks in use and kept in spare.
+ */
+size_t mem_cache_blocks(void);
+
+/**
+ * @brief Take a block from the shared pool.
+ *
+ * If the pool is dry the cache stops growing: its writes fail as if it
+ * were full.
+ *
+ * @param timeout How long to wait for a block to be freed.
+ * @return The block, MEM_CACHE_POOL_BLOCK_LEN bytes aligned for a
+ *         sensor_sample_t, or NULL on timeout.
+ */
+void *mem_cache_pool_alloc(k_timeout_t timeout);
+
+/**
+ * @brief Return a block taken with mem_cache_pool_alloc().
+ *
+ * @param block The block.
+ */
+void mem_cache_pool_free(void *block);
+#endif /* CONFIG_MEM_CACHE_BACKEND_SLAB */
@@ -0,0 +1,94 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "mem_cache.h"
+
+/* Pipeline stages of a sample, each with a latency histogram */
+enum {
+    PROFILE_STAGE_ACQUIRE,   /* Sampler trigger to cache push */
+    PROFILE_STAGE_QUEUED,    /* Cache push to its notification or bulk SDU being queued */
+    PROFILE_STAGE_LINK,      /* Notification queued to its completion callback */
+    PROFILE_STAGE_COUNT,
+};
+
+/* Subsystems whose CPU time is accounted */
+enum {
+    PROFILE_CPU_SAMPLER,     /* Sampling thread: FIFO drain, aggregation, cache push */
+    PROFILE_CPU_TX,          /* TX engine drain passes */
+    PROFILE_CPU_FLASH,       /* Flash tier writes and restores */
+    PROFILE_CPU_COUNT,
+};
+
+/**
+ * @brief Stamp a sampler trigger.
+ *
+ * Only the first trigger since the sampling thread last woke up is kept.
+ * Safe to call from any context, including ISRs.
+ */
+void profile_trigger(void);
+
+/**
+ * @brief Take the stamp of the trigger that woke the sampling thread.
+ *
+ * @return Cycle count of the trigger, or the current one if none was stamped.
+ */
+uint32_t profile_wakeup(void);
+
+/**
+ * @brief Stamp samples that were just pushed into the cache.
+ *
+ * Adds their acquire span and starts their queued span.
+ *
+ * @param trigger Stamp from profile_wakeup().
+ * @param samples The samples, with their sequence numbers assigned.
+ * @param n       Number of samples.
+ */
+void profile_stored(uint32_t trigger, const sensor_sample_t *samples, size_t n);
+
+/**
+ * @brief End the queued span of a sample handed to the stack.
+ *
+ * Spans are counted once per connection the sample went to. Samples no
+ * longer tracked, e.g. restored from flash, are ignored.
+ *
+ * @param seq Sequence number of the sample.
+ */
+void profile_queued(uint32_t seq);
+
+/**
+ * @brief Start the link span of a notification about to be queued.
+ *
+ * @param slot Connection index.
+ */
+void profile_link_begin(uint8_t slot);
+
+/**
+ * @brief Forget the span started last, its notification was not queued.
+ *
+ * @param slot Connection index.
+ */
+void profile_link_cancel(uint8_t slot);
+
+/**
+ * @brief End the link span of the oldest notification in flight.
+ *
+ * Completions arrive in queueing order. Safe to call from any context.
+ *
+ * @param slot Connection index.
+ */
+void profile_link_end(uint8_t slot);
+
+/**
+ * @brief Forget all spans of a connection, for a new subscription.
+ *
+ * @param slot Connection index.
+ */
+void profile_link_reset(uint8_t slot);
+
+/**
+ * @brief Account CPU time to a subsystem.
+ *
+ * @param subsys PROFILE_CPU_* subsystem.
+ * @param cycles Time it was busy in k_cycle_get_32() cycles.
+ */
+void profile_cpu(int subsys, uint32_t cycles);
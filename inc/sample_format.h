@@ -0,0 +1,49 @@
+#pragma once
+#include <stdint.h>
+
+/* Wire format versions, reported through the format descriptor */
+#define SAMPLE_FORMAT_VERSION_LEGACY   1   /* uint32 IMU words, float64 or float32 temperatures */
+#define SAMPLE_FORMAT_VERSION_COMPACT  2   /* uint16 IMU words, raw float16 temperatures */
+
+/* Format descriptor flags */
+#define SAMPLE_FORMAT_FLAG_BATCHED     0x01   /* Notifications start with a batch header */
+#define SAMPLE_FORMAT_FLAG_IMU_DELTA   0x02   /* Samples are imu_codec delta/keyframe records */
+#define SAMPLE_FORMAT_FLAG_SEQ_TS      0x04   /* Samples start with a sample_hdr_t */
+#define SAMPLE_FORMAT_FLAG_SUMMARY     0x08   /* Records are summaries, see aggregate.h */
+
+/* Element encodings used in the format descriptor */
+enum sample_field_type {
+    SAMPLE_FIELD_UINT16 = 0,   /* Little-endian unsigned 16-bit */
+    SAMPLE_FIELD_UINT32 = 1,   /* Little-endian unsigned 32-bit */
+    SAMPLE_FIELD_FLOAT16 = 2,  /* IEEE-754 binary16 */
+    SAMPLE_FIELD_FLOAT64 = 3,  /* IEEE-754 binary64 */
+    SAMPLE_FIELD_FLOAT32 = 4,  /* IEEE-754 binary32 */
+};
+
+#if defined(CONFIG_SAMPLE_FORMAT_COMPACT)
+#define SAMPLE_FORMAT_VERSION  SAMPLE_FORMAT_VERSION_COMPACT
+#define SAMPLE_IMU_TYPE        SAMPLE_FIELD_UINT16
+#define SAMPLE_IMU_BITS        12
+#define SAMPLE_TEMP_TYPE       SAMPLE_FIELD_FLOAT16
+#else
+#define SAMPLE_FORMAT_VERSION  SAMPLE_FORMAT_VERSION_LEGACY
+#define SAMPLE_IMU_TYPE        SAMPLE_FIELD_UINT32
+#define SAMPLE_IMU_BITS        32
+#if defined(CONFIG_SAMPLE_TEMP_FLOAT)
+#define SAMPLE_TEMP_TYPE       SAMPLE_FIELD_FLOAT32
+#else
+#define SAMPLE_TEMP_TYPE       SAMPLE_FIELD_FLOAT64
+#endif /* CONFIG_SAMPLE_TEMP_FLOAT */
+#endif /* CONFIG_SAMPLE_FORMAT_COMPACT */
+
+/* Value of the format descriptor characteristic (little-endian) */
+typedef struct __attribute__((packed)) {
+    uint8_t version;        /* SAMPLE_FORMAT_VERSION_* */
+    uint8_t flags;          /* SAMPLE_FORMAT_FLAG_* */
+    uint16_t sample_size;   /* Bytes per sample on the wire */
+    uint8_t imu_len;        /* Number of IMU elements */
+    uint8_t imu_type;       /* enum sample_field_type */
+    uint8_t imu_bits;       /* Significant bits per IMU element */
+    uint8_t temp_len;       /* Number of temperature elements */
+    uint8_t temp_type;      /* enum sample_field_type */
+} sample_format_desc_t;
@@ -0,0 +1,47 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "mem_cache.h"
+
+/**
+ * @brief Wake the sampling thread to drain the sensor FIFO.
+ *
+ * Safe to call from any context, including ISRs. Meant for a sensor's
+ * data-ready or FIFO watermark interrupt; with CONFIG_SAMPLER_TIMER a
+ * periodic timer calls it as well.
+ */
+void sampler_trigger(void);
+
+/* Runtime sample interval limits, match the CONFIG_SAMPLE_INTERVAL_US range */
+#define SAMPLER_INTERVAL_MIN_US 1000U
+#define SAMPLER_INTERVAL_MAX_US 2000000000U
+
+/**
+ * @brief Change the sensor sampling interval.
+ *
+ * The sampling thread drains what the sensor buffered at the old rate,
+ * then reprograms the sensor and, with CONFIG_SAMPLER_TIMER, the poll
+ * timer. Starts out at CONFIG_SAMPLE_INTERVAL_US.
+ *
+ * @param interval_us New interval in microseconds.
+ * @return 0 on success, or -EINVAL if the interval is out of range.
+ */
+int sampler_set_interval(uint32_t interval_us);
+
+/**
+ * @brief Get the sensor sampling interval.
+ *
+ * @return Interval in microseconds.
+ */
+uint32_t sampler_get_interval(void);
+
+/**
+ * @brief Get the most recently read sample.
+ *
+ * Independent of the cache, so the sample is available even when the
+ * cache rejected it or it has already been sent.
+ *
+ * @param out Filled with a copy of the sample.
+ * @return true on success, false if nothing has been read yet.
+ */
+bool sampler_get_latest(sensor_sample_t *out);
@@ -0,0 +1,30 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "mem_cache.h"
+
+/**
+ * @brief Read a burst of samples from the sensor FIFO.
+ *
+ * Implemented by the sensor driver and called from the sampling thread
+ * only, so it may block on the bus. The driver fills in the timestamp of
+ * every sample from the sensor's own timing; the sequence number is
+ * assigned by the sampler.
+ *
+ * @param out Destination for the samples, oldest first.
+ * @param max Maximum number of samples to read.
+ * @return Number of samples read, 0 if the FIFO is empty, or a negative
+ *         error code.
+ */
+int sensor_fifo_read(sensor_sample_t *out, size_t max);
+
+/**
+ * @brief Set the sensor output data rate.
+ *
+ * Called from the sampling thread only, after the FIFO has been drained
+ * at the old rate.
+ *
+ * @param interval_us Sample interval in microseconds.
+ * @return 0 on success or a negative error code.
+ */
+int sensor_fifo_configure(uint32_t interval_us);
@@ -0,0 +1,101 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+/* Cycle histograms */
+enum {
+    TELEMETRY_HIST_SAMPLE,   /* One sampling thread wakeup: FIFO drain and cache push */
+    TELEMETRY_HIST_TX,       /* One TX engine drain pass */
+    TELEMETRY_HIST_COUNT,
+};
+
+/* Notification errors, by code */
+enum {
+    TELEMETRY_ERR_NOMEM,     /* -ENOMEM: out of host or controller buffers */
+    TELEMETRY_ERR_NOTCONN,   /* -ENOTCONN: link gone while notifying */
+    TELEMETRY_ERR_INVAL,     /* -EINVAL: not subscribed or payload too long */
+    TELEMETRY_ERR_OTHER,     /* Anything else */
+    TELEMETRY_ERR_COUNT,
+};
+
+/* Bucket i counts calls taking less than 2^(CONFIG_TELEMETRY_HIST_SHIFT + i + 1)
+ * cycles, the last one everything slower */
+#define TELEMETRY_HIST_BUCKETS 8
+
+/* Telemetry characteristic value, see telemetry_get_info() (little-endian) */
+typedef struct __attribute__((packed)) {
+    uint32_t uptime_ms;          /* Time since boot */
+    uint32_t produced;           /* Samples read from the sensor */
+    uint32_t fifo_lost;          /* Samples overwritten in the sensor FIFO */
+    uint32_t dropped;            /* Samples lost to cache overflow */
+    uint32_t decimated;          /* Samples thinned out by decimation */
+    uint32_t sent;               /* Samples sent, once per connection they went to */
+    uint32_t resent;             /* Samples sent again on a retransmit request */
+    uint32_t bytes_sent;         /* Notification and bulk SDU payload bytes */
+    uint32_t bytes_per_sec;      /* Payload throughput since the previous read */
+    uint16_t cache_count;        /* Samples (records) cached now */
+    uint16_t cache_high_water;   /* Most samples (records) cached at once */
+    uint32_t notify_err[TELEMETRY_ERR_COUNT];
+    uint32_t hist[TELEMETRY_HIST_COUNT][TELEMETRY_HIST_BUCKETS];
+} telemetry_info_t;
+
+/**
+ * @brief Count samples read from the sensor.
+ *
+ * @param n Number of samples.
+ */
+void telemetry_produced(size_t n);
+
+/**
+ * @brief Count samples the sensor overwrote before they were read.
+ *
+ * @param n Number of samples.
+ */
+void telemetry_fifo_lost(size_t n);
+
+/**
+ * @brief Record the cache fill level after a push.
+ *
+ * @param count Samples (records) in the cache.
+ */
+void telemetry_cache_level(size_t count);
+
+/**
+ * @brief Count samples handed to the stack.
+ *
+ * @param n     Number of samples.
+ * @param bytes Payload length they were sent in.
+ */
+void telemetry_sent(size_t n, size_t bytes);
+
+/**
+ * @brief Count samples retransmitted on request.
+ *
+ * @param n     Number of samples.
+ * @param bytes Payload length they were sent in.
+ */
+void telemetry_resent(size_t n, size_t bytes);
+
+/**
+ * @brief Count a failed notification.
+ *
+ * @param err Negative error code from bt_gatt_notify_cb().
+ */
+void telemetry_notify_error(int err);
+
+/**
+ * @brief Add a call to a cycle histogram.
+ *
+ * @param hist   TELEMETRY_HIST_* histogram.
+ * @param cycles Duration of the call in k_cycle_get_32() cycles.
+ */
+void telemetry_cycles(int hist, uint32_t cycles);
+
+/**
+ * @brief Get a snapshot of all counters.
+ *
+ * Also restarts the window bytes_per_sec is averaged over.
+ *
+ * @param info Filled with the current values.
+ */
+void telemetry_get_info(telemetry_info_t *info);
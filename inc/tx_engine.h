@@ -0,0 +1,130 @@
+#pragma once
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/bluetooth/l2cap.h>
+
+/**
+ * @brief Initialize the TX engine and start its work queue.
+ *
+ * @param attr The characteristic value attribute samples are notified on.
+ */
+void tx_engine_init(const struct bt_gatt_attr *attr);
+
+/**
+ * @brief Start serving a subscribed connection.
+ *
+ * Up to CONFIG_BT_MAX_CONN connections share the cache, each with its own
+ * read cursor starting at the oldest cached sample. A sample is released
+ * once every subscriber has been sent it. The engine takes its own
+ * reference on @p conn and keeps up to CONFIG_TX_ENGINE_CREDITS
+ * notifications in flight per connection.
+ *
+ * @param conn The connection to notify.
+ */
+void tx_engine_start(struct bt_conn *conn);
+
+/**
+ * @brief Stop serving a connection and release its reference.
+ *
+ * @param conn The connection to stop notifying.
+ */
+void tx_engine_stop(struct bt_conn *conn);
+
+/**
+ * @brief Signal that new samples may be available.
+ *
+ * Safe to call from any context, including ISRs.
+ */
+void tx_engine_kick(void);
+
+/**
+ * @brief Send partially filled batches on the next pass.
+ *
+ * Called on every transmit tick. Between ticks, with CONFIG_TX_BATCHING,
+ * a notification only goes out once it holds the samples expected per
+ * transmit interval or is full. Safe to call from any context, including
+ * ISRs.
+ */
+void tx_engine_flush(void);
+
+/**
+ * @brief Adapt the batch size and window period to the sample and transmit rates.
+ *
+ * The batch target is the number of samples taken per transmit interval,
+ * at least 1. A slow sample rate thus notifies every sample as soon as it
+ * is cached, a fast one fills notifications before sending them. With
+ * CONFIG_TX_SYNC_CONN_EVENT the transmit interval also spaces the windows
+ * of a connection without a backlog, replacing the transmit tick.
+ *
+ * @param sample_interval_us Sensor sampling interval in microseconds.
+ * @param tx_interval_ms     Transmit interval in milliseconds.
+ */
+void tx_engine_configure(uint32_t sample_interval_us, uint32_t tx_interval_ms);
+
+#if defined(CONFIG_L2CAP_BULK)
+/**
+ * @brief Stream the backlog over an L2CAP channel instead of notifying.
+ *
+ * Samples restored from the flash tier and the whole RAM cache go out as
+ * bulk SDUs, followed by an SDU with a record count of 0. Notifications to
+ * the channel's connection pause meanwhile and take over again for live
+ * samples afterwards; other subscribers are not affected.
+ *
+ * @param chan The connected bulk channel.
+ * @param seq  Sequence number of the first SDU.
+ */
+void tx_engine_bulk_start(struct bt_l2cap_chan *chan, uint16_t seq);
+
+/**
+ * @brief Stop a bulk transfer and return to notifications.
+ */
+void tx_engine_bulk_stop(void);
+
+/**
+ * @brief Get the bulk transfer state.
+ *
+ * @param next_seq Set to the sequence number of the next bulk SDU.
+ * @return true while a bulk transfer is running.
+ */
+bool tx_engine_bulk_status(uint16_t *next_seq);
+#endif /* CONFIG_L2CAP_BULK */
+
+#if defined(CONFIG_TX_RETRANSMIT)
+/**
+ * @brief Set the characteristic retransmitted samples are notified on.
+ *
+ * @param attr The retransmit characteristic value attribute.
+ */
+void tx_engine_retransmit_init(const struct bt_gatt_attr *attr);
+
+/**
+ * @brief Queue a range of samples for retransmission.
+ *
+ * The engine keeps copies of the last CONFIG_TX_RETRANSMIT_WINDOW released
+ * samples. Requested samples are resent as raw sensor_sample_t records on
+ * the retransmit characteristic, ahead of new notifications to @p conn;
+ * sequence numbers the cache dropped before sending are skipped.
+ *
+ * @param conn  The requesting connection.
+ * @param first Sequence number of the first sample.
+ * @param count Number of consecutive sequence numbers.
+ * @return 0 on success, -EINVAL for an empty range, -ERANGE if the range
+ *         was not sent to @p conn yet or has left the retained window, or
+ *         -ENOMEM if CONFIG_TX_RETRANSMIT_REQUESTS requests are pending.
+ */
+int tx_engine_retransmit(struct bt_conn *conn, uint32_t first, uint32_t count);
+#endif /* CONFIG_TX_RETRANSMIT */
+
+#if defined(CONFIG_MEM_CACHE_ALERT)
+/**
+ * @brief Set the characteristic alerts are notified on.
+ *
+ * Alerts are sent as raw sensor_sample_t records, as many as fit in a
+ * notification, to every started connection subscribed to @p attr. They
+ * go out ahead of retransmissions and the backlog, and a connection with
+ * more than one credit keeps its last one for them.
+ *
+ * @param attr The alert characteristic value attribute.
+ */
+void tx_engine_alert_init(const struct bt_gatt_attr *attr);
+#endif /* CONFIG_MEM_CACHE_ALERT */
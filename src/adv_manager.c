@@ -0,0 +1,284 @@
+#include <errno.h>
+#include <math.h>
+#include <zephyr/kernel.h>
+#include <zephyr/init.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+
+#include "adv_manager.h"
+#include "bond.h"
+#include "flash_tier.h"
+#include "float16.h"
+#include "mem_cache.h"
+#include "sampler.h"
+
+LOG_MODULE_REGISTER(adv_manager, LOG_LEVEL_INF);
+
+
+/******************************************************************************
+ * Data Types
+ ******************************************************************************/
+
+typedef struct {
+    struct k_work_delayable work;   /* Periodic backlog check */
+    struct k_mutex lock;            /* Protects everything below */
+    bool active;                    /* Advertising, until a central connects */
+    bool fast;                      /* Running with the fast interval */
+    adv_summary_t summary;          /* Manufacturer data, little-endian */
+} adv_manager_t;
+
+
+/******************************************************************************
+ * Static Variables
+ ******************************************************************************/
+
+static adv_manager_t adv;
+
+/* Flags and the summary; the name moved to the scan response to make room */
+static const struct bt_data ad[] = {
+    BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
+    BT_DATA(BT_DATA_MANUFACTURER_DATA, &adv.summary, sizeof(adv.summary)),
+};
+
+static const struct bt_data sd[] = {
+    BT_DATA(BT_DATA_NAME_COMPLETE, CONFIG_BT_DEVICE_NAME, sizeof(CONFIG_BT_DEVICE_NAME) - 1),
+};
+
+/* Short interval: a gateway scanning in short windows finds the node quickly */
+static const struct bt_le_adv_param fast_param =
+    BT_LE_ADV_PARAM_INIT(BT_LE_ADV_OPT_CONNECTABLE | BT_LE_ADV_OPT_ONE_TIME,
+                         CONFIG_ADV_MANAGER_FAST_INTERVAL_MIN,
+                         CONFIG_ADV_MANAGER_FAST_INTERVAL_MAX, NULL);
+
+/* Long interval: little to collect, save power */
+static const struct bt_le_adv_param slow_param =
+    BT_LE_ADV_PARAM_INIT(BT_LE_ADV_OPT_CONNECTABLE | BT_LE_ADV_OPT_ONE_TIME,
+                         CONFIG_ADV_MANAGER_SLOW_INTERVAL_MIN,
+                         CONFIG_ADV_MANAGER_SLOW_INTERVAL_MAX, NULL);
+
+BUILD_ASSERT(sizeof(adv_summary_t) + 2 + 3 <= BT_GAP_ADV_MAX_ADV_DATA_LEN,
+             "Manufacturer data summary does not fit in the advertising data");
+
+
+/******************************************************************************
+ * Summary
+ ******************************************************************************/
+
+#if !defined(CONFIG_BOND)
+/**
+ * @brief Convert a temperature to the summary's fixed-point format.
+ *
+ * @param temp Temperature in degC.
+ * @return Rounded, saturated 0.01 degC units, ADV_SUMMARY_TEMP_INVALID for NaN.
+ */
+static int16_t adv_centi(float temp)
+{
+    if (isnan(temp)) {
+        return ADV_SUMMARY_TEMP_INVALID;
+    }
+
+    float centi = temp * 100.0f;
+
+    if (centi >= INT16_MAX) {
+        return INT16_MAX;
+    }
+    if (centi <= INT16_MIN + 1) {
+        return INT16_MIN + 1;
+    }
+
+    return (int16_t)(centi < 0 ? centi - 0.5f : centi + 0.5f);
+}
+#endif /* !CONFIG_BOND */
+
+/**
+ * @brief Rebuild the manufacturer data summary.
+ *
+ * Called with the lock held.
+ *
+ * @return true if the backlog, RAM cache plus flash tier, reached
+ *         CONFIG_ADV_MANAGER_BACKLOG_THRESHOLD.
+ */
+static bool adv_summary_update(void)
+{
+    adv_summary_t *sum = &adv.summary;
+    size_t backlog = mem_cache_count();
+    uint8_t flags = 0;
+
+#if defined(CONFIG_FLASH_TIER)
+    flash_tier_level_t level;
+
+    flash_tier_get_level(&level);
+    if (level.stored) {
+        flags |= ADV_SUMMARY_FLAG_FLASH;
+    }
+    backlog += level.stored;
+#endif /* CONFIG_FLASH_TIER */
+
+    bool urgent = backlog >= CONFIG_ADV_MANAGER_BACKLOG_THRESHOLD;
+
+    if (urgent) {
+        flags |= ADV_SUMMARY_FLAG_URGENT;
+    }
+
+#if !defined(CONFIG_BOND)
+    /* Anyone in range can scan the advertisement, bonded links keep readings private */
+    sensor_sample_t latest;
+
+    if (sampler_get_latest(&latest)) {
+        flags |= ADV_SUMMARY_FLAG_LATEST;
+        sum->seq = sys_cpu_to_le32(latest.hdr.seq);
+        for (int i = 0; i < TEMP_SAMPLE_LEN; i++) {
+#if defined(CONFIG_SAMPLE_FORMAT_COMPACT)
+            float temp = float16_to_float(latest.temp[i]);
+#else
+            float temp = (float)latest.temp[i];
+#endif /* CONFIG_SAMPLE_FORMAT_COMPACT */
+
+            sum->temp[i] = sys_cpu_to_le16(adv_centi(temp));
+        }
+    }
+#endif /* !CONFIG_BOND */
+
+    sum->company = sys_cpu_to_le16(CONFIG_ADV_MANAGER_COMPANY_ID);
+    sum->flags = flags;
+    sum->backlog = sys_cpu_to_le16(MIN(backlog, UINT16_MAX));
+
+    return urgent;
+}
+
+/**
+ * @brief (Re)start advertising with the current summary.
+ *
+ * Called with the lock held.
+ *
+ * @param fast    Use the fast instead of the slow interval.
+ * @param restart Stop a running advertiser first.
+ * @return 0 on success or a negative error code from bt_le_adv_start().
+ */
+static int adv_start(bool fast, bool restart)
+{
+    if (restart) {
+        bt_le_adv_stop();
+    }
+
+    struct bt_le_adv_param param = fast ? fast_param : slow_param;
+
+#if defined(CONFIG_BOND)
+    /* After the stop above, so a stale accept list can be rebuilt */
+    param.options |= bond_adv_options();
+#endif /* CONFIG_BOND */
+    int err = bt_le_adv_start(&param, ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
+    if (err) {
+        return err;
+    }
+
+    adv.fast = fast;
+    LOG_INF("Advertising %s", fast ? "fast" : "slow");
+    return 0;
+}
+
+/**
+ * @brief Periodic backlog check.
+ *
+ * Refreshes the summary in place, or restarts advertising when the
+ * backlog crossed the threshold. An advertiser stopped by a connection
+ * is not restarted; the application does that once a slot is free.
+ *
+ * @param work Pointer to the work item.
+ */
+static void adv_work_handler(struct k_work *work)
+{
+    k_mutex_lock(&adv.lock, K_FOREVER);
+
+    if (!adv.active) {
+        k_mutex_unlock(&adv.lock);
+        return;
+    }
+
+    bool fast = adv_summary_update();
+    int err = (fast != adv.fast) ? adv_start(fast, true) :
+              bt_le_adv_update_data(ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
+
+    if (err) {
+        /* Lost a race with a connection, or the advertiser failed */
+        LOG_WRN("Advertising update failed (err %d)", err);
+        adv.active = false;
+        k_mutex_unlock(&adv.lock);
+        return;
+    }
+
+    k_mutex_unlock(&adv.lock);
+
+    k_work_schedule(&adv.work, K_MSEC(CONFIG_ADV_MANAGER_CHECK_INTERVAL_MS));
+}
+
+
+/******************************************************************************
+ * Connection Callbacks
+ ******************************************************************************/
+
+/**
+ * @brief Connection established callback.
+ *
+ * A peripheral connection, even a failed one, ends the one-time
+ * advertiser it came in on.
+ *
+ * @param conn The connection object.
+ * @param err  HCI error code (0 for success).
+ */
+static void adv_connected(struct bt_conn *conn, uint8_t err)
+{
+    k_mutex_lock(&adv.lock, K_FOREVER);
+    adv.active = false;
+    k_mutex_unlock(&adv.lock);
+
+    k_work_cancel_delayable(&adv.work);
+}
+
+BT_CONN_CB_DEFINE(adv_conn_callbacks) = {
+    .connected = adv_connected,
+};
+
+
+/******************************************************************************
+ * Public API
+ ******************************************************************************/
+
+/**
+ * @brief Start connectable advertising.
+ *
+ * @return 0 on success, -EALREADY if advertising is running, or a
+ *         negative error code from bt_le_adv_start().
+ */
+int adv_manager_start(void)
+{
+    k_mutex_lock(&adv.lock, K_FOREVER);
+
+    int err = adv_start(adv_summary_update(), false);
+    if (err == 0 || err == -EALREADY) {
+        adv.active = true;
+        k_work_schedule(&adv.work, K_MSEC(CONFIG_ADV_MANAGER_CHECK_INTERVAL_MS));
+    }
+
+    k_mutex_unlock(&adv.lock);
+    return err;
+}
+
+/**
+ * @brief Initialize the advertising manager.
+ *
+ * It is automatically executed during the application initialization phase.
+ *
+ * @return 0 on successful initialization.
+ */
+static int adv_manager_init(void)
+{
+    k_mutex_init(&adv.lock);
+    k_work_init_delayable(&adv.work, adv_work_handler);
+
+    return 0;
+}
+
+SYS_INIT(adv_manager_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -0,0 +1,407 @@
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/init.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/bluetooth/gatt.h>
+
+#include "aggregate.h"
+#include "mem_cache.h"
+#if defined(CONFIG_SAMPLE_FORMAT_COMPACT)
+#include "imu_kernels.h"
+#endif /* CONFIG_SAMPLE_FORMAT_COMPACT */
+
+LOG_MODULE_REGISTER(aggregate, LOG_LEVEL_INF);
+
+
+/******************************************************************************
+ * Macro
+ ******************************************************************************/
+
+/* Frames of CONFIG_AGGREGATE_CHANNELS words in one raw sample */
+#define AGGREGATE_FRAMES (IMU_SAMPLE_LEN / CONFIG_AGGREGATE_CHANNELS)
+
+/* Requested mode and window, packed so the sampler applies both at once */
+#define AGGREGATE_CONFIG(mode, window) ((atomic_val_t)(mode) | ((atomic_val_t)(window) << 8))
+#define AGGREGATE_CONFIG_MODE(cfg)     ((uint8_t)((cfg) & 0xff))
+#define AGGREGATE_CONFIG_WINDOW(cfg)   ((uint16_t)((cfg) >> 8))
+
+BUILD_ASSERT(IMU_SAMPLE_LEN % CONFIG_AGGREGATE_CHANNELS == 0,
+             "CONFIG_AGGREGATE_CHANNELS must divide the IMU words of a sample");
+BUILD_ASSERT(AGGREGATE_IMU_COUNT < IMU_SAMPLE_LEN,
+             "Summary statistics do not fit in the IMU words of a sample");
+
+
+/******************************************************************************
+ * Data Types
+ ******************************************************************************/
+
+#if defined(CONFIG_SAMPLE_FORMAT_COMPACT)
+/* 12-bit readings: the squares of a whole window add up exactly in 64 bits */
+typedef uint64_t aggregate_sumsq_t;
+#else
+/* Full 32-bit words would overflow 64 bits within a window */
+typedef float aggregate_sumsq_t;
+#endif /* CONFIG_SAMPLE_FORMAT_COMPACT */
+
+/* Running statistics of one channel */
+typedef struct {
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    aggregate_sumsq_t sumsq;
+} aggregate_channel_t;
+
+typedef struct {
+    atomic_t config;                                         /* Requested AGGREGATE_CONFIG() */
+    atomic_val_t applied;                                    /* Config the window runs with (sampler only) */
+    aggregate_channel_t ch[CONFIG_AGGREGATE_CHANNELS];       /* Window in progress (sampler only) */
+    uint32_t count;                                          /* Samples in the window (sampler only) */
+    uint32_t summary_seq;                                    /* Next hybrid summary number (sampler only) */
+#if defined(CONFIG_AGGREGATE_GATT)
+    struct k_work notify_work;                               /* Sends summary in hybrid mode */
+    const struct bt_gatt_attr *attr;                         /* Aggregate Summary characteristic */
+#endif /* CONFIG_AGGREGATE_GATT */
+    struct k_spinlock lock;                                  /* Protects everything below */
+    sensor_sample_t summary;                                 /* Last completed window */
+    bool have_summary;                                       /* summary is valid */
+    uint8_t stored_mode;                                     /* Mode of the records handed to the cache */
+    uint32_t first_seq;                                      /* First record stored in stored_mode */
+} aggregate_t;
+
+
+/******************************************************************************
+ * Static Variables
+ ******************************************************************************/
+
+static aggregate_t agg;
+
+
+/******************************************************************************
+ * Window (sampling thread only)
+ ******************************************************************************/
+
+/**
+ * @brief Start a new, empty window.
+ */
+static void aggregate_reset(void)
+{
+    for (int c = 0; c < CONFIG_AGGREGATE_CHANNELS; c++) {
+        agg.ch[c] = (aggregate_channel_t){ .min = UINT32_MAX };
+    }
+    agg.count = 0;
+}
+
+/**
+ * @brief Add the IMU words of one sample to the window.
+ *
+ * @param sample Raw sample.
+ */
+static void aggregate_add(const sensor_sample_t *sample)
+{
+#if defined(CONFIG_SAMPLE_FORMAT_COMPACT)
+    /* Reduce the sample in one kernel call, then fold it into the window */
+    imu_kernel_stats_t st;
+
+    imu_kernel_reduce(&st, sample->imu, CONFIG_AGGREGATE_CHANNELS);
+
+    for (int c = 0; c < CONFIG_AGGREGATE_CHANNELS; c++) {
+        aggregate_channel_t *ch = &agg.ch[c];
+
+        ch->min = MIN(ch->min, st.min[c]);
+        ch->max = MAX(ch->max, st.max[c]);
+        ch->sum += st.sum[c];
+        ch->sumsq += st.sumsq[c];
+    }
+#else
+    for (int f = 0; f < AGGREGATE_FRAMES; f++) {
+        for (int c = 0; c < CONFIG_AGGREGATE_CHANNELS; c++) {
+            aggregate_channel_t *ch = &agg.ch[c];
+            uint32_t v = sample->imu[f * CONFIG_AGGREGATE_CHANNELS + c];
+
+            ch->min = MIN(ch->min, v);
+            ch->max = MAX(ch->max, v);
+            ch->sum += v;
+            ch->sumsq += (aggregate_sumsq_t)v * v;
+        }
+    }
+#endif /* CONFIG_SAMPLE_FORMAT_COMPACT */
+
+    agg.count++;
+}
+
+/**
+ * @brief Apply a new mode and window, starting with an empty window.
+ *
+ * @param config AGGREGATE_CONFIG() to apply.
+ * @param seq    Sequence number of the first record stored in the new mode.
+ */
+static void aggregate_apply(atomic_val_t config, uint32_t seq)
+{
+    agg.applied = config;
+    aggregate_reset();
+
+    k_spinlock_key_t key = k_spin_lock(&agg.lock);
+
+    agg.stored_mode = AGGREGATE_CONFIG_MODE(config);
+    agg.first_seq = seq;
+
+    k_spin_unlock(&agg.lock, key);
+}
+
+/**
+ * @brief Turn the window into a summary record and start the next one.
+ *
+ * @param out  Summary, see AGGREGATE_IMU_MIN.
+ * @param last Last raw sample of the window; may be @p out.
+ * @param seq  Sequence number of the summary in its stream.
+ */
+static void aggregate_close(sensor_sample_t *out, const sensor_sample_t *last, uint32_t seq)
+{
+    uint32_t frames = agg.count * AGGREGATE_FRAMES;
+    sensor_sample_t summary = {
+        .hdr = {
+            .seq = seq,
+            .timestamp = last->hdr.timestamp,
+        },
+    };
+
+    memcpy(summary.temp, last->temp, sizeof(summary.temp));
+
+    for (int c = 0; c < CONFIG_AGGREGATE_CHANNELS; c++) {
+        const aggregate_channel_t *ch = &agg.ch[c];
+        float rms = sqrtf((float)ch->sumsq / frames) + 0.5f;
+
+        summary.imu[AGGREGATE_IMU_MIN + c] = ch->min;
+        summary.imu[AGGREGATE_IMU_MAX + c] = ch->max;
+        summary.imu[AGGREGATE_IMU_MEAN + c] = (ch->sum + frames / 2) / frames;
+        /* Float rounding may overshoot the largest reading, never the RMS */
+        summary.imu[AGGREGATE_IMU_RMS + c] = rms < ch->max ? (uint32_t)rms : ch->max;
+    }
+    summary.imu[AGGREGATE_IMU_COUNT] = agg.count;
+
+    memcpy(out, &summary, sizeof(*out));
+    aggregate_reset();
+}
+
+/**
+ * @brief Keep a completed summary and notify it in hybrid mode.
+ *
+ * @param summary The summary.
+ */
+static void aggregate_publish(const sensor_sample_t *summary)
+{
+    k_spinlock_key_t key = k_spin_lock(&agg.lock);
+
+    memcpy(&agg.summary, summary, sizeof(agg.summary));
+    agg.have_summary = true;
+
+    k_spin_unlock(&agg.lock, key);
+
+#if defined(CONFIG_AGGREGATE_GATT)
+    if (AGGREGATE_CONFIG_MODE(agg.applied) == AGGREGATE_MODE_HYBRID && agg.attr) {
+        k_work_submit(&agg.notify_work);
+    }
+#endif /* CONFIG_AGGREGATE_GATT */
+}
+
+#if defined(CONFIG_AGGREGATE_GATT)
+/**
+ * @brief Notify the latest summary to every subscribed connection.
+ *
+ * Runs on the system workqueue, so a busy stack never stalls sampling.
+ * Summaries are small and rare; one that finds no buffer is skipped and
+ * can still be read.
+ *
+ * @param work Pointer to the work item.
+ */
+static void aggregate_notify_handler(struct k_work *work)
+{
+    uint8_t buf[SAMPLE_WIRE_LEN];
+    sensor_sample_t summary;
+
+    if (!aggregate_get_summary(&summary)) {
+        return;
+    }
+
+    sample_serialize(buf, &summary);
+
+    int err = bt_gatt_notify(NULL, agg.attr, buf, sizeof(buf));
+    if (err && err != -ENOTCONN) {
+        LOG_DBG("Summary notification failed (err %d)", err);
+    }
+}
+#endif /* CONFIG_AGGREGATE_GATT */
+
+
+/******************************************************************************
+ * Public API
+ ******************************************************************************/
+
+/**
+ * @brief Pass a burst of samples through the aggregation stage.
+ *
+ * @param samples Samples, oldest first.
+ * @param n       Number of samples.
+ * @param seq     Sequence number of the first record to store.
+ * @return Number of records in @p samples to store in the cache.
+ */
+size_t aggregate_feed(sensor_sample_t *samples, size_t n, uint32_t seq)
+{
+    atomic_val_t config = atomic_get(&agg.config);
+
+    if (config != agg.applied) {
+        aggregate_apply(config, seq);
+    }
+
+    uint8_t mode = AGGREGATE_CONFIG_MODE(config);
+    uint16_t window = AGGREGATE_CONFIG_WINDOW(config);
+    sensor_sample_t hybrid;   /* Summary that stays out of the burst */
+    size_t out = 0;
+
+    if (mode != AGGREGATE_MODE_SUMMARY) {
+        /* The raw samples are the records */
+        for (size_t i = 0; i < n; i++) {
+            samples[i].hdr.seq = seq + i;
+        }
+    }
+    if (mode == AGGREGATE_MODE_RAW) {
+        return n;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        aggregate_add(&samples[i]);
+        if (agg.count < window) {
+            continue;
+        }
+
+        sensor_sample_t *summary;
+
+        if (mode == AGGREGATE_MODE_SUMMARY) {
+            /* Summaries only ever take the place of samples already consumed */
+            summary = &samples[out];
+            aggregate_close(summary, &samples[i], seq + out);
+            out++;
+        } else {
+            /* Hybrid summaries are numbered on their own characteristic */
+            summary = &hybrid;
+            aggregate_close(summary, &samples[i], agg.summary_seq++);
+        }
+        aggregate_publish(summary);
+    }
+
+    return (mode == AGGREGATE_MODE_SUMMARY) ? out : n;
+}
+
+/**
+ * @brief Change the aggregation mode and window.
+ *
+ * @param mode   AGGREGATE_MODE_*.
+ * @param window Samples per summary.
+ * @return 0 on success, or -EINVAL if either is out of range.
+ */
+int aggregate_set_mode(uint8_t mode, uint16_t window)
+{
+    if (mode >= AGGREGATE_MODE_COUNT || window < AGGREGATE_WINDOW_MIN ||
+        window > AGGREGATE_WINDOW_MAX) {
+        return -EINVAL;
+    }
+
+    atomic_set(&agg.config, AGGREGATE_CONFIG(mode, window));
+    LOG_INF("Aggregation mode %u, %u samples per window", mode, window);
+
+    return 0;
+}
+
+/**
+ * @brief Get the aggregation mode.
+ *
+ * @return AGGREGATE_MODE_*, as last requested.
+ */
+uint8_t aggregate_get_mode(void)
+{
+    return AGGREGATE_CONFIG_MODE(atomic_get(&agg.config));
+}
+
+/**
+ * @brief Get the aggregation window.
+ *
+ * @return Samples per summary, as last requested.
+ */
+uint16_t aggregate_get_window(void)
+{
+    return AGGREGATE_CONFIG_WINDOW(atomic_get(&agg.config));
+}
+
+/**
+ * @brief Get the mode of the records handed to the cache.
+ *
+ * @param first_seq Set to the sequence number of the first record stored
+ *                  in that mode, may be NULL.
+ * @return AGGREGATE_MODE_* the sampling thread applied last.
+ */
+uint8_t aggregate_get_stored_mode(uint32_t *first_seq)
+{
+    k_spinlock_key_t key = k_spin_lock(&agg.lock);
+    uint8_t mode = agg.stored_mode;
+
+    if (first_seq) {
+        *first_seq = agg.first_seq;
+    }
+
+    k_spin_unlock(&agg.lock, key);
+    return mode;
+}
+
+/**
+ * @brief Get the most recent summary.
+ *
+ * @param out Filled with a copy of the summary.
+ * @return true on success, false if no window has completed yet.
+ */
+bool aggregate_get_summary(sensor_sample_t *out)
+{
+    k_spinlock_key_t key = k_spin_lock(&agg.lock);
+    bool valid = agg.have_summary;
+
+    if (valid) {
+        memcpy(out, &agg.summary, sizeof(*out));
+    }
+
+    k_spin_unlock(&agg.lock, key);
+    return valid;
+}
+
+#if defined(CONFIG_AGGREGATE_GATT)
+/**
+ * @brief Set the characteristic summaries are notified on in hybrid mode.
+ *
+ * @param attr The Aggregate Summary characteristic value attribute.
+ */
+void aggregate_notify_init(const struct bt_gatt_attr *attr)
+{
+    agg.attr = attr;
+}
+#endif /* CONFIG_AGGREGATE_GATT */
+
+/**
+ * @brief Initialize the aggregation stage.
+ *
+ * It is automatically executed during the application initialization phase.
+ *
+ * @return 0 on successful initialization.
+ */
+static int aggregate_init(void)
+{
+    atomic_set(&agg.config, AGGREGATE_CONFIG(AGGREGATE_MODE_RAW, CONFIG_AGGREGATE_WINDOW));
+    aggregate_apply(atomic_get(&agg.config), 0);
+#if defined(CONFIG_AGGREGATE_GATT)
+    k_work_init(&agg.notify_work, aggregate_notify_handler);
+#endif /* CONFIG_AGGREGATE_GATT */
+
+    return 0;
+}
+
+SYS_INIT(aggregate_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
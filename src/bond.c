@@ -0,0 +1,347 @@
+#include <errno.h>
+#include <zephyr/kernel.h>
+#include <zephyr/init.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+
+#include "bond.h"
+
+LOG_MODULE_REGISTER(bond, LOG_LEVEL_INF);
+
+/* The flash tier's FCB owns the storage partition, keys must go elsewhere */
+BUILD_ASSERT(!IS_ENABLED(CONFIG_FLASH_TIER) || DT_HAS_CHOSEN(zephyr_settings_partition),
+             "CONFIG_BOND with CONFIG_FLASH_TIER needs a zephyr,settings-partition");
+
+
+/******************************************************************************
+ * Data Types
+ ******************************************************************************/
+
+typedef struct {
+    struct k_work_delayable window;   /* Closes the pairing window */
+    struct k_mutex lock;              /* Protects everything below */
+    bond_policy_cb_t changed;         /* Advertising filter policy changed */
+    size_t count;                     /* Bonded peers */
+    bool pairing_open;                /* Pairing window still open */
+    bool filtered;                    /* Advertising is filtered by the accept list */
+    bool list_stale;                  /* Accept list misses a bond, rebuild before advertising */
+} bond_t;
+
+
+/******************************************************************************
+ * Static Variables
+ ******************************************************************************/
+
+static bond_t bond;
+
+
+/******************************************************************************
+ * Accept list
+ ******************************************************************************/
+
+/**
+ * @brief Count one bond.
+ *
+ * @param info      The bond.
+ * @param user_data Counter to increment.
+ */
+static void bond_count_cb(const struct bt_bond_info *info, void *user_data)
+{
+    (*(size_t *)user_data)++;
+}
+
+/**
+ * @brief Put one bonded peer on the accept list.
+ *
+ * @param info      The bond.
+ * @param user_data Set to the error code if the peer could not be added.
+ */
+static void bond_list_add_cb(const struct bt_bond_info *info, void *user_data)
+{
+    int err = bt_le_filter_accept_list_add(&info->addr);
+
+    if (err) {
+        *(int *)user_data = err;
+    }
+}
+
+/**
+ * @brief Rebuild the accept list and the bond count from the stored bonds.
+ *
+ * Called with the lock held. Fails while an advertiser uses the list.
+ */
+static void bond_list_rebuild(void)
+{
+    int err = bt_le_filter_accept_list_clear();
+
+    bond.count = 0;
+    bt_foreach_bond(BT_ID_DEFAULT, bond_count_cb, &bond.count);
+    if (err == 0) {
+        bt_foreach_bond(BT_ID_DEFAULT, bond_list_add_cb, &err);
+    }
+
+    bond.list_stale = (err != 0);
+    if (err) {
+        LOG_WRN("Accept list rebuild failed (err %d)", err);
+    }
+}
+
+/**
+ * @brief Recompute the advertising filter policy.
+ *
+ * Called with the lock held.
+ *
+ * @return true if the policy changed.
+ */
+static bool bond_policy_update(void)
+{
+    bool filtered = bond.count > 0 && !bond.pairing_open;
+    bool changed = (filtered != bond.filtered);
+
+    bond.filtered = filtered;
+    return changed;
+}
+
+/**
+ * @brief Tell the application that the advertising filter policy changed.
+ *
+ * @param changed Result of bond_policy_update().
+ */
+static void bond_policy_notify(bool changed)
+{
+    if (changed && bond.changed) {
+        bond.changed();
+    }
+}
+
+/**
+ * @brief Close the pairing window.
+ *
+ * @param work Pointer to the work item.
+ */
+static void bond_window_handler(struct k_work *work)
+{
+    k_mutex_lock(&bond.lock, K_FOREVER);
+    bond.pairing_open = false;
+    bool changed = bond_policy_update();
+    k_mutex_unlock(&bond.lock);
+
+    LOG_INF("Pairing window closed");
+    bond_policy_notify(changed);
+}
+
+
+/******************************************************************************
+ * Pairing Callbacks
+ ******************************************************************************/
+
+/**
+ * @brief Decide whether to accept a pairing request.
+ *
+ * @param conn The connection object.
+ * @param feat Pairing features of the peer.
+ * @return BT_SECURITY_ERR_SUCCESS inside the pairing window or while
+ *         nothing is bonded, BT_SECURITY_ERR_PAIR_NOT_ALLOWED otherwise.
+ */
+static enum bt_security_err bond_pairing_accept(struct bt_conn *conn,
+                                                const struct bt_conn_pairing_feat *const feat)
+{
+    k_mutex_lock(&bond.lock, K_FOREVER);
+    bool allowed = bond.pairing_open || bond.count == 0;
+    k_mutex_unlock(&bond.lock);
+
+    if (!allowed) {
+        LOG_WRN("Pairing rejected, window closed");
+        return BT_SECURITY_ERR_PAIR_NOT_ALLOWED;
+    }
+
+    return BT_SECURITY_ERR_SUCCESS;
+}
+
+/**
+ * @brief Pairing complete callback.
+ *
+ * The keys are already stored; the new peer goes onto the accept list.
+ *
+ * @param conn   The connection object.
+ * @param bonded true if the peer was bonded, false for a one-off pairing.
+ */
+static void bond_pairing_complete(struct bt_conn *conn, bool bonded)
+{
+    if (!bonded) {
+        LOG_INF("Paired without bonding");
+        return;
+    }
+
+    k_mutex_lock(&bond.lock, K_FOREVER);
+
+    bond.count = 0;
+    bt_foreach_bond(BT_ID_DEFAULT, bond_count_cb, &bond.count);
+    if (bt_le_filter_accept_list_add(bt_conn_get_dst(conn))) {
+        bond.list_stale = true;
+    }
+    bool changed = bond_policy_update();
+    size_t count = bond.count;
+
+    k_mutex_unlock(&bond.lock);
+
+    LOG_INF("Bonded, %u peers", (unsigned int)count);
+    bond_policy_notify(changed);
+}
+
+/**
+ * @brief Pairing failed callback.
+ *
+ * @param conn   The connection object.
+ * @param reason Security error.
+ */
+static void bond_pairing_failed(struct bt_conn *conn, enum bt_security_err reason)
+{
+    LOG_WRN("Pairing failed (reason %d)", reason);
+}
+
+static struct bt_conn_auth_cb bond_auth_cb = {
+    .pairing_accept = bond_pairing_accept,
+};
+
+static struct bt_conn_auth_info_cb bond_auth_info_cb = {
+    .pairing_complete = bond_pairing_complete,
+    .pairing_failed = bond_pairing_failed,
+};
+
+
+/******************************************************************************
+ * Connection Callbacks
+ ******************************************************************************/
+
+/**
+ * @brief Connection established callback.
+ *
+ * Asks for encryption right away: a bonded central restarts it with the
+ * stored LTK in a few connection events, anyone else pairs before the
+ * first protected access would fail with an ATT error and retry.
+ *
+ * @param conn The connection object.
+ * @param err  HCI error code (0 for success).
+ */
+static void bond_connected(struct bt_conn *conn, uint8_t err)
+{
+    if (err) {
+        return;
+    }
+
+    int ret = bt_conn_set_security(conn, BT_SECURITY_L2);
+    if (ret) {
+        LOG_WRN("Security request failed (err %d)", ret);
+    }
+}
+
+/**
+ * @brief Connection security changed callback.
+ *
+ * @param conn  The connection object.
+ * @param level New security level.
+ * @param err   Security error (BT_SECURITY_ERR_SUCCESS on success).
+ */
+static void bond_security_changed(struct bt_conn *conn, bt_security_t level,
+                                  enum bt_security_err err)
+{
+    if (err) {
+        LOG_WRN("Encryption failed (err %d)", err);
+        return;
+    }
+
+    LOG_INF("Link encrypted, level %d", level);
+}
+
+BT_CONN_CB_DEFINE(bond_conn_callbacks) = {
+    .connected = bond_connected,
+    .security_changed = bond_security_changed,
+};
+
+
+/******************************************************************************
+ * Public API
+ ******************************************************************************/
+
+/**
+ * @brief Load the bonds from settings and open the pairing window.
+ *
+ * @param changed Called when the advertising filter policy changes.
+ * @return 0 on success or a negative error code from settings_load().
+ */
+int bond_load(bond_policy_cb_t changed)
+{
+    int err = settings_load();
+    if (err) {
+        LOG_ERR("Settings load failed (err %d)", err);
+        return err;
+    }
+
+    k_mutex_lock(&bond.lock, K_FOREVER);
+
+    bond.changed = changed;
+    bond_list_rebuild();
+    bond.pairing_open = (CONFIG_BOND_PAIRING_WINDOW_S > 0);
+    bond_policy_update();
+
+    k_mutex_unlock(&bond.lock);
+
+    if (bond.pairing_open) {
+        k_work_schedule(&bond.window, K_SECONDS(CONFIG_BOND_PAIRING_WINDOW_S));
+    }
+
+    LOG_INF("%u bonded peers, pairing %s", (unsigned int)bond.count,
+            bond.pairing_open ? "open" : "closed");
+    return 0;
+}
+
+/**
+ * @brief Get the options to add to the next advertiser.
+ *
+ * @return BT_LE_ADV_OPT_FILTER_CONN once a peer is bonded and the
+ *         pairing window is closed, 0 otherwise.
+ */
+uint32_t bond_adv_options(void)
+{
+    k_mutex_lock(&bond.lock, K_FOREVER);
+
+    if (bond.list_stale) {
+        bond_list_rebuild();
+    }
+    bool filtered = bond.filtered && !bond.list_stale;
+
+    k_mutex_unlock(&bond.lock);
+
+    /* Scan requests stay open, so any scanner still reads the scan response */
+    return filtered ? BT_LE_ADV_OPT_FILTER_CONN : 0;
+}
+
+/**
+ * @brief Initialize the bond manager.
+ *
+ * It is automatically executed during the application initialization phase.
+ *
+ * @return 0 on successful initialization, or a negative error code if
+ *         the pairing callbacks could not be registered.
+ */
+static int bond_init(void)
+{
+    k_mutex_init(&bond.lock);
+    k_work_init_delayable(&bond.window, bond_window_handler);
+
+    int err = bt_conn_auth_cb_register(&bond_auth_cb);
+    if (err == 0) {
+        err = bt_conn_auth_info_cb_register(&bond_auth_info_cb);
+    }
+    if (err) {
+        LOG_ERR("Pairing callback registration failed (err %d)", err);
+    }
+
+    return err;
+}
+
+SYS_INIT(bond_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -0,0 +1,197 @@
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/init.h>
+#include <zephyr/cache.h>
+#include <zephyr/device.h>
+#include <zephyr/drivers/dma.h>
+#include <zephyr/logging/log.h>
+
+#include "dma_copy.h"
+
+LOG_MODULE_REGISTER(dma_copy, LOG_LEVEL_INF);
+
+
+/******************************************************************************
+ * Macro
+ ******************************************************************************/
+
+/* Controller with the memory-to-memory channel, from the dma-copy alias */
+#define DMA_COPY_NODE DT_ALIAS(dma_copy)
+
+/* Far longer than any sample block takes; a stuck transfer falls back to memcpy */
+#define DMA_COPY_TIMEOUT K_MSEC(10)
+
+
+/******************************************************************************
+ * Data Types
+ ******************************************************************************/
+
+typedef struct {
+    const struct device *dev;   /* DMA controller */
+    int channel;                /* Requested channel, negative if none */
+    struct k_mutex lock;        /* One transfer at a time on the channel */
+    struct k_sem done;          /* Given by the completion callback */
+    int status;                 /* Result passed to the completion callback */
+    size_t line;                /* Data cache line size, 0 without a data cache */
+} dma_copy_t;
+
+
+/******************************************************************************
+ * Static Variables
+ ******************************************************************************/
+
+static dma_copy_t dma = {
+    .dev = DEVICE_DT_GET(DMA_COPY_NODE),
+    .channel = -ENODEV,
+};
+
+
+/******************************************************************************
+ * Transfer
+ ******************************************************************************/
+
+/**
+ * @brief DMA completion callback.
+ *
+ * @param dev       The DMA controller.
+ * @param user_data Unused.
+ * @param channel   The channel that completed.
+ * @param status    0 or DMA_STATUS_COMPLETE on success, a negative error code otherwise.
+ */
+static void dma_copy_done(const struct device *dev, void *user_data, uint32_t channel,
+                          int status)
+{
+    dma.status = status;
+    k_sem_give(&dma.done);
+}
+
+/**
+ * @brief Check that a destination covers whole data cache lines.
+ *
+ * Invalidating a partial line would throw away the neighbouring bytes
+ * sharing it, so only whole lines can be handed to the controller.
+ *
+ * @param dst Destination.
+ * @param len Number of bytes.
+ * @return true if @p dst and @p len are multiples of the line size.
+ */
+static bool dma_copy_line_aligned(const void *dst, size_t len)
+{
+    return dma.line == 0 || (((uintptr_t)dst | len) & (dma.line - 1)) == 0;
+}
+
+/**
+ * @brief Run one memory-to-memory transfer and wait for it.
+ *
+ * Called with the lock held, @p dst must cover whole data cache lines.
+ *
+ * @param dst Destination.
+ * @param src Source.
+ * @param len Number of bytes.
+ * @return 0 on success or a negative error code.
+ */
+static int dma_copy_transfer(void *dst, const void *src, size_t len)
+{
+    /* Word transfers when both ends and the length allow it */
+    uint32_t width = (((uintptr_t)dst | (uintptr_t)src | len) & 3) ? 1 : 4;
+    struct dma_block_config block = {
+        .source_address = (uintptr_t)src,
+        .dest_address = (uintptr_t)dst,
+        .block_size = len,
+    };
+    struct dma_config cfg = {
+        .channel_direction = MEMORY_TO_MEMORY,
+        .source_data_size = width,
+        .dest_data_size = width,
+        .source_burst_length = width,
+        .dest_burst_length = width,
+        .block_count = 1,
+        .head_block = &block,
+        .dma_callback = dma_copy_done,
+    };
+
+    /* The controller reads and writes RAM behind the data cache, if any. A
+     * dirty destination line evicted mid-transfer would overwrite its data.
+     */
+    sys_cache_data_flush_range((void *)src, len);
+    sys_cache_data_flush_and_invd_range(dst, len);
+
+    int err = dma_config(dma.dev, dma.channel, &cfg);
+    if (err == 0) {
+        k_sem_reset(&dma.done);
+        err = dma_start(dma.dev, dma.channel);
+    }
+    if (err == 0 && k_sem_take(&dma.done, DMA_COPY_TIMEOUT)) {
+        dma_stop(dma.dev, dma.channel);
+        err = -ETIMEDOUT;
+    }
+    if (err == 0 && dma.status < 0) {
+        err = dma.status;
+    }
+
+    /* Drop lines speculatively refilled while the transfer ran */
+    sys_cache_data_invd_range(dst, len);
+    return err;
+}
+
+
+/******************************************************************************
+ * Public API
+ ******************************************************************************/
+
+/**
+ * @brief Copy a block of memory, with DMA for large blocks.
+ *
+ * @param dst Destination.
+ * @param src Source.
+ * @param len Number of bytes.
+ */
+void dma_copy(void *dst, const void *src, size_t len)
+{
+    if (len < CONFIG_DMA_COPY_THRESHOLD || dma.channel < 0 || k_is_in_isr() ||
+        !dma_copy_line_aligned(dst, len)) {
+        memcpy(dst, src, len);
+        return;
+    }
+
+    k_mutex_lock(&dma.lock, K_FOREVER);
+
+    int err = dma_copy_transfer(dst, src, len);
+
+    k_mutex_unlock(&dma.lock);
+
+    if (err) {
+        LOG_WRN("DMA copy of %zu bytes failed (err %d), using memcpy", len, err);
+        memcpy(dst, src, len);
+    }
+}
+
+/**
+ * @brief Reserve the memory-to-memory DMA channel.
+ *
+ * It is automatically executed during the application initialization phase.
+ * Without a channel every copy falls back to memcpy.
+ *
+ * @return 0 on successful initialization.
+ */
+static int dma_copy_init(void)
+{
+    k_mutex_init(&dma.lock);
+    k_sem_init(&dma.done, 0, 1);
+    dma.line = sys_cache_data_line_size_get();
+
+    if (!device_is_ready(dma.dev)) {
+        LOG_WRN("DMA controller not ready, copying with the CPU");
+        return 0;
+    }
+
+    dma.channel = dma_request_channel(dma.dev, NULL);
+    if (dma.channel < 0) {
+        LOG_WRN("No free DMA channel, copying with the CPU");
+    }
+
+    return 0;
+}
+
+SYS_INIT(dma_copy_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
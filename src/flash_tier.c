@@ -0,0 +1,460 @@
+#include <zephyr/kernel.h>
+#include <zephyr/init.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/fs/fcb.h>
+#include <zephyr/storage/flash_map.h>
+#include <string.h>
+
+#include "flash_tier.h"
+#include "mem_cache.h"
+#include "profile.h"
+#include "sample_format.h"
+#include "tx_engine.h"
+
+LOG_MODULE_REGISTER(flash_tier, LOG_LEVEL_INF);
+
+
+/******************************************************************************
+ * Macro
+ ******************************************************************************/
+
+#define FLASH_TIER_AREA_ID FIXED_PARTITION_ID(storage_partition)
+
+/* Entries written by a firmware with another sample layout are not readable */
+#define FLASH_TIER_MAGIC    0x534d5054   /* "SMPT" */
+/* Bumped whenever the sample wire layout changes; float32 temperatures are a layout of their own */
+#define FLASH_TIER_LAYOUT   (IS_ENABLED(CONFIG_SAMPLE_TEMP_FLOAT) ? 2 : 1)
+#define FLASH_TIER_VERSION  ((FLASH_TIER_LAYOUT << 4) | SAMPLE_FORMAT_VERSION)
+
+/* Bytes of one full batch before padding to the flash write block */
+#define FLASH_TIER_BATCH_LEN (CONFIG_FLASH_TIER_BATCH * SAMPLE_WIRE_LEN)
+
+/* Batch buffers hold one extra sample as room for the write block padding */
+#define FLASH_TIER_BUF_SAMPLES (CONFIG_FLASH_TIER_BATCH + 1)
+
+BUILD_ASSERT(CONFIG_FLASH_TIER_SPILL_THRESHOLD >= CONFIG_FLASH_TIER_BATCH,
+             "Spill threshold must cover at least one full batch");
+#if defined(CONFIG_MEM_CACHE_BACKEND_SLAB)
+BUILD_ASSERT(CONFIG_FLASH_TIER_SPILL_THRESHOLD <=
+             CONFIG_CACHE_MIN_BLOCKS * CONFIG_CACHE_BLOCK_SAMPLES,
+             "Spill threshold must not exceed the smallest cache capacity");
+#else
+BUILD_ASSERT(CONFIG_FLASH_TIER_SPILL_THRESHOLD <= CONFIG_CACHE_SIZE,
+             "Spill threshold must not exceed CONFIG_CACHE_SIZE");
+#endif /* CONFIG_MEM_CACHE_BACKEND_SLAB */
+
+
+/******************************************************************************
+ * Data Types
+ ******************************************************************************/
+
+typedef struct {
+    struct fcb fcb;                                           /* FIFO of batches in the storage partition */
+    struct flash_sector sectors[CONFIG_FLASH_TIER_MAX_SECTORS];
+    struct fcb_entry read_loc;                                /* Last restored entry, fe_sector NULL before the first */
+    struct k_sem wake;                                        /* Signals a staged batch or a drained restore buffer */
+    sensor_sample_t stage[FLASH_TIER_BUF_SAMPLES];            /* Batch popped from RAM, waiting to be written */
+    sensor_sample_t drain[FLASH_TIER_BUF_SAMPLES];            /* Batch read back from flash, waiting to be sent */
+    atomic_t stage_n;                                         /* Samples in stage, 0 when free */
+    atomic_t drain_n;                                         /* Samples in drain, 0 when empty */
+    size_t drain_pos;                                         /* Samples of drain already sent (consumer only) */
+    atomic_t stored;                                          /* Samples in flash not restored yet */
+    atomic_t dropped;                                         /* Samples lost because flash was full */
+    uint32_t capacity;                                        /* Approximate partition capacity in samples */
+    atomic_t ready;                                           /* Set once mounted, never if mounting failed */
+} flash_tier_t;
+
+
+/******************************************************************************
+ * Static Variables
+ ******************************************************************************/
+
+static flash_tier_t tier;
+
+
+/******************************************************************************
+ * Flash access (flash tier thread only)
+ ******************************************************************************/
+
+/**
+ * @brief Count the samples stored behind the read position.
+ *
+ * @return Number of samples not restored yet.
+ */
+static size_t flash_tier_recount(void)
+{
+    struct fcb_entry loc = tier.read_loc;
+    size_t n = 0;
+
+    while (fcb_getnext(&tier.fcb, &loc) == 0) {
+        n += loc.fe_data_len / SAMPLE_WIRE_LEN;
+    }
+
+    return n;
+}
+
+/**
+ * @brief Serialize samples in place, packing them to the wire layout.
+ *
+ * @param samples Samples, overwritten from the start by the packed records.
+ * @param n       Number of samples.
+ * @return Length of the packed records in bytes.
+ */
+static size_t flash_tier_pack(sensor_sample_t *samples, size_t n)
+{
+    uint8_t *wire = (uint8_t *)samples;
+
+    /* Records only ever move down, each over the slots already packed */
+    for (size_t i = 1; i < n; i++) {
+        memmove(&wire[i * SAMPLE_WIRE_LEN], &samples[i], SAMPLE_WIRE_LEN);
+    }
+
+    return n * SAMPLE_WIRE_LEN;
+}
+
+/**
+ * @brief Deserialize packed records in place, the reverse of flash_tier_pack().
+ *
+ * @param samples Buffer holding the packed records at its start.
+ * @param n       Number of records.
+ */
+static void flash_tier_unpack(sensor_sample_t *samples, size_t n)
+{
+    const uint8_t *wire = (const uint8_t *)samples;
+
+    /* Records only ever move up, so start with the last one */
+    for (size_t i = n; i-- > 1;) {
+        memmove(&samples[i], &wire[i * SAMPLE_WIRE_LEN], SAMPLE_WIRE_LEN);
+    }
+}
+
+/**
+ * @brief Free the oldest sector for a new batch.
+ *
+ * A sector that has been fully restored is recycled without loss. Otherwise
+ * the overflow policy decides: reject keeps the stored history and drops
+ * the new batch, the other policies erase the oldest unsent samples.
+ *
+ * @return 0 if a sector was freed, or a negative error code.
+ */
+static int flash_tier_make_room(void)
+{
+    if (tier.read_loc.fe_sector && tier.read_loc.fe_sector != tier.fcb.f_oldest) {
+        return fcb_rotate(&tier.fcb);
+    }
+
+    if (IS_ENABLED(CONFIG_MEM_CACHE_OVERFLOW_REJECT)) {
+        return -ENOSPC;
+    }
+
+    int err = fcb_rotate(&tier.fcb);
+    if (err) {
+        return err;
+    }
+
+    size_t before = (size_t)atomic_get(&tier.stored);
+
+    tier.read_loc.fe_sector = NULL;
+    atomic_set(&tier.stored, (atomic_val_t)flash_tier_recount());
+    atomic_add(&tier.dropped, (atomic_val_t)(before - (size_t)atomic_get(&tier.stored)));
+
+    return 0;
+}
+
+/**
+ * @brief Write the staged batch as one FCB entry.
+ *
+ * Samples are stored in their wire layout, so entries do not depend on
+ * CONFIG_SAMPLE_ALIGN. The entry is padded to the flash write block so
+ * every batch goes out as a single aligned write.
+ */
+static void flash_tier_store(void)
+{
+    size_t n = (size_t)atomic_get(&tier.stage_n);
+    size_t len = ROUND_UP(flash_tier_pack(tier.stage, n), tier.fcb.f_align);
+    struct fcb_entry loc;
+
+    int err = fcb_append(&tier.fcb, len, &loc);
+    if (err == -ENOSPC) {
+        err = flash_tier_make_room();
+        if (err == 0) {
+            err = fcb_append(&tier.fcb, len, &loc);
+        }
+    }
+    if (err == 0) {
+        err = flash_area_write(tier.fcb.fap, FCB_ENTRY_FA_DATA_OFF(loc), tier.stage, len);
+    }
+    if (err == 0) {
+        err = fcb_append_finish(&tier.fcb, &loc);
+    }
+
+    if (err) {
+        LOG_WRN("Flash tier write failed (err %d), dropping %zu samples", err, n);
+        atomic_add(&tier.dropped, (atomic_val_t)n);
+    } else {
+        atomic_add(&tier.stored, (atomic_val_t)n);
+    }
+
+    atomic_clear(&tier.stage_n);
+}
+
+/**
+ * @brief Read the oldest stored batch into the restore buffer.
+ *
+ * Sectors the read position has moved past are rotated out, which is the
+ * only time flash is erased on the restore path.
+ */
+static void flash_tier_load(void)
+{
+    struct fcb_entry loc = tier.read_loc;
+
+    if (fcb_getnext(&tier.fcb, &loc)) {
+        /* Nothing left to read, a count saying otherwise would stall the TX engine */
+        atomic_val_t lost = atomic_set(&tier.stored, 0);
+
+        if (lost) {
+            LOG_WRN("Flash tier lost track of %u samples", (unsigned int)lost);
+            atomic_add(&tier.dropped, lost);
+        }
+        return;
+    }
+
+    while (loc.fe_sector != tier.fcb.f_oldest) {
+        if (fcb_rotate(&tier.fcb)) {
+            break;
+        }
+    }
+
+    size_t n = loc.fe_data_len / SAMPLE_WIRE_LEN;
+    int err = -EINVAL;
+
+    if (n > 0 && n <= CONFIG_FLASH_TIER_BATCH) {
+        err = flash_area_read(tier.fcb.fap, FCB_ENTRY_FA_DATA_OFF(loc), tier.drain,
+                              n * SAMPLE_WIRE_LEN);
+    }
+
+    tier.read_loc = loc;
+    atomic_sub(&tier.stored, (atomic_val_t)n);
+
+    if (err) {
+        LOG_WRN("Flash tier read failed (err %d), skipping %zu samples", err, n);
+        atomic_add(&tier.dropped, (atomic_val_t)n);
+        return;
+    }
+
+    flash_tier_unpack(tier.drain, n);
+    tier.drain_pos = 0;
+    atomic_set(&tier.drain_n, (atomic_val_t)n);
+    tx_engine_kick();
+}
+
+/**
+ * @brief Mount the FCB, erasing the partition if it holds another format.
+ *
+ * @return 0 on success, -ENOTSUP if the flash write block is not smaller
+ *         than one sample, or another negative error code.
+ */
+static int flash_tier_mount(void)
+{
+    uint32_t sector_cnt = ARRAY_SIZE(tier.sectors);
+
+    int err = flash_area_get_sectors(FLASH_TIER_AREA_ID, &sector_cnt, tier.sectors);
+    if (err) {
+        return err;
+    }
+
+    tier.fcb.f_magic = FLASH_TIER_MAGIC;
+    tier.fcb.f_version = FLASH_TIER_VERSION;
+    tier.fcb.f_sector_cnt = sector_cnt;
+    tier.fcb.f_scratch_cnt = 1;
+    tier.fcb.f_sectors = tier.sectors;
+
+    err = fcb_init(FLASH_TIER_AREA_ID, &tier.fcb);
+    if (err) {
+        const struct flash_area *fa;
+
+        LOG_WRN("Flash tier unreadable (err %d), erasing", err);
+        err = flash_area_open(FLASH_TIER_AREA_ID, &fa);
+        if (err) {
+            return err;
+        }
+        err = flash_area_erase(fa, 0, fa->fa_size);
+        flash_area_close(fa);
+        if (err) {
+            return err;
+        }
+        err = fcb_init(FLASH_TIER_AREA_ID, &tier.fcb);
+        if (err) {
+            return err;
+        }
+    }
+
+    /* Entries hold no sample count, padding must stay shorter than one sample */
+    if (tier.fcb.f_align >= SAMPLE_WIRE_LEN) {
+        LOG_ERR("Flash write block of %u bytes, samples need a smaller one",
+                (unsigned int)tier.fcb.f_align);
+        return -ENOTSUP;
+    }
+
+    /* Per entry: length prefix and CRC, each padded to the write block */
+    size_t entry = ROUND_UP(FLASH_TIER_BATCH_LEN, tier.fcb.f_align) + 2 * tier.fcb.f_align;
+
+    tier.capacity = (sector_cnt - tier.fcb.f_scratch_cnt) *
+                    (tier.sectors[0].fs_size / entry) * CONFIG_FLASH_TIER_BATCH;
+    return 0;
+}
+
+/**
+ * @brief Flash tier thread.
+ *
+ * Writes staged batches, restores stored ones and prompts the TX engine to
+ * spill again while the RAM cache stays above the threshold. Sleeps until
+ * a batch is staged or the restore buffer is drained. Runs at low priority
+ * so flash programming and erase never delay sampling or TX.
+ */
+static void flash_tier_thread(void *p1, void *p2, void *p3)
+{
+    int err = flash_tier_mount();
+    if (err) {
+        LOG_ERR("Flash tier disabled (err %d)", err);
+        return;
+    }
+
+    atomic_set(&tier.stored, (atomic_val_t)flash_tier_recount());
+    atomic_set(&tier.ready, 1);
+    LOG_INF("Flash tier ready, %u samples stored, room for about %u",
+            (unsigned int)atomic_get(&tier.stored), tier.capacity);
+
+    /* The first pass restores what the last boot left behind */
+    while (1) {
+#if defined(CONFIG_PROFILE)
+        uint32_t start = k_cycle_get_32();
+#endif /* CONFIG_PROFILE */
+
+        if (atomic_get(&tier.stage_n)) {
+            flash_tier_store();
+        }
+
+        /* A batch that could not be read is skipped, try the next one */
+        while (!atomic_get(&tier.drain_n) && atomic_get(&tier.stored)) {
+            flash_tier_load();
+        }
+
+#if defined(CONFIG_PROFILE)
+        profile_cpu(PROFILE_CPU_FLASH, k_cycle_get_32() - start);
+#endif /* CONFIG_PROFILE */
+
+        if (mem_cache_count() >= CONFIG_FLASH_TIER_SPILL_THRESHOLD) {
+            /* The TX engine is the cache consumer, let it decide to spill */
+            tx_engine_kick();
+        }
+
+        k_sem_take(&tier.wake, K_FOREVER);
+    }
+}
+
+K_THREAD_DEFINE(flash_tier_tid, CONFIG_FLASH_TIER_STACK_SIZE, flash_tier_thread,
+                NULL, NULL, NULL, CONFIG_FLASH_TIER_PRIORITY, 0, 0);
+
+
+/******************************************************************************
+ * Public API
+ ******************************************************************************/
+
+/**
+ * @brief Move the oldest samples of the RAM cache to flash.
+ *
+ * @return true if a batch was handed over, false if none was due or the
+ *         flash tier is not mounted.
+ */
+bool flash_tier_spill(void)
+{
+    if (!atomic_get(&tier.ready) || atomic_get(&tier.stage_n) ||
+        mem_cache_count() < CONFIG_FLASH_TIER_SPILL_THRESHOLD) {
+        return false;
+    }
+
+    size_t n = mem_cache_pop_n(tier.stage, CONFIG_FLASH_TIER_BATCH);
+    if (n == 0) {
+        return false;
+    }
+
+    atomic_set(&tier.stage_n, (atomic_val_t)n);
+    k_sem_give(&tier.wake);
+    return true;
+}
+
+/**
+ * @brief Get the oldest samples restored from flash.
+ *
+ * @param samples Set to the restored samples.
+ * @return Number of restored samples available, 0 if the flash tier is
+ *         empty or not mounted, or -EAGAIN if older samples are still
+ *         on their way.
+ */
+int flash_tier_peek(const sensor_sample_t **samples)
+{
+    if (!atomic_get(&tier.ready)) {
+        return 0;
+    }
+
+    size_t n = (size_t)atomic_get(&tier.drain_n);
+
+    if (n) {
+        *samples = &tier.drain[tier.drain_pos];
+        return (int)(n - tier.drain_pos);
+    }
+
+    /* A batch being written or still in flash is older than the RAM cache */
+    if (atomic_get(&tier.stage_n) || atomic_get(&tier.stored)) {
+        return -EAGAIN;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Release the @p n oldest samples obtained from flash_tier_peek().
+ *
+ * @param n Number of samples sent.
+ */
+void flash_tier_commit(size_t n)
+{
+    tier.drain_pos += n;
+
+    if (tier.drain_pos >= (size_t)atomic_get(&tier.drain_n)) {
+        atomic_clear(&tier.drain_n);
+        k_sem_give(&tier.wake);
+    }
+}
+
+/**
+ * @brief Get the flash tier fill level.
+ *
+ * @param level Filled with the current counters.
+ */
+void flash_tier_get_level(flash_tier_level_t *level)
+{
+    size_t drain = (size_t)atomic_get(&tier.drain_n);
+
+    level->stored = (uint32_t)atomic_get(&tier.stored) +
+                    (uint32_t)atomic_get(&tier.stage_n) +
+                    (uint32_t)(drain ? drain - tier.drain_pos : 0);
+    level->capacity = tier.capacity;
+    level->dropped = (uint32_t)atomic_get(&tier.dropped);
+}
+
+/**
+ * @brief Initialize the flash tier.
+ *
+ * Flash itself is mounted by the flash tier thread so boot is not delayed.
+ */
+static int flash_tier_init(void)
+{
+    k_sem_init(&tier.wake, 0, 1);
+
+    return 0;
+}
+
+SYS_INIT(flash_tier_init, POST_KERNEL, CONFIG_KERNEL_INIT_PRIORITY_DEVICE);
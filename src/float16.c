@@ -0,0 +1,181 @@
+#include <zephyr/kernel.h>
+#include <string.h>
+#include "float16.h"
+
+/*
+binary16:
+     S | EEEEE | MMMMMMMMMM
+    15 | 14 10 | 9        0
+
+binary32:
+     S | EEEEEEEE | MMMMMMMMMMMMMMMMMMMMMMM
+    31 | 30    23 | 22                    0
+
+binary64:
+     S | EEEEEEEEEEE | MMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMM
+    63 | 62       52 | 51                                                 0
+*/
+
+#define F16_MANT_BITS  10
+#define F16_MANT_MASK  0x03FF
+#define F16_EXP_MASK   0x1F
+#define F16_EXP_MAX    F16_EXP_MASK   /* Infinity or NaN */
+#define F16_BIAS       15
+
+#define F32_MANT_BITS  23
+#define F32_EXP_MAX    0xFF
+#define F32_BIAS       127
+
+#define F64_MANT_BITS  52
+#define F64_EXP_MAX    0x7FF
+#define F64_BIAS       1023
+
+#if defined(CONFIG_FLOAT16_TABLE)
+/* Biased target exponent for every binary16 exponent field. Entry 0 is
+ * never read, zero and subnormals are handled separately. */
+#define F32_EXP(e) ((e) - F16_BIAS + F32_BIAS)
+#define F64_EXP(e) ((e) - F16_BIAS + F64_BIAS)
+
+static const uint8_t f32_exp[F16_EXP_MAX + 1] = {
+    0,           F32_EXP(1),  F32_EXP(2),  F32_EXP(3),  F32_EXP(4),  F32_EXP(5),  F32_EXP(6),  F32_EXP(7),
+    F32_EXP(8),  F32_EXP(9),  F32_EXP(10), F32_EXP(11), F32_EXP(12), F32_EXP(13), F32_EXP(14), F32_EXP(15),
+    F32_EXP(16), F32_EXP(17), F32_EXP(18), F32_EXP(19), F32_EXP(20), F32_EXP(21), F32_EXP(22), F32_EXP(23),
+    F32_EXP(24), F32_EXP(25), F32_EXP(26), F32_EXP(27), F32_EXP(28), F32_EXP(29), F32_EXP(30), F32_EXP_MAX,
+};
+
+static const uint16_t f64_exp[F16_EXP_MAX + 1] = {
+    0,           F64_EXP(1),  F64_EXP(2),  F64_EXP(3),  F64_EXP(4),  F64_EXP(5),  F64_EXP(6),  F64_EXP(7),
+    F64_EXP(8),  F64_EXP(9),  F64_EXP(10), F64_EXP(11), F64_EXP(12), F64_EXP(13), F64_EXP(14), F64_EXP(15),
+    F64_EXP(16), F64_EXP(17), F64_EXP(18), F64_EXP(19), F64_EXP(20), F64_EXP(21), F64_EXP(22), F64_EXP(23),
+    F64_EXP(24), F64_EXP(25), F64_EXP(26), F64_EXP(27), F64_EXP(28), F64_EXP(29), F64_EXP(30), F64_EXP_MAX,
+};
+#endif /* CONFIG_FLOAT16_TABLE */
+
+
+/**
+ * @brief Rebias a normal, infinite or NaN binary16 exponent field.
+ *
+ * @param exp     Exponent field, 1 to F16_EXP_MAX.
+ * @param bias    Exponent bias of the target format.
+ * @param exp_max All-ones exponent field of the target format.
+ * @return Exponent field in the target format.
+ */
+static inline uint32_t f16_rebias(uint32_t exp, uint32_t bias, uint32_t exp_max)
+{
+    /* Compiles to a conditional select, not a branch */
+    return (exp == F16_EXP_MAX) ? exp_max : exp - F16_BIAS + bias;
+}
+
+/**
+ * @brief Normalize the mantissa of a binary16 subnormal.
+ *
+ * Shifts the leading 1 up to the implicit bit, which is then dropped.
+ *
+ * @param mant Non-zero mantissa field, replaced by the normalized fraction.
+ * @return Unbiased exponent of the value.
+ */
+static inline int32_t f16_normalize(uint32_t *mant)
+{
+    int shift = __builtin_clz(*mant) - (31 - F16_MANT_BITS);
+
+    *mant = (*mant << shift) & F16_MANT_MASK;
+    return 1 - F16_BIAS - shift;
+}
+
+/**
+ * @brief Widen an IEEE-754 binary16 value to binary32.
+ *
+ * @param h Raw binary16 bits.
+ * @return The same value as a float.
+ */
+float float16_to_float(uint16_t h)
+{
+    uint32_t sign = (uint32_t)(h >> 15) << 31;
+    uint32_t exp = (h >> F16_MANT_BITS) & F16_EXP_MASK;
+    uint32_t mant = h & F16_MANT_MASK;
+    uint32_t bits;
+    float f;
+
+    if (exp == 0) {
+        /* Zero keeps an all-zero pattern, subnormals become normal */
+        bits = sign;
+        if (mant) {
+            exp = f16_normalize(&mant) + F32_BIAS;
+            bits |= (exp << F32_MANT_BITS) | (mant << (F32_MANT_BITS - F16_MANT_BITS));
+        }
+    } else {
+#if defined(CONFIG_FLOAT16_TABLE)
+        exp = f32_exp[exp];
+#else
+        exp = f16_rebias(exp, F32_BIAS, F32_EXP_MAX);
+#endif /* CONFIG_FLOAT16_TABLE */
+        bits = sign | (exp << F32_MANT_BITS) | (mant << (F32_MANT_BITS - F16_MANT_BITS));
+    }
+
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+/**
+ * @brief Widen an IEEE-754 binary16 value to binary64.
+ *
+ * @param h Raw binary16 bits.
+ * @return The same value as a double.
+ */
+double float16_to_double(uint16_t h)
+{
+    uint64_t sign = (uint64_t)(h >> 15) << 63;
+    uint32_t exp = (h >> F16_MANT_BITS) & F16_EXP_MASK;
+    uint32_t mant = h & F16_MANT_MASK;
+    uint64_t bits;
+    double d;
+
+    if (exp == 0) {
+        /* Zero keeps an all-zero pattern, subnormals become normal */
+        bits = sign;
+        if (mant) {
+            exp = f16_normalize(&mant) + F64_BIAS;
+            bits |= ((uint64_t)exp << F64_MANT_BITS) |
+                    ((uint64_t)mant << (F64_MANT_BITS - F16_MANT_BITS));
+        }
+    } else {
+#if defined(CONFIG_FLOAT16_TABLE)
+        exp = f64_exp[exp];
+#else
+        exp = f16_rebias(exp, F64_BIAS, F64_EXP_MAX);
+#endif /* CONFIG_FLOAT16_TABLE */
+        bits = sign | ((uint64_t)exp << F64_MANT_BITS) |
+               ((uint64_t)mant << (F64_MANT_BITS - F16_MANT_BITS));
+    }
+
+    memcpy(&d, &bits, sizeof(d));
+    return d;
+}
+
+/**
+ * @brief Widen an array of binary16 values to binary32.
+ *
+ * @param in  Raw binary16 bits.
+ * @param out Destination, @p n floats.
+ * @param n   Number of values.
+ */
+void float16_to_float_n(const uint16_t *in, float *out, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        out[i] = float16_to_float(in[i]);
+    }
+}
+
+/**
+ * @brief Widen an array of binary16 values to binary64.
+ *
+ * @param in  Raw binary16 bits.
+ * @param out Destination, @p n doubles.
+ * @param n   Number of values.
+ */
+void float16_to_double_n(const uint16_t *in, double *out, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        out[i] = float16_to_double(in[i]);
+    }
+}
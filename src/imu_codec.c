@@ -0,0 +1,221 @@
+#include <zephyr/kernel.h>
+#include <errno.h>
+#include <string.h>
+#include "imu_codec.h"
+#if defined(CONFIG_SAMPLE_FORMAT_COMPACT)
+#include "imu_kernels.h"
+#endif /* CONFIG_SAMPLE_FORMAT_COMPACT */
+
+/* Varint continuation bit and payload mask */
+#define VARINT_CONT 0x80
+#define VARINT_MASK 0x7F
+
+/* A 32-bit value never needs more than 5 varint bytes */
+#define VARINT_MAX_LEN 5
+
+/**
+ * @brief Map a signed delta to an unsigned value with small magnitude.
+ *
+ * 0, -1, 1, -2, ... become 0, 1, 2, 3, ...
+ */
+static inline uint32_t zigzag_encode(int32_t v)
+{
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+/**
+ * @brief Inverse of zigzag_encode().
+ */
+static inline int32_t zigzag_decode(uint32_t v)
+{
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+/**
+ * @brief Write @p v as a LEB128 varint.
+ *
+ * @return Number of bytes written, or 0 if @p cap is too small.
+ */
+static size_t varint_put(uint32_t v, uint8_t *out, size_t cap)
+{
+    size_t n = 0;
+
+    do {
+        if (n == cap) {
+            return 0;
+        }
+        uint8_t byte = v & VARINT_MASK;
+        v >>= 7;
+        out[n++] = byte | (v ? VARINT_CONT : 0);
+    } while (v);
+
+    return n;
+}
+
+/**
+ * @brief Read a LEB128 varint.
+ *
+ * @return Number of bytes consumed, or 0 if truncated or too long.
+ */
+static size_t varint_get(const uint8_t *in, size_t len, uint32_t *v)
+{
+    uint32_t result = 0;
+
+    for (size_t n = 0; n < MIN(len, (size_t)VARINT_MAX_LEN); n++) {
+        result |= (uint32_t)(in[n] & VARINT_MASK) << (7 * n);
+        if (!(in[n] & VARINT_CONT)) {
+            *v = result;
+            return n + 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Reset a codec state.
+ *
+ * @param codec Codec state to reset.
+ */
+void imu_codec_reset(imu_codec_t *codec)
+{
+    memset(codec, 0, sizeof(*codec));
+}
+
+/**
+ * @brief Encode one sample as a delta or keyframe record.
+ *
+ * @param codec  Encoder state, only advanced if the record fits.
+ * @param sample Sample to encode.
+ * @param out    Destination buffer.
+ * @param cap    Size of @p out in bytes.
+ * @return Encoded length in bytes, or 0 if the record does not fit in @p cap.
+ */
+size_t imu_codec_encode(imu_codec_t *codec, const sensor_sample_t *sample,
+                        uint8_t *out, size_t cap)
+{
+    bool keyframe = (codec->since_key == 0);
+    size_t off = 1;
+
+    if (cap < 1 + sizeof(sample->temp)) {
+        return 0;
+    }
+
+    out[0] = keyframe ? IMU_CODEC_FLAG_KEYFRAME : 0;
+
+    /* Both only move forward, so plain varints of the difference suffice */
+    uint32_t hdr[2] = {
+        keyframe ? sample->hdr.seq : sample->hdr.seq - codec->prev_hdr.seq,
+        keyframe ? sample->hdr.timestamp : sample->hdr.timestamp - codec->prev_hdr.timestamp,
+    };
+
+    for (size_t i = 0; i < ARRAY_SIZE(hdr); i++) {
+        size_t n = varint_put(hdr[i], &out[off], cap - off);
+        if (n == 0) {
+            return 0;
+        }
+        off += n;
+    }
+
+#if defined(CONFIG_SAMPLE_FORMAT_COMPACT)
+    /* 16-bit deltas, a whole block per kernel call */
+    uint16_t zz[IMU_SAMPLE_LEN];
+
+    if (!keyframe) {
+        imu_kernel_delta(zz, sample->imu, codec->prev);
+    }
+#endif /* CONFIG_SAMPLE_FORMAT_COMPACT */
+
+    for (int i = 0; i < IMU_SAMPLE_LEN; i++) {
+        uint32_t cur = sample->imu[i];
+#if defined(CONFIG_SAMPLE_FORMAT_COMPACT)
+        uint32_t v = keyframe ? cur : zz[i];
+#else
+        uint32_t v = keyframe ? cur : zigzag_encode((int32_t)(cur - codec->prev[i]));
+#endif /* CONFIG_SAMPLE_FORMAT_COMPACT */
+        size_t n = varint_put(v, &out[off], cap - off);
+        if (n == 0) {
+            return 0;
+        }
+        off += n;
+    }
+
+    if (cap - off < sizeof(sample->temp)) {
+        return 0;
+    }
+    memcpy(&out[off], sample->temp, sizeof(sample->temp));
+    off += sizeof(sample->temp);
+
+    /* Record fits, commit the encoder state */
+    codec->prev_hdr = sample->hdr;
+    for (int i = 0; i < IMU_SAMPLE_LEN; i++) {
+        codec->prev[i] = sample->imu[i];
+    }
+    codec->since_key = (codec->since_key + 1) % CONFIG_IMU_CODEC_KEYFRAME_INTERVAL;
+
+    return off;
+}
+
+/**
+ * @brief Decode one record produced by imu_codec_encode().
+ *
+ * @param codec  Decoder state.
+ * @param in     Encoded record.
+ * @param len    Bytes available at @p in.
+ * @param sample Decoded sample.
+ * @param used   Set to the record length, so the caller can step to the next one.
+ * @return 0 on success, -EAGAIN if a delta record arrived before any keyframe
+ *         (the record is skipped), or -EINVAL if it is truncated or malformed.
+ */
+int imu_codec_decode(imu_codec_t *codec, const uint8_t *in, size_t len,
+                     sensor_sample_t *sample, size_t *used)
+{
+    sample_imu_t words[IMU_SAMPLE_LEN];
+    uint32_t hdr[2];
+    size_t off = 1;
+
+    if (len < 1) {
+        return -EINVAL;
+    }
+
+    bool keyframe = (in[0] & IMU_CODEC_FLAG_KEYFRAME);
+
+    for (size_t i = 0; i < ARRAY_SIZE(hdr); i++) {
+        size_t n = varint_get(&in[off], len - off, &hdr[i]);
+        if (n == 0) {
+            return -EINVAL;
+        }
+        off += n;
+    }
+
+    for (int i = 0; i < IMU_SAMPLE_LEN; i++) {
+        uint32_t v;
+        size_t n = varint_get(&in[off], len - off, &v);
+        if (n == 0) {
+            return -EINVAL;
+        }
+        words[i] = keyframe ? v : codec->prev[i] + (uint32_t)zigzag_decode(v);
+        off += n;
+    }
+
+    if (len - off < sizeof(sample->temp)) {
+        return -EINVAL;
+    }
+    memcpy(sample->temp, &in[off], sizeof(sample->temp));
+    *used = off + sizeof(sample->temp);
+
+    if (!keyframe && !codec->synced) {
+        return -EAGAIN;
+    }
+
+    sample->hdr.seq = keyframe ? hdr[0] : codec->prev_hdr.seq + hdr[0];
+    sample->hdr.timestamp = keyframe ? hdr[1] : codec->prev_hdr.timestamp + hdr[1];
+    codec->prev_hdr = sample->hdr;
+    for (int i = 0; i < IMU_SAMPLE_LEN; i++) {
+        codec->prev[i] = words[i];
+        sample->imu[i] = words[i];
+    }
+    codec->synced = true;
+
+    return 0;
+}
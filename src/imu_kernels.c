@@ -0,0 +1,193 @@
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+
+#include "imu_kernels.h"
+
+#if IMU_KERNEL_SIMD
+#include <cmsis_core.h>
+#endif /* IMU_KERNEL_SIMD */
+
+/* Readings handled per 32-bit SIMD word */
+#define KERNEL_LANES 2
+
+BUILD_ASSERT(sizeof(sample_imu_t) == sizeof(uint16_t),
+             "IMU kernels work on the 16-bit readings of the compact format");
+/* Readings covered by whole SIMD words, an odd last one is done alone */
+#define KERNEL_PAIRED_LEN (IMU_SAMPLE_LEN & ~(KERNEL_LANES - 1))
+
+/* Sums of up to 16 readings below 2^12 fit the 16-bit lanes */
+BUILD_ASSERT(IMU_SAMPLE_LEN <= 32, "IMU block too long for the 16-bit lane sums");
+BUILD_ASSERT(offsetof(sensor_sample_t, imu) % sizeof(uint32_t) == 0,
+             "IMU block must be word aligned for the paired loads");
+
+
+/******************************************************************************
+ * Scalar
+ ******************************************************************************/
+
+/**
+ * @brief Zigzag-encoded differences of two IMU blocks, scalar version.
+ *
+ * @param zz   Zigzag value of cur[i] - prev[i], per reading.
+ * @param cur  Readings of the current sample, 4-byte aligned.
+ * @param prev Readings of the previous sample, 4-byte aligned.
+ */
+void imu_kernel_delta_scalar(uint16_t zz[IMU_SAMPLE_LEN], const sample_imu_t cur[IMU_SAMPLE_LEN],
+                             const sample_imu_t prev[IMU_SAMPLE_LEN])
+{
+    for (int i = 0; i < IMU_SAMPLE_LEN; i++) {
+        int16_t d = (int16_t)(cur[i] - prev[i]);
+
+        zz[i] = (uint16_t)((uint16_t)d << 1) ^ (uint16_t)(d >> 15);
+    }
+}
+
+/**
+ * @brief Per-channel statistics of one IMU block, scalar version.
+ *
+ * @param st       Minimum, maximum, sum and sum of squares of each channel.
+ * @param imu      Readings, 4-byte aligned, each below 2^12.
+ * @param channels 1 to IMU_KERNEL_MAX_CHANNELS, dividing IMU_SAMPLE_LEN.
+ */
+void imu_kernel_reduce_scalar(imu_kernel_stats_t *st, const sample_imu_t imu[IMU_SAMPLE_LEN],
+                              int channels)
+{
+    for (int c = 0; c < channels; c++) {
+        st->min[c] = UINT16_MAX;
+        st->max[c] = 0;
+        st->sum[c] = 0;
+        st->sumsq[c] = 0;
+    }
+
+    for (int i = 0; i < IMU_SAMPLE_LEN; i++) {
+        int c = i % channels;
+        uint16_t v = imu[i];
+
+        st->min[c] = MIN(st->min[c], v);
+        st->max[c] = MAX(st->max[c], v);
+        st->sum[c] += v;
+        st->sumsq[c] += (uint32_t)v * v;
+    }
+}
+
+
+/******************************************************************************
+ * SIMD
+ ******************************************************************************/
+
+#if IMU_KERNEL_SIMD
+/**
+ * @brief Load two adjacent readings as one word, low lane first.
+ */
+static inline uint32_t kernel_load2(const uint16_t *p)
+{
+    uint32_t w;
+
+    memcpy(&w, p, sizeof(w));
+    return w;
+}
+
+/**
+ * @brief Store two adjacent readings from one word, low lane first.
+ */
+static inline void kernel_store2(uint16_t *p, uint32_t w)
+{
+    memcpy(p, &w, sizeof(w));
+}
+
+/**
+ * @brief Zigzag-encoded differences of two IMU blocks, SIMD version.
+ *
+ * One SSUB16 takes both differences of a pair; a second one against
+ * zero sets the GE flags of the non-negative lanes, so SEL turns them
+ * into the per-lane sign mask of the zigzag.
+ *
+ * @param zz   Zigzag value of cur[i] - prev[i], per reading.
+ * @param cur  Readings of the current sample, 4-byte aligned.
+ * @param prev Readings of the previous sample, 4-byte aligned.
+ */
+void imu_kernel_delta_simd(uint16_t zz[IMU_SAMPLE_LEN], const sample_imu_t cur[IMU_SAMPLE_LEN],
+                           const sample_imu_t prev[IMU_SAMPLE_LEN])
+{
+    for (int i = 0; i < KERNEL_PAIRED_LEN; i += KERNEL_LANES) {
+        uint32_t d = __SSUB16(kernel_load2(&cur[i]), kernel_load2(&prev[i]));
+
+        (void)__SSUB16(d, 0);
+        uint32_t sign = __SEL(0, UINT32_MAX);
+
+        kernel_store2(&zz[i], ((d << 1) & 0xFFFEFFFEU) ^ sign);
+    }
+
+#if KERNEL_PAIRED_LEN < IMU_SAMPLE_LEN
+    int16_t d = (int16_t)(cur[KERNEL_PAIRED_LEN] - prev[KERNEL_PAIRED_LEN]);
+
+    zz[KERNEL_PAIRED_LEN] = (uint16_t)((uint16_t)d << 1) ^ (uint16_t)(d >> 15);
+#endif /* KERNEL_PAIRED_LEN < IMU_SAMPLE_LEN */
+}
+
+/**
+ * @brief Per-channel statistics of one IMU block, SIMD version.
+ *
+ * Each word holds two neighbouring channels, so with 4 channels the
+ * words alternate between two accumulator pairs and with 1 or 2 all go
+ * to the first. USUB16 + SEL keep the per-lane minimum and maximum,
+ * UADD16 the sums (at most 16 readings below 2^12 per lane, no carry
+ * out) and SMLABB/SMLATT the squares of the low and high lane.
+ *
+ * @param st       Minimum, maximum, sum and sum of squares of each channel.
+ * @param imu      Readings, 4-byte aligned, each below 2^12.
+ * @param channels 1, 2 or 4, dividing IMU_SAMPLE_LEN.
+ */
+void imu_kernel_reduce_simd(imu_kernel_stats_t *st, const sample_imu_t imu[IMU_SAMPLE_LEN],
+                            int channels)
+{
+    int pairs = (channels == IMU_KERNEL_MAX_CHANNELS) ? 2 : 1;
+    uint32_t min[2] = { UINT32_MAX, UINT32_MAX };
+    uint32_t max[2] = { 0, 0 };
+    uint32_t sum[2] = { 0, 0 };
+    uint32_t sq_lo[2] = { 0, 0 };
+    uint32_t sq_hi[2] = { 0, 0 };
+
+    for (int i = 0; i < KERNEL_PAIRED_LEN; i += KERNEL_LANES) {
+        int p = (i / KERNEL_LANES) % pairs;
+        uint32_t w = kernel_load2(&imu[i]);
+
+        (void)__USUB16(w, min[p]);
+        min[p] = __SEL(min[p], w);
+        (void)__USUB16(w, max[p]);
+        max[p] = __SEL(w, max[p]);
+        sum[p] = __UADD16(sum[p], w);
+        sq_lo[p] = __SMLABB(w, w, sq_lo[p]);
+        sq_hi[p] = __SMLATT(w, w, sq_hi[p]);
+    }
+
+    for (int p = 0; p < pairs; p++) {
+        st->min[2 * p] = (uint16_t)min[p];
+        st->min[2 * p + 1] = (uint16_t)(min[p] >> 16);
+        st->max[2 * p] = (uint16_t)max[p];
+        st->max[2 * p + 1] = (uint16_t)(max[p] >> 16);
+        st->sum[2 * p] = sum[p] & 0xFFFF;
+        st->sum[2 * p + 1] = sum[p] >> 16;
+        st->sumsq[2 * p] = sq_lo[p];
+        st->sumsq[2 * p + 1] = sq_hi[p];
+    }
+
+    if (channels == 1) {
+        /* Even and odd readings are the same channel, fold the lanes */
+        st->min[0] = MIN(st->min[0], st->min[1]);
+        st->max[0] = MAX(st->max[0], st->max[1]);
+        st->sum[0] += st->sum[1];
+        st->sumsq[0] += st->sumsq[1];
+#if KERNEL_PAIRED_LEN < IMU_SAMPLE_LEN
+        /* Only a single channel divides an odd length */
+        uint16_t v = imu[KERNEL_PAIRED_LEN];
+
+        st->min[0] = MIN(st->min[0], v);
+        st->max[0] = MAX(st->max[0], v);
+        st->sum[0] += v;
+        st->sumsq[0] += (uint32_t)v * v;
+#endif /* KERNEL_PAIRED_LEN < IMU_SAMPLE_LEN */
+    }
+}
+#endif /* IMU_KERNEL_SIMD */
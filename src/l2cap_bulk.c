@@ -0,0 +1,243 @@
+#include <zephyr/kernel.h>
+#include <zephyr/init.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/net_buf.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/l2cap.h>
+
+#include "l2cap_bulk.h"
+#include "tx_engine.h"
+
+LOG_MODULE_REGISTER(l2cap_bulk, LOG_LEVEL_INF);
+
+
+/******************************************************************************
+ * Data Types
+ ******************************************************************************/
+
+typedef struct {
+    struct bt_l2cap_le_chan chan;   /* The single bulk channel */
+    bool connected;                 /* Channel is set up and may carry SDUs */
+} l2cap_bulk_t;
+
+
+/******************************************************************************
+ * Static Variables
+ ******************************************************************************/
+
+static l2cap_bulk_t bulk;
+
+NET_BUF_POOL_FIXED_DEFINE(bulk_pool, CONFIG_L2CAP_BULK_TX_BUFS,
+                          BT_L2CAP_SDU_BUF_SIZE(CONFIG_L2CAP_BULK_SDU_LEN),
+                          CONFIG_BT_CONN_TX_USER_DATA_SIZE, NULL);
+
+
+/******************************************************************************
+ * L2CAP Callbacks
+ ******************************************************************************/
+
+/**
+ * @brief Bulk channel connected callback.
+ *
+ * @param chan The L2CAP channel.
+ */
+static void bulk_connected(struct bt_l2cap_chan *chan)
+{
+    bulk.connected = true;
+    LOG_INF("Bulk channel connected (tx mtu %u, mps %u)",
+            bulk.chan.tx.mtu, bulk.chan.tx.mps);
+}
+
+/**
+ * @brief Bulk channel disconnected callback.
+ *
+ * A transfer in progress stops; samples of SDUs not yet queued stay cached.
+ *
+ * @param chan The L2CAP channel.
+ */
+static void bulk_disconnected(struct bt_l2cap_chan *chan)
+{
+    bulk.connected = false;
+    tx_engine_bulk_stop();
+    LOG_INF("Bulk channel disconnected");
+}
+
+/**
+ * @brief Bulk channel receive callback.
+ *
+ * The channel is download-only; control goes through the GATT control point.
+ *
+ * @param chan The L2CAP channel.
+ * @param buf  Received SDU.
+ * @return 0, the data is discarded.
+ */
+static int bulk_recv(struct bt_l2cap_chan *chan, struct net_buf *buf)
+{
+    return 0;
+}
+
+/**
+ * @brief Bulk channel SDU sent callback.
+ *
+ * A buffer went back to the pool, let the TX engine queue the next SDU.
+ *
+ * @param chan The L2CAP channel.
+ */
+static void bulk_sent(struct bt_l2cap_chan *chan)
+{
+    tx_engine_kick();
+}
+
+static const struct bt_l2cap_chan_ops bulk_ops = {
+    .connected = bulk_connected,
+    .disconnected = bulk_disconnected,
+    .recv = bulk_recv,
+    .sent = bulk_sent,
+};
+
+/**
+ * @brief Accept an incoming bulk channel.
+ *
+ * @param conn   The connection object.
+ * @param server The registered server.
+ * @param chan   Set to the channel to use.
+ * @return 0 on success, -ENOMEM if the bulk channel is already in use.
+ */
+static int bulk_accept(struct bt_conn *conn, struct bt_l2cap_server *server,
+                       struct bt_l2cap_chan **chan)
+{
+    if (bulk.chan.chan.conn) {
+        return -ENOMEM;
+    }
+
+    bulk.chan.chan.ops = &bulk_ops;
+    bulk.chan.rx.mtu = CONFIG_L2CAP_BULK_SDU_LEN;
+    *chan = &bulk.chan.chan;
+    return 0;
+}
+
+static struct bt_l2cap_server bulk_server = {
+    .psm = CONFIG_L2CAP_BULK_PSM,
+#if defined(CONFIG_BOND)
+    .sec_level = BT_SECURITY_L2,
+#endif /* CONFIG_BOND */
+    .accept = bulk_accept,
+};
+
+
+/******************************************************************************
+ * Public API
+ ******************************************************************************/
+
+/**
+ * @brief Handle a write to the bulk control point.
+ *
+ * @param data Written value, opcode first.
+ * @param len  Length of @p data.
+ * @return 0 on success or a negative error code.
+ */
+int l2cap_bulk_control(const uint8_t *data, size_t len)
+{
+    if (len == 0) {
+        return -EINVAL;
+    }
+
+    switch (data[0]) {
+    case BULK_CP_OP_START:
+    case BULK_CP_OP_RESUME: {
+        uint16_t seq = 0;
+
+        if (data[0] == BULK_CP_OP_RESUME) {
+            if (len != 1 + sizeof(uint16_t)) {
+                return -EINVAL;
+            }
+            seq = sys_get_le16(&data[1]);
+        } else if (len != 1) {
+            return -EINVAL;
+        }
+
+        if (!bulk.connected) {
+            return -ENOTCONN;
+        }
+
+        tx_engine_bulk_start(&bulk.chan.chan, seq);
+        return 0;
+    }
+    case BULK_CP_OP_STOP:
+        if (len != 1) {
+            return -EINVAL;
+        }
+        tx_engine_bulk_stop();
+        return 0;
+    default:
+        return -ENOTSUP;
+    }
+}
+
+/**
+ * @brief Get the bulk control point value.
+ *
+ * @param status Filled with the current status.
+ */
+void l2cap_bulk_get_status(bulk_cp_status_t *status)
+{
+    uint16_t next_seq;
+
+    status->active = tx_engine_bulk_status(&next_seq);
+    status->psm = sys_cpu_to_le16(CONFIG_L2CAP_BULK_PSM);
+    status->next_seq = sys_cpu_to_le16(next_seq);
+}
+
+/**
+ * @brief Allocate an SDU buffer for the bulk channel.
+ *
+ * @param cap Set to the largest SDU the peer accepts in this buffer.
+ * @return A buffer, or NULL if all buffers are in flight.
+ */
+struct net_buf *l2cap_bulk_alloc(size_t *cap)
+{
+    struct net_buf *buf = net_buf_alloc(&bulk_pool, K_NO_WAIT);
+
+    if (!buf) {
+        return NULL;
+    }
+
+    net_buf_reserve(buf, BT_L2CAP_SDU_CHAN_SEND_RESERVE);
+    *cap = MIN(net_buf_tailroom(buf), (size_t)bulk.chan.tx.mtu);
+    return buf;
+}
+
+/**
+ * @brief Send an SDU on the bulk channel.
+ *
+ * @param buf SDU from l2cap_bulk_alloc(); consumed even on error.
+ * @return 0 on success or a negative error code.
+ */
+int l2cap_bulk_send(struct net_buf *buf)
+{
+    int err = bt_l2cap_chan_send(&bulk.chan.chan, buf);
+    if (err < 0) {
+        net_buf_unref(buf);
+        return err;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Register the bulk L2CAP server.
+ */
+static int l2cap_bulk_init(void)
+{
+    int err = bt_l2cap_server_register(&bulk_server);
+    if (err) {
+        LOG_ERR("Bulk L2CAP server registration failed (err %d)", err);
+        return err;
+    }
+
+    LOG_INF("Bulk L2CAP server on PSM 0x%04x", CONFIG_L2CAP_BULK_PSM);
+    return 0;
+}
+
+SYS_INIT(l2cap_bulk_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -0,0 +1,347 @@
+#include <zephyr/kernel.h>
+#include <zephyr/init.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+
+#include "flash_tier.h"
+#include "link_tune.h"
+#include "mem_cache.h"
+
+LOG_MODULE_REGISTER(link_tune, LOG_LEVEL_INF);
+
+
+/******************************************************************************
+ * Data Types
+ ******************************************************************************/
+
+typedef struct {
+    struct bt_conn *conn;           /* Connection being tuned, NULL when stopped */
+    link_tune_info_t info;          /* Last negotiated values, CPU byte order */
+} link_tune_conn_t;
+
+typedef struct {
+    struct k_work_delayable work;                /* Periodic backlog check */
+    struct k_mutex lock;                         /* Protects conns */
+    link_tune_conn_t conns[CONFIG_BT_MAX_CONN];  /* One slot per possible connection */
+} link_tune_t;
+
+
+/******************************************************************************
+ * Static Variables
+ ******************************************************************************/
+
+static link_tune_t tune;
+
+/* Short interval, no latency: drains a backlog at the highest rate */
+static const struct bt_le_conn_param fast_param = {
+    .interval_min = CONFIG_LINK_TUNE_FAST_INTERVAL_MIN,
+    .interval_max = CONFIG_LINK_TUNE_FAST_INTERVAL_MAX,
+    .latency = 0,
+    .timeout = CONFIG_LINK_TUNE_TIMEOUT,
+};
+
+/* Long interval with peripheral latency: keeps the link alive cheaply */
+static const struct bt_le_conn_param slow_param = {
+    .interval_min = CONFIG_LINK_TUNE_SLOW_INTERVAL_MIN,
+    .interval_max = CONFIG_LINK_TUNE_SLOW_INTERVAL_MAX,
+    .latency = CONFIG_LINK_TUNE_SLOW_LATENCY,
+    .timeout = CONFIG_LINK_TUNE_TIMEOUT,
+};
+
+/* Supervision timeout must exceed (1 + latency) * interval * 2 */
+BUILD_ASSERT(CONFIG_LINK_TUNE_TIMEOUT * 10 * 100 >
+             (1 + CONFIG_LINK_TUNE_SLOW_LATENCY) * CONFIG_LINK_TUNE_SLOW_INTERVAL_MAX * 125 * 2,
+             "CONFIG_LINK_TUNE_TIMEOUT too short for the slow profile");
+
+
+/******************************************************************************
+ * Backlog tracking
+ ******************************************************************************/
+
+/**
+ * @brief Get the tuning slot of a connection.
+ *
+ * Called with the lock held.
+ *
+ * @param conn The connection object.
+ * @return The slot, or NULL if @p conn is not being tuned.
+ */
+static link_tune_conn_t *link_tune_find(struct bt_conn *conn)
+{
+    link_tune_conn_t *c = &tune.conns[bt_conn_index(conn)];
+
+    return (c->conn == conn) ? c : NULL;
+}
+
+/**
+ * @brief Count the samples waiting to be sent.
+ *
+ * @return RAM cache plus flash tier fill level.
+ */
+static size_t link_tune_backlog(void)
+{
+    size_t backlog = mem_cache_count();
+
+#if defined(CONFIG_FLASH_TIER)
+    flash_tier_level_t level;
+
+    flash_tier_get_level(&level);
+    backlog += level.stored;
+#endif /* CONFIG_FLASH_TIER */
+
+    return backlog;
+}
+
+/**
+ * @brief Request a connection parameter profile.
+ *
+ * @param c       The connection to update.
+ * @param profile LINK_TUNE_PROFILE_FAST or LINK_TUNE_PROFILE_SLOW.
+ */
+static void link_tune_request(link_tune_conn_t *c, uint8_t profile)
+{
+    const struct bt_le_conn_param *param =
+        (profile == LINK_TUNE_PROFILE_FAST) ? &fast_param : &slow_param;
+
+    int err = bt_conn_le_param_update(c->conn, param);
+    if (err && err != -EALREADY) {
+        LOG_WRN("Connection parameter update failed (err %d)", err);
+        return;
+    }
+
+    c->info.profile = profile;
+    LOG_INF("Requesting %s connection interval",
+            profile == LINK_TUNE_PROFILE_FAST ? "fast" : "slow");
+}
+
+/**
+ * @brief Periodic backlog check.
+ *
+ * Switches every tuned connection to the fast profile once the shared
+ * backlog reaches the threshold and back to the slow one when it is
+ * drained; in between the current profile is kept so the link does not
+ * flap.
+ *
+ * @param work Pointer to the work item.
+ */
+static void link_tune_work_handler(struct k_work *work)
+{
+    size_t backlog = link_tune_backlog();
+    bool active = false;
+
+    k_mutex_lock(&tune.lock, K_FOREVER);
+
+    for (size_t i = 0; i < ARRAY_SIZE(tune.conns); i++) {
+        link_tune_conn_t *c = &tune.conns[i];
+
+        if (!c->conn) {
+            continue;
+        }
+        active = true;
+
+        if (backlog >= CONFIG_LINK_TUNE_BACKLOG_THRESHOLD &&
+            c->info.profile != LINK_TUNE_PROFILE_FAST) {
+            link_tune_request(c, LINK_TUNE_PROFILE_FAST);
+        } else if (backlog == 0 && c->info.profile != LINK_TUNE_PROFILE_SLOW) {
+            link_tune_request(c, LINK_TUNE_PROFILE_SLOW);
+        }
+    }
+
+    k_mutex_unlock(&tune.lock);
+
+    if (active) {
+        k_work_schedule(&tune.work, K_MSEC(CONFIG_LINK_TUNE_CHECK_INTERVAL_MS));
+    }
+}
+
+
+/******************************************************************************
+ * Connection Callbacks
+ ******************************************************************************/
+
+/**
+ * @brief Connection parameters updated callback.
+ *
+ * @param conn     The connection object.
+ * @param interval Connection interval in 1.25 ms units.
+ * @param latency  Peripheral latency.
+ * @param timeout  Supervision timeout in 10 ms units.
+ */
+static void le_param_updated(struct bt_conn *conn, uint16_t interval,
+                             uint16_t latency, uint16_t timeout)
+{
+    k_mutex_lock(&tune.lock, K_FOREVER);
+    link_tune_conn_t *c = link_tune_find(conn);
+    if (!c) {
+        k_mutex_unlock(&tune.lock);
+        return;
+    }
+    c->info.interval = interval;
+    c->info.latency = latency;
+    c->info.timeout = timeout;
+    k_mutex_unlock(&tune.lock);
+
+    LOG_INF("Connection interval %u.%02u ms, latency %u, timeout %u ms",
+            interval * 125 / 100, interval * 125 % 100, latency, timeout * 10);
+}
+
+/**
+ * @brief PHY updated callback.
+ *
+ * @param conn  The connection object.
+ * @param param The new PHY.
+ */
+static void le_phy_updated(struct bt_conn *conn, struct bt_conn_le_phy_info *param)
+{
+    k_mutex_lock(&tune.lock, K_FOREVER);
+    link_tune_conn_t *c = link_tune_find(conn);
+    if (!c) {
+        k_mutex_unlock(&tune.lock);
+        return;
+    }
+    c->info.tx_phy = param->tx_phy;
+    c->info.rx_phy = param->rx_phy;
+    k_mutex_unlock(&tune.lock);
+
+    LOG_INF("PHY tx %u rx %u", param->tx_phy, param->rx_phy);
+}
+
+/**
+ * @brief Data length updated callback.
+ *
+ * @param conn The connection object.
+ * @param info The new data length.
+ */
+static void le_data_len_updated(struct bt_conn *conn, struct bt_conn_le_data_len_info *info)
+{
+    k_mutex_lock(&tune.lock, K_FOREVER);
+    link_tune_conn_t *c = link_tune_find(conn);
+    if (!c) {
+        k_mutex_unlock(&tune.lock);
+        return;
+    }
+    c->info.tx_max_len = info->tx_max_len;
+    c->info.rx_max_len = info->rx_max_len;
+    k_mutex_unlock(&tune.lock);
+
+    LOG_INF("Data length tx %u rx %u", info->tx_max_len, info->rx_max_len);
+}
+
+BT_CONN_CB_DEFINE(link_tune_callbacks) = {
+    .le_param_updated = le_param_updated,
+    .le_phy_updated = le_phy_updated,
+    .le_data_len_updated = le_data_len_updated,
+};
+
+
+/******************************************************************************
+ * Public API
+ ******************************************************************************/
+
+/**
+ * @brief Start tuning a new connection.
+ *
+ * @param conn The connection to tune.
+ */
+void link_tune_start(struct bt_conn *conn)
+{
+    link_tune_conn_t *c = &tune.conns[bt_conn_index(conn)];
+    struct bt_conn_info conn_info;
+
+    k_mutex_lock(&tune.lock, K_FOREVER);
+
+    if (c->conn) {
+        /* Already being tuned */
+        k_mutex_unlock(&tune.lock);
+        return;
+    }
+    c->conn = bt_conn_ref(conn);
+
+    memset(&c->info, 0, sizeof(c->info));
+    if (bt_conn_get_info(conn, &conn_info) == 0) {
+        c->info.interval = conn_info.le.interval;
+        c->info.latency = conn_info.le.latency;
+        c->info.timeout = conn_info.le.timeout;
+    }
+
+    int err = bt_conn_le_data_len_update(conn, BT_LE_DATA_LEN_PARAM_MAX);
+    if (err) {
+        LOG_WRN("Data length update failed (err %d)", err);
+    }
+
+    err = bt_conn_le_phy_update(conn, BT_CONN_LE_PHY_PARAM_2M);
+    if (err) {
+        LOG_WRN("PHY update failed (err %d)", err);
+    }
+
+    k_mutex_unlock(&tune.lock);
+
+    /* Give the central time to finish its own setup before the first request,
+     * a check already pending for another connection keeps its deadline
+     */
+    k_work_schedule(&tune.work, K_MSEC(CONFIG_LINK_TUNE_CHECK_INTERVAL_MS));
+}
+
+/**
+ * @brief Stop tuning and release the connection reference.
+ *
+ * @param conn The connection going away.
+ */
+void link_tune_stop(struct bt_conn *conn)
+{
+    k_mutex_lock(&tune.lock, K_FOREVER);
+    link_tune_conn_t *c = link_tune_find(conn);
+    if (c) {
+        bt_conn_unref(c->conn);
+        c->conn = NULL;
+        c->info.profile = LINK_TUNE_PROFILE_NONE;
+    }
+    k_mutex_unlock(&tune.lock);
+
+    /* The periodic check stops on its own once no connection is left */
+}
+
+/**
+ * @brief Get the negotiated link parameters of a connection.
+ *
+ * @param conn The connection asking.
+ * @param info Filled with the current values, little-endian.
+ */
+void link_tune_get_info(struct bt_conn *conn, link_tune_info_t *info)
+{
+    memset(info, 0, sizeof(*info));
+
+    k_mutex_lock(&tune.lock, K_FOREVER);
+
+    const link_tune_conn_t *c = link_tune_find(conn);
+    if (c) {
+        info->interval = sys_cpu_to_le16(c->info.interval);
+        info->latency = sys_cpu_to_le16(c->info.latency);
+        info->timeout = sys_cpu_to_le16(c->info.timeout);
+        info->tx_phy = c->info.tx_phy;
+        info->rx_phy = c->info.rx_phy;
+        info->tx_max_len = sys_cpu_to_le16(c->info.tx_max_len);
+        info->rx_max_len = sys_cpu_to_le16(c->info.rx_max_len);
+        info->profile = c->info.profile;
+    }
+
+    k_mutex_unlock(&tune.lock);
+
+    /* The ATT MTU is known even for a connection that is not tuned */
+    info->att_mtu = sys_cpu_to_le16(bt_gatt_get_mtu(conn));
+}
+
+/**
+ * @brief Initialize the link tuning module.
+ */
+static int link_tune_init(void)
+{
+    k_mutex_init(&tune.lock);
+    k_work_init_delayable(&tune.work, link_tune_work_handler);
+
+    return 0;
+}
+
+SYS_INIT(link_tune_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
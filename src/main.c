@@ -4,8 +4,19 @@
 #include <zephyr/bluetooth/gatt.h>
 #include <zephyr/bluetooth/hci.h>
 #include <zephyr/bluetooth/uuid.h>
-
+#include <zephyr/sys/byteorder.h>
+
+#include "adv_manager.h"
+#include "aggregate.h"
+#include "bond.h"
+#include "flash_tier.h"
+#include "l2cap_bulk.h"
+#include "link_tune.h"
 #include "mem_cache.h"
+#include "sample_format.h"
+#include "sampler.h"
+#include "telemetry.h"
+#include "tx_engine.h"
 
 LOG_MODULE_REGISTER(main, LOG_LEVEL_INF);
 
@@ -14,20 +25,55 @@ LOG_MODULE_REGISTER(main, LOG_LEVEL_INF);
  * Data Types
  ******************************************************************************/
 
-/* Device connection states for the main loop state machine */
-enum {
-    STATE_DISCONNECTED,
-    STATE_CONNECTED,
-    STATE_MAX,
-};
-
 typedef struct {
-	struct bt_conn *current_conn;  	/* Active BLE connection handle */
+	atomic_t conn_count;			/* Number of established connections */
 	struct k_timer tx_timer;	   	/* Periodic transmit timer */
-	bool notify_enabled;			/* Notification enable flag */
-	atomic_t state;					/* Atomic application state bitmap */
+	atomic_t tx_interval;			/* Transmit timer period in ms */
+	atomic_t subscribers;			/* Bitmap of connection indices with notifications enabled */
+	struct k_event events;			/* APP_EVT_* signalled to the main thread */
 } app_data_t;
 
+#if defined(CONFIG_FLASH_TIER)
+/* Sample Count characteristic value, little-endian. Starts with the RAM
+ * count so clients reading only the first 4 bytes keep working. */
+typedef struct __attribute__((packed)) {
+    uint32_t ram_count;        /* Samples in the RAM cache */
+    uint32_t flash_count;      /* Samples held in the flash tier */
+    uint32_t flash_capacity;   /* Approximate flash tier capacity in samples */
+    uint32_t flash_dropped;    /* Samples lost because flash was full */
+} sample_count_t;
+#endif /* CONFIG_FLASH_TIER */
+
+#if defined(CONFIG_TX_RETRANSMIT)
+/* One range of a Retransmit Request write, little-endian. A write may
+ * carry several back to back. */
+typedef struct __attribute__((packed)) {
+    uint32_t first_seq;   /* Sequence number of the first missing sample */
+    uint16_t count;       /* Number of consecutive missing samples */
+} retransmit_req_t;
+#endif /* CONFIG_TX_RETRANSMIT */
+
+#if defined(CONFIG_RATE_CONFIG)
+/* Rate Config characteristic value, little-endian */
+typedef struct __attribute__((packed)) {
+    uint32_t sample_interval_us;   /* Sensor sampling interval */
+    uint32_t tx_interval_ms;       /* Transmit timer period */
+#if defined(CONFIG_MEM_CACHE_BACKEND_SLAB)
+    uint32_t cache_capacity;       /* Samples the cache may hold */
+#endif /* CONFIG_MEM_CACHE_BACKEND_SLAB */
+} rate_config_t;
+#endif /* CONFIG_RATE_CONFIG */
+
+#if defined(CONFIG_AGGREGATE_GATT)
+/* Aggregate Control characteristic value, little-endian */
+typedef struct __attribute__((packed)) {
+    uint8_t mode;       /* AGGREGATE_MODE_* */
+    uint8_t channels;   /* CONFIG_AGGREGATE_CHANNELS, ignored on write */
+    uint16_t window;    /* Samples per summary */
+    uint32_t first_seq; /* First record stored in the mode in effect, ignored on write */
+} aggregate_config_t;
+#endif /* CONFIG_AGGREGATE_GATT */
+
 
 /******************************************************************************
  * Macro
@@ -45,6 +91,63 @@ typedef struct {
 #define BT_UUID_SAMPLE_COUNT \
     BT_UUID_DECLARE_128(BT_UUID_128_ENCODE(0xf2debc9a, 0x7856, 0x3412, 0x7856, 0x341278563412))
 
+/* Custom 128-bit UUID for the Sample Format Descriptor Characteristic (Read) */
+#define BT_UUID_SAMPLE_FORMAT \
+    BT_UUID_DECLARE_128(BT_UUID_128_ENCODE(0xf3debc9a, 0x7856, 0x3412, 0x7856, 0x341278563412))
+
+/* Custom 128-bit UUID for the Bulk Control Point Characteristic (Read, Write) */
+#define BT_UUID_BULK_CONTROL \
+    BT_UUID_DECLARE_128(BT_UUID_128_ENCODE(0xf4debc9a, 0x7856, 0x3412, 0x7856, 0x341278563412))
+
+/* Custom 128-bit UUID for the Link Info Characteristic (Read) */
+#define BT_UUID_LINK_INFO \
+    BT_UUID_DECLARE_128(BT_UUID_128_ENCODE(0xf5debc9a, 0x7856, 0x3412, 0x7856, 0x341278563412))
+
+/* Custom 128-bit UUID for the Retransmit Characteristic (Write, Notify) */
+#define BT_UUID_RETRANSMIT \
+    BT_UUID_DECLARE_128(BT_UUID_128_ENCODE(0xf6debc9a, 0x7856, 0x3412, 0x7856, 0x341278563412))
+
+/* Custom 128-bit UUID for the Rate Config Characteristic (Read, Write) */
+#define BT_UUID_RATE_CONFIG \
+    BT_UUID_DECLARE_128(BT_UUID_128_ENCODE(0xf7debc9a, 0x7856, 0x3412, 0x7856, 0x341278563412))
+
+/* Custom 128-bit UUID for the Telemetry Characteristic (Read) */
+#define BT_UUID_TELEMETRY \
+    BT_UUID_DECLARE_128(BT_UUID_128_ENCODE(0xf8debc9a, 0x7856, 0x3412, 0x7856, 0x341278563412))
+
+/* Custom 128-bit UUID for the Aggregate Control Characteristic (Read, Write) */
+#define BT_UUID_AGGREGATE_CONTROL \
+    BT_UUID_DECLARE_128(BT_UUID_128_ENCODE(0xf9debc9a, 0x7856, 0x3412, 0x7856, 0x341278563412))
+
+/* Custom 128-bit UUID for the Aggregate Summary Characteristic (Read, Notify) */
+#define BT_UUID_AGGREGATE_SUMMARY \
+    BT_UUID_DECLARE_128(BT_UUID_128_ENCODE(0xfadebc9a, 0x7856, 0x3412, 0x7856, 0x341278563412))
+
+/* Custom 128-bit UUID for the Alert Characteristic (Notify) */
+#define BT_UUID_ALERT \
+    BT_UUID_DECLARE_128(BT_UUID_128_ENCODE(0xfbdebc9a, 0x7856, 0x3412, 0x7856, 0x341278563412))
+
+/* Main thread events, posted by the connection callbacks */
+#define APP_EVT_CONNECTED   BIT(0)   /* A connection was established */
+#define APP_EVT_CONN_FREED  BIT(1)   /* A connection object was released */
+#define APP_EVT_ADV_POLICY  BIT(2)   /* The advertising filter policy changed */
+
+/* Attribute permissions, encrypted links only with bonding */
+#if defined(CONFIG_BOND)
+#define APP_PERM_READ  BT_GATT_PERM_READ_ENCRYPT
+#define APP_PERM_WRITE BT_GATT_PERM_WRITE_ENCRYPT
+#else
+#define APP_PERM_READ  BT_GATT_PERM_READ
+#define APP_PERM_WRITE BT_GATT_PERM_WRITE
+#endif /* CONFIG_BOND */
+
+/* Runtime transmit interval limits, match the CONFIG_TRANSMIT_INTERVAL_MS range */
+#define TX_INTERVAL_MIN_MS 10U
+#define TX_INTERVAL_MAX_MS 3600000U
+
+/* Application ATT error: bulk control point used without an L2CAP channel */
+#define BULK_CP_ERR_NO_CHANNEL 0x80
+
 
 /******************************************************************************
  * Static Variables
@@ -53,16 +156,48 @@ typedef struct {
 /* Application data */
 static app_data_t app_data;
 
+#if !defined(CONFIG_ADV_MANAGER)
 /* Advertising data packets */
 static const struct bt_data ad[] = {
     BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
     BT_DATA(BT_DATA_NAME_COMPLETE, CONFIG_BT_DEVICE_NAME, sizeof(CONFIG_BT_DEVICE_NAME) - 1),
 };
+#endif /* !CONFIG_ADV_MANAGER */
+
+#if defined(CONFIG_TELEMETRY_CHAR)
+/* Counters served by a long read, taken at offset 0 per connection */
+static telemetry_info_t telemetry_snapshot[CONFIG_BT_MAX_CONN];
+#endif /* CONFIG_TELEMETRY_CHAR */
+
+#if defined(CONFIG_AGGREGATE_GATT)
+/* Summaries served by a long read in their wire layout, taken at offset 0
+ * per connection; a length of 0 means no window has completed yet */
+static uint8_t aggregate_snapshot[CONFIG_BT_MAX_CONN][SAMPLE_WIRE_LEN];
+static uint8_t aggregate_snapshot_len[CONFIG_BT_MAX_CONN];
+#endif /* CONFIG_AGGREGATE_GATT */
+
+#if defined(CONFIG_SAMPLE_FORMAT_DESCRIPTOR)
+/* Sample layout advertised to clients through the format descriptor */
+static const sample_format_desc_t sample_format_desc = {
+    .version = SAMPLE_FORMAT_VERSION,
+    .flags = (IS_ENABLED(CONFIG_TX_BATCHING) ? SAMPLE_FORMAT_FLAG_BATCHED : 0) |
+             (IS_ENABLED(CONFIG_IMU_CODEC) ? SAMPLE_FORMAT_FLAG_IMU_DELTA : 0) |
+             SAMPLE_FORMAT_FLAG_SEQ_TS,
+    .sample_size = sys_cpu_to_le16(SAMPLE_WIRE_LEN),
+    .imu_len = IMU_SAMPLE_LEN,
+    .imu_type = SAMPLE_IMU_TYPE,
+    .imu_bits = SAMPLE_IMU_BITS,
+    .temp_len = TEMP_SAMPLE_LEN,
+    .temp_type = SAMPLE_TEMP_TYPE,
+};
+#endif /* CONFIG_SAMPLE_FORMAT_DESCRIPTOR */
 
+#if !defined(CONFIG_ADV_MANAGER)
 /* Scan response data packets */
 static const struct bt_data sd[] = {
     BT_DATA(BT_DATA_NAME_COMPLETE, CONFIG_BT_DEVICE_NAME, sizeof(CONFIG_BT_DEVICE_NAME) - 1),
 };
+#endif /* !CONFIG_ADV_MANAGER */
 
 
 /******************************************************************************
@@ -82,20 +217,414 @@ static const struct bt_data sd[] = {
 static ssize_t read_sample_count(struct bt_conn *conn, const struct bt_gatt_attr *attr,
                                  void *buf, uint16_t len, uint16_t offset)
 {
+#if defined(CONFIG_FLASH_TIER)
+    flash_tier_level_t level;
+
+    flash_tier_get_level(&level);
+
+    sample_count_t count = {
+        .ram_count = sys_cpu_to_le32(mem_cache_count()),
+        .flash_count = sys_cpu_to_le32(level.stored),
+        .flash_capacity = sys_cpu_to_le32(level.capacity),
+        .flash_dropped = sys_cpu_to_le32(level.dropped),
+    };
+#else
     uint32_t count = mem_cache_count();
+#endif /* CONFIG_FLASH_TIER */
     return bt_gatt_attr_read(conn, attr, buf, len, offset, &count, sizeof(count));
 }
 
+#if defined(CONFIG_SAMPLE_FORMAT_DESCRIPTOR)
 /**
- * @brief Client Configuration Characteristic (CCC) change callback.
+ * @brief Read callback for the Sample Format Descriptor characteristic.
  * 
+ * @param conn   The connection object.
+ * @param attr   The attribute being read.
+ * @param buf    Buffer to store the read data.
+ * @param len    Length of the buffer.
+ * @param offset Read offset.
+ * @return Number of bytes read or GATT error code.
+ */
+static ssize_t read_sample_format(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                                  void *buf, uint16_t len, uint16_t offset)
+{
+#if defined(CONFIG_AGGREGATE)
+    sample_format_desc_t desc = sample_format_desc;
+
+    /* Summary records look like samples, the flag tells them apart */
+    if (aggregate_get_stored_mode(NULL) == AGGREGATE_MODE_SUMMARY) {
+        desc.flags |= SAMPLE_FORMAT_FLAG_SUMMARY;
+    }
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, &desc, sizeof(desc));
+#else
+    return bt_gatt_attr_read(conn, attr, buf, len, offset,
+                             &sample_format_desc, sizeof(sample_format_desc));
+#endif /* CONFIG_AGGREGATE */
+}
+#endif /* CONFIG_SAMPLE_FORMAT_DESCRIPTOR */
+
+#if defined(CONFIG_LINK_TUNE)
+/**
+ * @brief Read callback for the Link Info characteristic.
+ * 
+ * @param conn   The connection object.
+ * @param attr   The attribute being read.
+ * @param buf    Buffer to store the read data.
+ * @param len    Length of the buffer.
+ * @param offset Read offset.
+ * @return Number of bytes read or GATT error code.
+ */
+static ssize_t read_link_info(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                              void *buf, uint16_t len, uint16_t offset)
+{
+    link_tune_info_t info;
+
+    link_tune_get_info(conn, &info);
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, &info, sizeof(info));
+}
+#endif /* CONFIG_LINK_TUNE */
+
+#if defined(CONFIG_L2CAP_BULK)
+/**
+ * @brief Read callback for the Bulk Control Point characteristic.
+ * 
+ * @param conn   The connection object.
+ * @param attr   The attribute being read.
+ * @param buf    Buffer to store the read data.
+ * @param len    Length of the buffer.
+ * @param offset Read offset.
+ * @return Number of bytes read or GATT error code.
+ */
+static ssize_t read_bulk_control(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                                 void *buf, uint16_t len, uint16_t offset)
+{
+    bulk_cp_status_t status;
+
+    l2cap_bulk_get_status(&status);
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, &status, sizeof(status));
+}
+
+/**
+ * @brief Write callback for the Bulk Control Point characteristic.
+ * 
+ * @param conn   The connection object.
+ * @param attr   The attribute being written.
+ * @param buf    Written value, opcode first.
+ * @param len    Length of the value.
+ * @param offset Write offset.
+ * @param flags  Write flags.
+ * @return Number of bytes written or GATT error code.
+ */
+static ssize_t write_bulk_control(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                                  const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
+{
+    if (offset) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    }
+
+    int err = l2cap_bulk_control(buf, len);
+    switch (err) {
+    case 0:
+        return len;
+    case -EINVAL:
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    case -ENOTCONN:
+        return BT_GATT_ERR(BULK_CP_ERR_NO_CHANNEL);
+    default:
+        return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+    }
+}
+#endif /* CONFIG_L2CAP_BULK */
+
+#if defined(CONFIG_TX_RETRANSMIT)
+/**
+ * @brief Write callback for the Retransmit characteristic.
+ *
+ * Ranges are queued in order until one is refused; samples come back as
+ * notifications on the same characteristic.
+ *
+ * @param conn   The connection object.
+ * @param attr   The attribute being written.
+ * @param buf    Written value, an array of retransmit_req_t.
+ * @param len    Length of the value.
+ * @param offset Write offset.
+ * @param flags  Write flags.
+ * @return Number of bytes written or GATT error code.
+ */
+static ssize_t write_retransmit(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                                const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
+{
+    const retransmit_req_t *req = buf;
+    size_t n = len / sizeof(*req);
+
+    if (offset) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    }
+    if (n == 0 || len % sizeof(*req)) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        int err = tx_engine_retransmit(conn, sys_le32_to_cpu(req[i].first_seq),
+                                       sys_le16_to_cpu(req[i].count));
+        switch (err) {
+        case 0:
+            break;
+        case -ERANGE:
+            return BT_GATT_ERR(BT_ATT_ERR_OUT_OF_RANGE);
+        case -ENOMEM:
+            return BT_GATT_ERR(BT_ATT_ERR_INSUFFICIENT_RESOURCES);
+        default:
+            return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+        }
+    }
+
+    return len;
+}
+#endif /* CONFIG_TX_RETRANSMIT */
+
+#if defined(CONFIG_RATE_CONFIG)
+/**
+ * @brief Read callback for the Rate Config characteristic.
+ *
+ * @param conn   The connection object.
+ * @param attr   The attribute being read.
+ * @param buf    Buffer to store the read data.
+ * @param len    Length of the buffer.
+ * @param offset Read offset.
+ * @return Number of bytes read or GATT error code.
+ */
+static ssize_t read_rate_config(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                                void *buf, uint16_t len, uint16_t offset)
+{
+    rate_config_t cfg = {
+        .sample_interval_us = sys_cpu_to_le32(sampler_get_interval()),
+        .tx_interval_ms = sys_cpu_to_le32((uint32_t)atomic_get(&app_data.tx_interval)),
+#if defined(CONFIG_MEM_CACHE_BACKEND_SLAB)
+        .cache_capacity = sys_cpu_to_le32(mem_cache_capacity()),
+#endif /* CONFIG_MEM_CACHE_BACKEND_SLAB */
+    };
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, &cfg, sizeof(cfg));
+}
+
+/**
+ * @brief Write callback for the Rate Config characteristic.
+ *
+ * Both intervals are checked before either is applied. The transmit timer
+ * restarts with the new period and the TX engine resizes its batches.
+ * With the slab backend the cache capacity is checked and applied along
+ * with them; a value without it leaves the capacity as it is.
+ *
+ * @param conn   The connection object.
+ * @param attr   The attribute being written.
+ * @param buf    Written value, a rate_config_t.
+ * @param len    Length of the value.
+ * @param offset Write offset.
+ * @param flags  Write flags.
+ * @return Number of bytes written or GATT error code.
+ */
+static ssize_t write_rate_config(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                                 const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
+{
+    const rate_config_t *cfg = buf;
+
+    if (offset) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    }
+#if defined(CONFIG_MEM_CACHE_BACKEND_SLAB)
+    size_t capacity = mem_cache_capacity();
+
+    if (len == sizeof(*cfg)) {
+        capacity = sys_le32_to_cpu(cfg->cache_capacity);
+    } else if (len != offsetof(rate_config_t, cache_capacity)) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+    if (capacity < mem_cache_capacity_min() || capacity > mem_cache_capacity_max()) {
+        return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+    }
+#else
+    if (len != sizeof(*cfg)) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+#endif /* CONFIG_MEM_CACHE_BACKEND_SLAB */
+
+    uint32_t sample_us = sys_le32_to_cpu(cfg->sample_interval_us);
+    uint32_t tx_ms = sys_le32_to_cpu(cfg->tx_interval_ms);
+
+    if (tx_ms < TX_INTERVAL_MIN_MS || tx_ms > TX_INTERVAL_MAX_MS ||
+        sampler_set_interval(sample_us)) {
+        return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+    }
+
+#if defined(CONFIG_MEM_CACHE_BACKEND_SLAB)
+    mem_cache_set_capacity(capacity);
+    LOG_INF("Cache capacity set to %u samples", (unsigned int)capacity);
+#endif /* CONFIG_MEM_CACHE_BACKEND_SLAB */
+
+    atomic_set(&app_data.tx_interval, (atomic_val_t)tx_ms);
+#if !defined(CONFIG_TX_SYNC_CONN_EVENT)
+    k_timer_start(&app_data.tx_timer, K_MSEC(tx_ms), K_MSEC(tx_ms));
+#endif /* !CONFIG_TX_SYNC_CONN_EVENT */
+    tx_engine_configure(sample_us, tx_ms);
+
+    LOG_INF("Rate set to %u us sampling, %u ms transmit", sample_us, tx_ms);
+    return len;
+}
+#endif /* CONFIG_RATE_CONFIG */
+
+#if defined(CONFIG_TELEMETRY_CHAR)
+/**
+ * @brief Read callback for the Telemetry characteristic.
+ *
+ * The value is longer than a default MTU. A fresh snapshot is only taken
+ * on the first chunk of a read, so a long read returns consistent counters.
+ *
+ * @param conn   The connection object.
+ * @param attr   The attribute being read.
+ * @param buf    Buffer to store the read data.
+ * @param len    Length of the buffer.
+ * @param offset Read offset.
+ * @return Number of bytes read or GATT error code.
+ */
+static ssize_t read_telemetry(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                              void *buf, uint16_t len, uint16_t offset)
+{
+    telemetry_info_t *info = &telemetry_snapshot[bt_conn_index(conn)];
+
+    if (offset == 0) {
+        telemetry_get_info(info);
+    }
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, info, sizeof(*info));
+}
+#endif /* CONFIG_TELEMETRY_CHAR */
+
+#if defined(CONFIG_AGGREGATE_GATT)
+/**
+ * @brief Read callback for the Aggregate Control characteristic.
+ *
+ * first_seq only moves once the sampling thread applies a mode change,
+ * on its next sensor FIFO read.
+ *
+ * @param conn   The connection object.
+ * @param attr   The attribute being read.
+ * @param buf    Buffer to store the read data.
+ * @param len    Length of the buffer.
+ * @param offset Read offset.
+ * @return Number of bytes read or GATT error code.
+ */
+static ssize_t read_aggregate_control(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                                      void *buf, uint16_t len, uint16_t offset)
+{
+    uint32_t first_seq;
+
+    aggregate_get_stored_mode(&first_seq);
+
+    aggregate_config_t cfg = {
+        .mode = aggregate_get_mode(),
+        .channels = CONFIG_AGGREGATE_CHANNELS,
+        .window = sys_cpu_to_le16(aggregate_get_window()),
+        .first_seq = sys_cpu_to_le32(first_seq),
+    };
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, &cfg, sizeof(cfg));
+}
+
+/**
+ * @brief Write callback for the Aggregate Control characteristic.
+ *
+ * The mode is shared by all connections and takes effect with the next
+ * sensor FIFO read.
+ *
+ * @param conn   The connection object.
+ * @param attr   The attribute being written.
+ * @param buf    Written value, an aggregate_config_t.
+ * @param len    Length of the value.
+ * @param offset Write offset.
+ * @param flags  Write flags.
+ * @return Number of bytes written or GATT error code.
+ */
+static ssize_t write_aggregate_control(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                                       const void *buf, uint16_t len, uint16_t offset,
+                                       uint8_t flags)
+{
+    const aggregate_config_t *cfg = buf;
+
+    if (offset) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    }
+    if (len != sizeof(*cfg)) {
+        return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+    if (aggregate_set_mode(cfg->mode, sys_le16_to_cpu(cfg->window))) {
+        return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+    }
+
+    return len;
+}
+
+/**
+ * @brief Read callback for the Aggregate Summary characteristic.
+ *
+ * The summary is longer than a default MTU. A fresh one is only taken on
+ * the first chunk of a read, so a long read returns a single summary.
+ *
+ * @param conn   The connection object.
+ * @param attr   The attribute being read.
+ * @param buf    Buffer to store the read data.
+ * @param len    Length of the buffer.
+ * @param offset Read offset.
+ * @return Number of bytes read or GATT error code.
+ */
+static ssize_t read_aggregate_summary(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+                                      void *buf, uint16_t len, uint16_t offset)
+{
+    uint8_t idx = bt_conn_index(conn);
+
+    if (offset == 0) {
+        sensor_sample_t summary;
+        bool valid = aggregate_get_summary(&summary);
+
+        if (valid) {
+            sample_serialize(aggregate_snapshot[idx], &summary);
+        }
+        aggregate_snapshot_len[idx] = valid ? SAMPLE_WIRE_LEN : 0;
+    }
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, aggregate_snapshot[idx],
+                             aggregate_snapshot_len[idx]);
+}
+#endif /* CONFIG_AGGREGATE_GATT */
+
+/**
+ * @brief Client Configuration Characteristic (CCC) write callback.
+ * 
+ * Called for every connection that writes the CCC, so each central gets
+ * its own read cursor in the TX engine.
+ * 
+ * @param conn  The connection object.
  * @param attr  The CCC attribute.
  * @param value The configuration value (Notify vs Disabled).
+ * @return Number of bytes written.
  */
-static void ccc_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value)
+static ssize_t ccc_cfg_write(struct bt_conn *conn, const struct bt_gatt_attr *attr, uint16_t value)
 {
-    app_data.notify_enabled = (value == BT_GATT_CCC_NOTIFY);
-    LOG_INF("Notifications %s", app_data.notify_enabled ? "enabled" : "disabled");
+    uint8_t idx = bt_conn_index(conn);
+    bool enabled = (value == BT_GATT_CCC_NOTIFY);
+
+    LOG_INF("Notifications %s on connection %u", enabled ? "enabled" : "disabled", idx);
+
+    if (enabled) {
+        atomic_set_bit(&app_data.subscribers, idx);
+        tx_engine_start(conn);
+    } else {
+        atomic_clear_bit(&app_data.subscribers, idx);
+        tx_engine_stop(conn);
+    }
+
+    return sizeof(value);
 }
 
 /* GATT Service Definition */
@@ -107,12 +636,75 @@ BT_GATT_SERVICE_DEFINE(sensor_svc,
                            BT_GATT_PERM_NONE,
                            NULL, NULL, NULL),
 
-    BT_GATT_CCC(ccc_cfg_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+    BT_GATT_CCC_WITH_WRITE_CB(NULL, ccc_cfg_write, APP_PERM_READ | APP_PERM_WRITE),
 
     BT_GATT_CHARACTERISTIC(BT_UUID_SAMPLE_COUNT,
                            BT_GATT_CHRC_READ,
-                           BT_GATT_PERM_READ,
+                           APP_PERM_READ,
                            read_sample_count, NULL, NULL),
+
+    IF_ENABLED(CONFIG_SAMPLE_FORMAT_DESCRIPTOR, (
+    BT_GATT_CHARACTERISTIC(BT_UUID_SAMPLE_FORMAT,
+                           BT_GATT_CHRC_READ,
+                           APP_PERM_READ,
+                           read_sample_format, NULL, NULL),
+    ))
+
+    IF_ENABLED(CONFIG_L2CAP_BULK, (
+    BT_GATT_CHARACTERISTIC(BT_UUID_BULK_CONTROL,
+                           BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE,
+                           APP_PERM_READ | APP_PERM_WRITE,
+                           read_bulk_control, write_bulk_control, NULL),
+    ))
+
+    IF_ENABLED(CONFIG_LINK_TUNE, (
+    BT_GATT_CHARACTERISTIC(BT_UUID_LINK_INFO,
+                           BT_GATT_CHRC_READ,
+                           APP_PERM_READ,
+                           read_link_info, NULL, NULL),
+    ))
+
+    IF_ENABLED(CONFIG_TX_RETRANSMIT, (
+    BT_GATT_CHARACTERISTIC(BT_UUID_RETRANSMIT,
+                           BT_GATT_CHRC_WRITE | BT_GATT_CHRC_NOTIFY,
+                           APP_PERM_WRITE,
+                           NULL, write_retransmit, NULL),
+    BT_GATT_CCC(NULL, APP_PERM_READ | APP_PERM_WRITE),
+    ))
+
+    IF_ENABLED(CONFIG_RATE_CONFIG, (
+    BT_GATT_CHARACTERISTIC(BT_UUID_RATE_CONFIG,
+                           BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE,
+                           APP_PERM_READ | APP_PERM_WRITE,
+                           read_rate_config, write_rate_config, NULL),
+    ))
+
+    IF_ENABLED(CONFIG_TELEMETRY_CHAR, (
+    BT_GATT_CHARACTERISTIC(BT_UUID_TELEMETRY,
+                           BT_GATT_CHRC_READ,
+                           APP_PERM_READ,
+                           read_telemetry, NULL, NULL),
+    ))
+
+    IF_ENABLED(CONFIG_AGGREGATE_GATT, (
+    BT_GATT_CHARACTERISTIC(BT_UUID_AGGREGATE_CONTROL,
+                           BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE,
+                           APP_PERM_READ | APP_PERM_WRITE,
+                           read_aggregate_control, write_aggregate_control, NULL),
+    BT_GATT_CHARACTERISTIC(BT_UUID_AGGREGATE_SUMMARY,
+                           BT_GATT_CHRC_READ | BT_GATT_CHRC_NOTIFY,
+                           APP_PERM_READ,
+                           read_aggregate_summary, NULL, NULL),
+    BT_GATT_CCC(NULL, APP_PERM_READ | APP_PERM_WRITE),
+    ))
+
+    IF_ENABLED(CONFIG_MEM_CACHE_ALERT, (
+    BT_GATT_CHARACTERISTIC(BT_UUID_ALERT,
+                           BT_GATT_CHRC_NOTIFY,
+                           BT_GATT_PERM_NONE,
+                           NULL, NULL, NULL),
+    BT_GATT_CCC(NULL, APP_PERM_READ | APP_PERM_WRITE),
+    ))
 );
 
 
@@ -123,28 +715,20 @@ BT_GATT_SERVICE_DEFINE(sensor_svc,
 /**
  * @brief Periodic timer handler for transmitting sensor data.
  * 
- * Pops a sample from the memory cache and sends a GATT notification 
- * if a connection is active and notifications are enabled.
+ * Flushes the TX engine if at least one connection has notifications
+ * enabled. The engine then drains the whole backlog at the pace of the
+ * notify-complete callbacks, so this period only bounds the latency of
+ * freshly cached samples and of partially filled batches.
  * 
  * @param timer Pointer to the kernel timer.
  */
 static void tx_timer_handler(struct k_timer *timer)
 {
-    if (!app_data.current_conn || !app_data.notify_enabled) {
-        return;
-    }
-
-    sensor_sample_t sample;
-    if (!mem_cache_pop(&sample)) {
+    if (atomic_get(&app_data.subscribers) == 0) {
         return;
     }
 
-    /* Attributes index 1 points to the SENSOR_DATA characteristic */
-    int err = bt_gatt_notify(app_data.current_conn, &sensor_svc.attrs[1], &sample, sizeof(sample));
-    if (err) {
-        LOG_WRN("Notify failed (err %d), re-pushing sample to cache", err);
-        mem_cache_push(&sample);
-    }
+    tx_engine_flush();
 }
 
 /**
@@ -159,12 +743,13 @@ static void mtu_exchange_cb(struct bt_conn *conn, uint8_t err, struct bt_gatt_ex
     LOG_INF("MTU exchange %s, current MTU: %u", 
             err == 0U ? "successful" : "failed", 
             bt_gatt_get_mtu(conn));
+
+    /* A larger MTU may let a pending batch through now */
+    tx_engine_kick();
 }
 
-/* MTU exchange data */
-static struct bt_gatt_exchange_params mtu_exchange_params = {
-    .func = mtu_exchange_cb
-};
+/* MTU exchange data, one per connection since exchanges may overlap */
+static struct bt_gatt_exchange_params mtu_exchange_params[CONFIG_BT_MAX_CONN];
 
 
 /******************************************************************************
@@ -182,11 +767,17 @@ static void connected(struct bt_conn *conn, uint8_t err)
     if (err) {
         LOG_ERR("Connection failed (err 0x%02x)", err);
     } else {
-        app_data.current_conn = bt_conn_ref(conn);
-        atomic_set_bit(&app_data.state, STATE_CONNECTED);
+        struct bt_gatt_exchange_params *params = &mtu_exchange_params[bt_conn_index(conn)];
+
+        atomic_inc(&app_data.conn_count);
+        k_event_post(&app_data.events, APP_EVT_CONNECTED);
         
         /* Initiate MTU exchange to optimize packet size */
-        bt_gatt_exchange_mtu(conn, &mtu_exchange_params);
+        params->func = mtu_exchange_cb;
+        bt_gatt_exchange_mtu(conn, params);
+#if defined(CONFIG_LINK_TUNE)
+        link_tune_start(conn);
+#endif /* CONFIG_LINK_TUNE */
         LOG_INF("Connected");
     }
 }
@@ -199,17 +790,76 @@ static void connected(struct bt_conn *conn, uint8_t err)
  */
 static void disconnected(struct bt_conn *conn, uint8_t reason)
 {
-    if (app_data.current_conn) {
-        bt_conn_unref(app_data.current_conn);
-        app_data.current_conn = NULL;
-    }
-    atomic_set_bit(&app_data.state, STATE_DISCONNECTED);
+    atomic_clear_bit(&app_data.subscribers, bt_conn_index(conn));
+    tx_engine_stop(conn);
+#if defined(CONFIG_LINK_TUNE)
+    link_tune_stop(conn);
+#endif /* CONFIG_LINK_TUNE */
+
+    atomic_dec(&app_data.conn_count);
     LOG_INF("Disconnected (reason 0x%02x)", reason);
 }
 
+/**
+ * @brief Connection object released callback.
+ * 
+ * Called once the stack has freed the object of a disconnected or failed
+ * connection. Advertising is restarted from here rather than from
+ * disconnected(), where the object is still in use and starting a
+ * connectable advertiser would fail for lack of a free one.
+ */
+static void recycled(void)
+{
+    k_event_post(&app_data.events, APP_EVT_CONN_FREED);
+}
+
+#if defined(CONFIG_BOND)
+/**
+ * @brief Connection security changed callback.
+ * 
+ * The stack restores the CCC of a bonded central once the link is
+ * encrypted, without calling ccc_cfg_write(), so its notifications are
+ * resumed from here instead of waiting for it to subscribe again.
+ * 
+ * @param conn  The connection object.
+ * @param level New security level.
+ * @param err   Security error (BT_SECURITY_ERR_SUCCESS on success).
+ */
+static void security_changed(struct bt_conn *conn, bt_security_t level,
+                             enum bt_security_err err)
+{
+    uint8_t idx = bt_conn_index(conn);
+
+    if (err || level < BT_SECURITY_L2) {
+        return;
+    }
+
+    if (bt_gatt_is_subscribed(conn, &sensor_svc.attrs[1], BT_GATT_CCC_NOTIFY) &&
+        !atomic_test_and_set_bit(&app_data.subscribers, idx)) {
+        LOG_INF("Notifications resumed on connection %u", idx);
+        tx_engine_start(conn);
+    }
+}
+
+/**
+ * @brief Advertising filter policy changed callback.
+ * 
+ * A running advertiser keeps its filter policy, have the main thread
+ * restart it.
+ */
+static void adv_policy_changed(void)
+{
+    k_event_post(&app_data.events, APP_EVT_ADV_POLICY);
+}
+#endif /* CONFIG_BOND */
+
 BT_CONN_CB_DEFINE(conn_callbacks) = {
     .connected = connected,
     .disconnected = disconnected,
+    .recycled = recycled,
+#if defined(CONFIG_BOND)
+    .security_changed = security_changed,
+#endif /* CONFIG_BOND */
 };
 
 
@@ -222,19 +872,71 @@ BT_CONN_CB_DEFINE(conn_callbacks) = {
  */
 void ble_service_init(void)
 {
+    /* Attributes index 1 points to the SENSOR_DATA characteristic */
+    tx_engine_init(&sensor_svc.attrs[1]);
+#if defined(CONFIG_TX_RETRANSMIT)
+    tx_engine_retransmit_init(bt_gatt_find_by_uuid(sensor_svc.attrs, sensor_svc.attr_count,
+                                                   BT_UUID_RETRANSMIT));
+#endif /* CONFIG_TX_RETRANSMIT */
+#if defined(CONFIG_AGGREGATE_GATT)
+    aggregate_notify_init(bt_gatt_find_by_uuid(sensor_svc.attrs, sensor_svc.attr_count,
+                                               BT_UUID_AGGREGATE_SUMMARY));
+#endif /* CONFIG_AGGREGATE_GATT */
+#if defined(CONFIG_MEM_CACHE_ALERT)
+    tx_engine_alert_init(bt_gatt_find_by_uuid(sensor_svc.attrs, sensor_svc.attr_count,
+                                              BT_UUID_ALERT));
+#endif /* CONFIG_MEM_CACHE_ALERT */
+
+    k_event_init(&app_data.events);
+    atomic_set(&app_data.tx_interval, CONFIG_TRANSMIT_INTERVAL_MS);
     k_timer_init(&app_data.tx_timer, tx_timer_handler, NULL);
+#if !defined(CONFIG_TX_SYNC_CONN_EVENT)
+    /* Otherwise the TX engine paces itself by the connection events */
     k_timer_start(&app_data.tx_timer, 
-                  K_SECONDS(CONFIG_TRANSMIT_INTERVAL_SEC), 
-                  K_SECONDS(CONFIG_TRANSMIT_INTERVAL_SEC));
+                  K_MSEC(CONFIG_TRANSMIT_INTERVAL_MS), 
+                  K_MSEC(CONFIG_TRANSMIT_INTERVAL_MS));
+#endif /* !CONFIG_TX_SYNC_CONN_EVENT */
 
     LOG_INF("BLE service initialized");
 }
 
+/**
+ * @brief Start connectable advertising.
+ * 
+ * Advertising may still be running when one of several connections
+ * drops, which is not an error. With CONFIG_ADV_MANAGER the interval
+ * follows the backlog.
+ * 
+ * @return 0 on success or a negative error code from bt_le_adv_start().
+ */
+static int advertising_start(void)
+{
+#if defined(CONFIG_ADV_MANAGER)
+    int err = adv_manager_start();
+#else
+    struct bt_le_adv_param param = *BT_LE_ADV_CONN_FAST_1;
+
+#if defined(CONFIG_BOND)
+    param.options |= bond_adv_options();
+#endif /* CONFIG_BOND */
+    LOG_INF("Starting Advertising...");
+    int err = bt_le_adv_start(&param, ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
+#endif /* CONFIG_ADV_MANAGER */
+    if (err && err != -EALREADY) {
+        LOG_ERR("Advertising failed to start (err %d)", err);
+        return err;
+    }
+
+    return 0;
+}
+
 /**
  * @brief Application entry point.
  * 
- * Initializes Bluetooth, starts the advertising state machine, 
- * and maintains the main application loop.
+ * Initializes Bluetooth, then sleeps until a connection callback posts an
+ * event and restarts advertising while connection slots are left. A
+ * dropped link is advertised for again as soon as its connection object
+ * is released.
  */
 int main(void)
 {
@@ -248,22 +950,35 @@ int main(void)
         return 0;
     }
 
-    atomic_set_bit(&app_data.state, STATE_DISCONNECTED);
+#if defined(CONFIG_BOND)
+    /* Bonds must be on the accept list before the first advertiser */
+    err = bond_load(adv_policy_changed);
+    if (err) {
+        return 0;
+    }
+#endif /* CONFIG_BOND */
+
+    /* Nothing is connected yet */
+    k_event_post(&app_data.events, APP_EVT_CONN_FREED);
 
     while (1) {
-        k_sleep(K_SECONDS(1));
-
-        if (atomic_test_and_clear_bit(&app_data.state, STATE_CONNECTED)) {
-            /* Connected handler */
-        } 
-        else if (atomic_test_and_clear_bit(&app_data.state, STATE_DISCONNECTED)) {
-            /* Disconnected handler */
-            LOG_INF("Starting Advertising...");
-            err = bt_le_adv_start(BT_LE_ADV_CONN_FAST_1, ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
-            if (err) {
-                LOG_ERR("Advertising failed to start (err %d)", err);
-                return 0;
-            }
+        uint32_t events = k_event_wait(&app_data.events,
+                                       APP_EVT_CONNECTED | APP_EVT_CONN_FREED | APP_EVT_ADV_POLICY,
+                                       false, K_FOREVER);
+
+        /* The check below runs after the clear, so no posted event goes unhandled */
+        k_event_clear(&app_data.events, events);
+
+#if defined(CONFIG_BOND)
+        if (events & APP_EVT_ADV_POLICY) {
+            /* Restarted below with the new filter policy */
+            bt_le_adv_stop();
+        }
+#endif /* CONFIG_BOND */
+
+        /* Stay connectable while slots are left */
+        if (atomic_get(&app_data.conn_count) < CONFIG_BT_MAX_CONN && advertising_start()) {
+            return 0;
         }
     }
 }
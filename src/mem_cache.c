@@ -1,31 +1,454 @@
 #include <zephyr/kernel.h>
 #include <zephyr/init.h>
+#include <zephyr/sys/atomic.h>
 #include <string.h>
+#include "dma_copy.h"
 #include "mem_cache.h"
 
+/* Serializing is a prefix copy only while the fields are gap-free */
+BUILD_ASSERT(IS_POWER_OF_TWO(CONFIG_SAMPLE_ALIGN), "CONFIG_SAMPLE_ALIGN must be a power of two");
+BUILD_ASSERT(SAMPLE_LAYOUT_GAP_FREE,
+             "Padding between sample fields, use an even CONFIG_SAMPLE_IMU_LEN "
+             "or float temperatures");
+
+#if defined(CONFIG_MEM_CACHE_BACKEND_SPSC)
+
+BUILD_ASSERT(IS_POWER_OF_TWO(CONFIG_CACHE_SIZE),
+             "Lock-free cache backend requires CONFIG_CACHE_SIZE to be a power of two");
+
+#define CACHE_IDX_MASK (CONFIG_CACHE_SIZE - 1)
+
+/*
+ * Define a structure to hold the lock-free cache and its metadata.
+ *
+ * Head and tail are free-running counters; the slot index is obtained by
+ * masking. The producer is the only writer of head and the consumer is the
+ * only writer of tail, so no lock is needed as long as there is one of each.
+ * The one exception is overflow handling: dropping or decimating old samples
+ * moves tail from the producer side, which the spinlock serializes against
+ * consumer pins.
+ */
+struct mem_cache_t {
+    sensor_sample_t data[CONFIG_CACHE_SIZE];   /* Array to store sensor samples */
+    atomic_t head;                             /* Free-running write counter (producer owned) */
+    atomic_t tail;                             /* Free-running read counter (consumer owned) */
+    atomic_t dropped;                          /* Samples lost to overflow */
+    atomic_t decimated;                        /* Samples thinned out by decimation */
+    struct k_spinlock lock;                    /* Serializes overflow handling and pins */
+    unsigned int pins;                         /* Outstanding consumer pins */
+};
+
+/* Create the module instance. */
+static struct mem_cache_t cache;
+
+#if defined(CONFIG_MEM_CACHE_OVERFLOW_DECIMATE)
+/**
+ * @brief Thin out the older half of a full cache 2:1.
+ *
+ * Every second sample of the older half is kept and moved up against the
+ * newer half, working from the newest end so no source is overwritten
+ * before it is copied. Frees about a quarter of the slots; repeated passes
+ * make the oldest history progressively coarser.
+ *
+ * @param tail Current tail counter.
+ * @param count Current number of samples.
+ * @return Number of slots freed.
+ */
+static size_t cache_decimate(unsigned long tail, size_t count)
+{
+    size_t half = count / 2;
+    size_t kept = (half + 1) / 2;
+    size_t removed = half - kept;
+
+    for (size_t k = 1; k < kept; k++) {
+        memcpy(&cache.data[(tail + half - 1 - k) & CACHE_IDX_MASK],
+               &cache.data[(tail + half - 1 - 2 * k) & CACHE_IDX_MASK],
+               sizeof(sensor_sample_t));
+    }
+
+    return removed;
+}
+#endif /* CONFIG_MEM_CACHE_OVERFLOW_DECIMATE */
+
+/**
+ * @brief Apply the overflow policy to a full cache.
+ *
+ * Called by the producer. Old samples are only touched while no consumer
+ * holds a pin; otherwise the new sample is rejected.
+ *
+ * @return true if room was made for one more sample.
+ */
+static bool cache_overflow(void)
+{
+#if defined(CONFIG_MEM_CACHE_OVERFLOW_REJECT)
+    atomic_inc(&cache.dropped);
+    return false;
+#else
+    k_spinlock_key_t key = k_spin_lock(&cache.lock);
+    unsigned long head = (unsigned long)cache.head;
+    unsigned long tail = (unsigned long)atomic_get(&cache.tail);
+    size_t count = (size_t)(head - tail);
+    bool room = true;
+
+    if (count < CONFIG_CACHE_SIZE) {
+        /* Consumer released a slot in the meantime */
+    } else if (cache.pins) {
+        atomic_inc(&cache.dropped);
+        room = false;
+    } else {
+        size_t freed = 0;
+
+#if defined(CONFIG_MEM_CACHE_OVERFLOW_DECIMATE)
+        freed = cache_decimate(tail, count);
+        atomic_add(&cache.decimated, (atomic_val_t)freed);
+#endif /* CONFIG_MEM_CACHE_OVERFLOW_DECIMATE */
+        if (freed == 0) {
+            /* Drop-oldest, or a cache too small to decimate */
+            freed = 1;
+            atomic_inc(&cache.dropped);
+        }
+        atomic_set(&cache.tail, (atomic_val_t)(tail + freed));
+    }
+
+    k_spin_unlock(&cache.lock, key);
+    return room;
+#endif /* CONFIG_MEM_CACHE_OVERFLOW_REJECT */
+}
+
+/**
+ * @brief Push a sample into the FIFO cache.
+ *
+ * Lock-free, may be called from ISR context by a single producer.
+ *
+ * @param sample Pointer to the sensor sample to be added to the cache.
+ * @return true if the sample was added successfully, false if the cache is full.
+ */
+bool mem_cache_push(const sensor_sample_t *sample)
+{
+    unsigned long head = (unsigned long)cache.head;
+    unsigned long tail = (unsigned long)atomic_get(&cache.tail);
+
+    if ((head - tail) == CONFIG_CACHE_SIZE && !cache_overflow()) {
+        return false;
+    }
+
+    memcpy(&cache.data[head & CACHE_IDX_MASK], sample, sizeof(sensor_sample_t));
+    atomic_set(&cache.head, (atomic_val_t)(head + 1));
+
+    return true;
+}
+
+/**
+ * @brief Push a burst of samples into the FIFO cache.
+ *
+ * Lock-free, may be called from ISR context by a single producer. Free
+ * slots are filled in at most two dma_copy() chunks and published with one
+ * head update; samples beyond the free room go through the overflow
+ * policy one at a time.
+ *
+ * @param samples Samples to add, oldest first.
+ * @param n       Number of samples.
+ * @return The number of samples added.
+ */
+size_t mem_cache_push_n(const sensor_sample_t *samples, size_t n)
+{
+    unsigned long head = (unsigned long)cache.head;
+    unsigned long tail = (unsigned long)atomic_get(&cache.tail);
+    size_t room = MIN(n, CONFIG_CACHE_SIZE - (size_t)(head - tail));
+    size_t idx = head & CACHE_IDX_MASK;
+    size_t first = MIN(room, CONFIG_CACHE_SIZE - idx);
+
+    dma_copy(&cache.data[idx], samples, first * sizeof(sensor_sample_t));
+    dma_copy(&cache.data[0], &samples[first], (room - first) * sizeof(sensor_sample_t));
+    atomic_set(&cache.head, (atomic_val_t)(head + room));
+
+    size_t pushed = room;
+
+    for (size_t i = room; i < n; i++) {
+        pushed += mem_cache_push(&samples[i]);
+    }
+
+    return pushed;
+}
+
+/**
+ * @brief Pop the oldest sample from the cache.
+ *
+ * Lock-free, may be called from ISR context by a single consumer.
+ *
+ * @param out Pointer to where the oldest sample will be stored.
+ * @return true if a sample was popped successfully, false if the cache is empty.
+ */
+bool mem_cache_pop(sensor_sample_t *out)
+{
+    mem_cache_pin();
+
+    unsigned long tail = (unsigned long)atomic_get(&cache.tail);
+    unsigned long head = (unsigned long)atomic_get(&cache.head);
+    bool available = (head != tail);
+
+    if (available) {
+        memcpy(out, &cache.data[tail & CACHE_IDX_MASK], sizeof(sensor_sample_t));
+        atomic_set(&cache.tail, (atomic_val_t)(tail + 1));
+    }
+
+    mem_cache_unpin();
+    return available;
+}
+
+/**
+ * @brief Copy up to @p max oldest samples without removing them.
+ *
+ * Lock-free, may be called from ISR context by a single consumer. The copy
+ * is done in at most two dma_copy() chunks to handle ring wrap-around.
+ *
+ * @param out Array of at least @p max samples to receive the data.
+ * @param max Maximum number of samples to copy.
+ * @return The number of samples copied (0 if the cache is empty).
+ */
+size_t mem_cache_peek_n(sensor_sample_t *out, size_t max)
+{
+    unsigned long tail = (unsigned long)atomic_get(&cache.tail);
+    unsigned long head = (unsigned long)atomic_get(&cache.head);
+    size_t n = MIN((size_t)(head - tail), max);
+    size_t idx = tail & CACHE_IDX_MASK;
+    size_t first = MIN(n, CONFIG_CACHE_SIZE - idx);
+
+    dma_copy(out, &cache.data[idx], first * sizeof(sensor_sample_t));
+    dma_copy(&out[first], &cache.data[0], (n - first) * sizeof(sensor_sample_t));
+
+    return n;
+}
+
+/**
+ * @brief Release the @p n oldest samples.
+ *
+ * @param n Number of samples to release, at most mem_cache_count().
+ */
+void mem_cache_commit_pop_n(size_t n)
+{
+    atomic_add(&cache.tail, (atomic_val_t)n);
+}
+
+/**
+ * @brief Reserve the next free slot for in-place writing.
+ *
+ * Lock-free, may be called from ISR context by a single producer.
+ *
+ * @return Pointer to the reserved slot, or NULL if the cache is full.
+ */
+sensor_sample_t *mem_cache_reserve(void)
+{
+    unsigned long head = (unsigned long)cache.head;
+    unsigned long tail = (unsigned long)atomic_get(&cache.tail);
+
+    if ((head - tail) == CONFIG_CACHE_SIZE && !cache_overflow()) {
+        return NULL;
+    }
+
+    return &cache.data[head & CACHE_IDX_MASK];
+}
+
+/**
+ * @brief Publish the slot obtained from mem_cache_reserve().
+ */
+void mem_cache_commit_push(void)
+{
+    atomic_inc(&cache.head);
+}
+
+/**
+ * @brief Get a pointer to the oldest sample without removing it.
+ *
+ * Lock-free, may be called from ISR context by a single consumer.
+ *
+ * @param sample Set to the oldest sample in the cache.
+ * @return true if a sample is available, false if the cache is empty.
+ */
+bool mem_cache_peek(const sensor_sample_t **sample)
+{
+    unsigned long tail = (unsigned long)atomic_get(&cache.tail);
+    unsigned long head = (unsigned long)atomic_get(&cache.head);
+
+    if (head == tail) {
+        return false;
+    }
+
+    *sample = &cache.data[tail & CACHE_IDX_MASK];
+    return true;
+}
+
+/**
+ * @brief Release the sample obtained from mem_cache_peek().
+ */
+void mem_cache_commit_pop(void)
+{
+    atomic_inc(&cache.tail);
+}
+
+/**
+ * @brief Get a pointer to the @p idx-th oldest sample without removing it.
+ *
+ * Lock-free, may be called from ISR context by a single consumer.
+ *
+ * @param idx    Position from the head of the FIFO.
+ * @param sample Set to the requested sample.
+ * @return true if the sample exists, false if @p idx is past the newest sample.
+ */
+bool mem_cache_peek_at(size_t idx, const sensor_sample_t **sample)
+{
+    unsigned long tail = (unsigned long)atomic_get(&cache.tail);
+    unsigned long head = (unsigned long)atomic_get(&cache.head);
+
+    if (idx >= (size_t)(head - tail)) {
+        return false;
+    }
+
+    *sample = &cache.data[(tail + idx) & CACHE_IDX_MASK];
+    return true;
+}
+
+/**
+ * @brief Get the current count of samples in the cache.
+ *
+ * @return The number of samples currently stored in the cache.
+ */
+size_t mem_cache_count(void)
+{
+    unsigned long tail = (unsigned long)atomic_get(&cache.tail);
+    unsigned long head = (unsigned long)atomic_get(&cache.head);
+
+    return (size_t)(head - tail);
+}
+
+/**
+ * @brief Keep the oldest samples in place while reading them.
+ *
+ * Overflow handling is deferred (the newest sample is rejected instead)
+ * until every pin is released.
+ */
+void mem_cache_pin(void)
+{
+#if !defined(CONFIG_MEM_CACHE_OVERFLOW_REJECT)
+    k_spinlock_key_t key = k_spin_lock(&cache.lock);
+    cache.pins++;
+    k_spin_unlock(&cache.lock, key);
+#endif /* !CONFIG_MEM_CACHE_OVERFLOW_REJECT */
+}
+
+/**
+ * @brief Release a pin taken with mem_cache_pin().
+ */
+void mem_cache_unpin(void)
+{
+#if !defined(CONFIG_MEM_CACHE_OVERFLOW_REJECT)
+    k_spinlock_key_t key = k_spin_lock(&cache.lock);
+    cache.pins--;
+    k_spin_unlock(&cache.lock, key);
+#endif /* !CONFIG_MEM_CACHE_OVERFLOW_REJECT */
+}
+
+/**
+ * @brief Get the overflow counters.
+ *
+ * @param stats Filled with the current counters.
+ */
+void mem_cache_get_stats(mem_cache_stats_t *stats)
+{
+    stats->dropped = (uint32_t)atomic_get(&cache.dropped);
+    stats->decimated = (uint32_t)atomic_get(&cache.decimated);
+}
+
+/**
+ * @brief Initialize the memory cache.
+ *
+ * This function resets the head and tail counters, preparing the memory
+ * cache for use.
+ */
+static int mem_cache_init(void)
+{
+    atomic_clear(&cache.head);
+    atomic_clear(&cache.tail);
+    atomic_clear(&cache.dropped);
+    atomic_clear(&cache.decimated);
+
+    return 0;
+}
+
+#elif defined(CONFIG_MEM_CACHE_BACKEND_MUTEX)
+
 /* Define a structure to hold the cache and its metadata. */
 struct mem_cache_t {
     sensor_sample_t data[CONFIG_CACHE_SIZE];   /* Array to store sensor samples */
     size_t write_idx;                          /* Index of the next head position */
     size_t read_idx;                           /* Index of the next tail position */
     size_t count;                              /* Current count of samples in the cache */
+    uint32_t dropped;                          /* Samples lost to overflow */
+    uint32_t decimated;                        /* Samples thinned out by decimation */
+    unsigned int pins;                         /* Outstanding consumer pins */
     struct k_mutex lock;                       /* Mutex for thread safety */
 };
 
 /* Create the module instance. */
 static struct mem_cache_t cache;
 
+/**
+ * @brief Apply the overflow policy to a full cache.
+ *
+ * Must be called with the lock held. Old samples are only touched while no
+ * consumer holds a pin; otherwise the new sample is rejected.
+ *
+ * @return true if room was made for one more sample.
+ */
+static bool cache_overflow(void)
+{
+#if defined(CONFIG_MEM_CACHE_OVERFLOW_REJECT)
+    cache.dropped++;
+    return false;
+#else
+    size_t freed = 0;
+
+    if (cache.pins) {
+        cache.dropped++;
+        return false;
+    }
+
+#if defined(CONFIG_MEM_CACHE_OVERFLOW_DECIMATE)
+    /* Keep every second sample of the older half, see the SPSC backend */
+    size_t half = cache.count / 2;
+    size_t kept = (half + 1) / 2;
+
+    for (size_t k = 1; k < kept; k++) {
+        memcpy(&cache.data[(cache.read_idx + half - 1 - k) % CONFIG_CACHE_SIZE],
+               &cache.data[(cache.read_idx + half - 1 - 2 * k) % CONFIG_CACHE_SIZE],
+               sizeof(sensor_sample_t));
+    }
+    freed = half - kept;
+    cache.decimated += freed;
+#endif /* CONFIG_MEM_CACHE_OVERFLOW_DECIMATE */
+    if (freed == 0) {
+        /* Drop-oldest, or a cache too small to decimate */
+        freed = 1;
+        cache.dropped++;
+    }
+
+    cache.read_idx = (cache.read_idx + freed) % CONFIG_CACHE_SIZE;
+    cache.count -= freed;
+    return true;
+#endif /* CONFIG_MEM_CACHE_OVERFLOW_REJECT */
+}
+
 /**
  * @brief Push a sample into the FIFO cache.
  *
  * @param sample Pointer to the sensor sample to be added to the cache.
  * @return true if the sample was added successfully, false if the cache is full.
  */
-bool mem_cache_push(const sensor_sample_t *sample) 
+bool mem_cache_push(const sensor_sample_t *sample)
 {
     k_mutex_lock(&cache.lock, K_FOREVER);
 
-    if (cache.count == CONFIG_CACHE_SIZE) {
+    if (cache.count == CONFIG_CACHE_SIZE && !cache_overflow()) {
         k_mutex_unlock(&cache.lock);
         return false;
     }
@@ -38,6 +461,36 @@ bool mem_cache_push(const sensor_sample_t *sample)
     return true;
 }
 
+/**
+ * @brief Push a burst of samples into the FIFO cache.
+ *
+ * The whole burst is added under a single lock.
+ *
+ * @param samples Samples to add, oldest first.
+ * @param n       Number of samples.
+ * @return The number of samples added.
+ */
+size_t mem_cache_push_n(const sensor_sample_t *samples, size_t n)
+{
+    size_t pushed = 0;
+
+    k_mutex_lock(&cache.lock, K_FOREVER);
+
+    for (size_t i = 0; i < n; i++) {
+        if (cache.count == CONFIG_CACHE_SIZE && !cache_overflow()) {
+            continue;
+        }
+
+        memcpy(&cache.data[cache.write_idx], &samples[i], sizeof(sensor_sample_t));
+        cache.write_idx = (cache.write_idx + 1) % CONFIG_CACHE_SIZE;
+        cache.count++;
+        pushed++;
+    }
+
+    k_mutex_unlock(&cache.lock);
+    return pushed;
+}
+
 /**
  * @brief Pop the oldest sample from the cache.
  *
@@ -61,6 +514,129 @@ bool mem_cache_pop(sensor_sample_t *out)
     return true;
 }
 
+/**
+ * @brief Copy up to @p max oldest samples without removing them.
+ *
+ * The copy is done in at most two dma_copy() chunks to handle ring wrap-around.
+ *
+ * @param out Array of at least @p max samples to receive the data.
+ * @param max Maximum number of samples to copy.
+ * @return The number of samples copied (0 if the cache is empty).
+ */
+size_t mem_cache_peek_n(sensor_sample_t *out, size_t max)
+{
+    k_mutex_lock(&cache.lock, K_FOREVER);
+
+    size_t n = MIN(cache.count, max);
+    size_t first = MIN(n, CONFIG_CACHE_SIZE - cache.read_idx);
+
+    dma_copy(out, &cache.data[cache.read_idx], first * sizeof(sensor_sample_t));
+    dma_copy(&out[first], &cache.data[0], (n - first) * sizeof(sensor_sample_t));
+
+    k_mutex_unlock(&cache.lock);
+    return n;
+}
+
+/**
+ * @brief Release the @p n oldest samples.
+ *
+ * @param n Number of samples to release, at most mem_cache_count().
+ */
+void mem_cache_commit_pop_n(size_t n)
+{
+    k_mutex_lock(&cache.lock, K_FOREVER);
+    cache.read_idx = (cache.read_idx + n) % CONFIG_CACHE_SIZE;
+    cache.count -= n;
+    k_mutex_unlock(&cache.lock);
+}
+
+/**
+ * @brief Reserve the next free slot for in-place writing.
+ *
+ * The slot at write_idx is not visible to the consumer until committed,
+ * so it can be filled without holding the lock.
+ *
+ * @return Pointer to the reserved slot, or NULL if the cache is full.
+ */
+sensor_sample_t *mem_cache_reserve(void)
+{
+    sensor_sample_t *slot = NULL;
+
+    k_mutex_lock(&cache.lock, K_FOREVER);
+    if (cache.count < CONFIG_CACHE_SIZE || cache_overflow()) {
+        slot = &cache.data[cache.write_idx];
+    }
+    k_mutex_unlock(&cache.lock);
+
+    return slot;
+}
+
+/**
+ * @brief Publish the slot obtained from mem_cache_reserve().
+ */
+void mem_cache_commit_push(void)
+{
+    k_mutex_lock(&cache.lock, K_FOREVER);
+    cache.write_idx = (cache.write_idx + 1) % CONFIG_CACHE_SIZE;
+    cache.count++;
+    k_mutex_unlock(&cache.lock);
+}
+
+/**
+ * @brief Get a pointer to the oldest sample without removing it.
+ *
+ * The slot at read_idx is not reused by the producer until committed,
+ * so it can be read without holding the lock.
+ *
+ * @param sample Set to the oldest sample in the cache.
+ * @return true if a sample is available, false if the cache is empty.
+ */
+bool mem_cache_peek(const sensor_sample_t **sample)
+{
+    bool available;
+
+    k_mutex_lock(&cache.lock, K_FOREVER);
+    available = (cache.count > 0);
+    if (available) {
+        *sample = &cache.data[cache.read_idx];
+    }
+    k_mutex_unlock(&cache.lock);
+
+    return available;
+}
+
+/**
+ * @brief Release the sample obtained from mem_cache_peek().
+ */
+void mem_cache_commit_pop(void)
+{
+    k_mutex_lock(&cache.lock, K_FOREVER);
+    cache.read_idx = (cache.read_idx + 1) % CONFIG_CACHE_SIZE;
+    cache.count--;
+    k_mutex_unlock(&cache.lock);
+}
+
+/**
+ * @brief Get a pointer to the @p idx-th oldest sample without removing it.
+ *
+ * @param idx    Position from the head of the FIFO.
+ * @param sample Set to the requested sample.
+ * @return true if the sample exists, false if @p idx is past the newest sample.
+ */
+bool mem_cache_peek_at(size_t idx, const sensor_sample_t **sample)
+{
+    bool available;
+
+    k_mutex_lock(&cache.lock, K_FOREVER);
+    available = (idx < cache.count);
+    if (available) {
+        *sample = &cache.data[(cache.read_idx + idx) % CONFIG_CACHE_SIZE];
+    }
+    k_mutex_unlock(&cache.lock);
+
+    return available;
+}
+
 /**
  * @brief Get the current count of samples in the cache.
  *
@@ -74,6 +650,39 @@ size_t mem_cache_count(void)
     return c;
 }
 
+/**
+ * @brief Keep the oldest samples in place while reading them.
+ */
+void mem_cache_pin(void)
+{
+    k_mutex_lock(&cache.lock, K_FOREVER);
+    cache.pins++;
+    k_mutex_unlock(&cache.lock);
+}
+
+/**
+ * @brief Release a pin taken with mem_cache_pin().
+ */
+void mem_cache_unpin(void)
+{
+    k_mutex_lock(&cache.lock, K_FOREVER);
+    cache.pins--;
+    k_mutex_unlock(&cache.lock);
+}
+
+/**
+ * @brief Get the overflow counters.
+ *
+ * @param stats Filled with the current counters.
+ */
+void mem_cache_get_stats(mem_cache_stats_t *stats)
+{
+    k_mutex_lock(&cache.lock, K_FOREVER);
+    stats->dropped = cache.dropped;
+    stats->decimated = cache.decimated;
+    k_mutex_unlock(&cache.lock);
+}
+
 /**
  * @brief Initialize the memory cache.
  *
@@ -85,9 +694,134 @@ static int mem_cache_init(void)
     cache.count = 0;
     cache.read_idx = 0;
     cache.write_idx = 0;
+    cache.dropped = 0;
+    cache.decimated = 0;
+    cache.pins = 0;
     k_mutex_init(&cache.lock);
 
     return 0;
 }
 
+#endif /* CONFIG_MEM_CACHE_BACKEND_SPSC */
+
+/*
+ * The byte arena and slab backends live in mem_cache_arena.c and
+ * mem_cache_slab.c; the helpers below are shared by all backends.
+ */
+
+/**
+ * @brief Pop up to @p max oldest samples from the cache in one call.
+ *
+ * @param out Array of at least @p max samples to receive the popped data.
+ * @param max Maximum number of samples to pop.
+ * @return The number of samples actually popped (0 if the cache is empty).
+ */
+size_t mem_cache_pop_n(sensor_sample_t *out, size_t max)
+{
+    mem_cache_pin();
+
+    size_t n = mem_cache_peek_n(out, max);
+
+    mem_cache_commit_pop_n(n);
+    mem_cache_unpin();
+    return n;
+}
+
+#if defined(CONFIG_MEM_CACHE_ALERT)
+/*
+ * Alert stream, shared by all backends: a few whole samples under a
+ * spinlock, so a push from any context never waits for the bulk cache.
+ */
+static struct {
+    struct k_spinlock lock;                                /* Protects the fields below */
+    sensor_sample_t ring[CONFIG_MEM_CACHE_ALERT_SIZE];     /* Alert copies */
+    size_t head;                                           /* Slot of the oldest alert */
+    size_t count;                                          /* Alerts held */
+} alerts;
+
+/**
+ * @brief Queue a copy of a sample on the alert stream.
+ *
+ * @param sample The sample that raised the alert.
+ * @return true if it was queued without loss, false if the oldest alert
+ *         was dropped to make room.
+ */
+bool mem_cache_alert_push(const sensor_sample_t *sample)
+{
+    k_spinlock_key_t key = k_spin_lock(&alerts.lock);
+    bool full = (alerts.count == ARRAY_SIZE(alerts.ring));
+
+    if (full) {
+        alerts.head = (alerts.head + 1) % ARRAY_SIZE(alerts.ring);
+        alerts.count--;
+    }
+    memcpy(&alerts.ring[(alerts.head + alerts.count) % ARRAY_SIZE(alerts.ring)], sample,
+           sizeof(*sample));
+    alerts.count++;
+
+    k_spin_unlock(&alerts.lock, key);
+    return !full;
+}
+
+/**
+ * @brief Copy the oldest alerts newer than a consumer's position.
+ *
+ * @param synced   false to start at the oldest alert held.
+ * @param last_seq Sequence number of the last alert the consumer got.
+ * @param out      Array of at least @p max samples to receive the alerts.
+ * @param max      Maximum number of alerts to copy.
+ * @return The number of alerts copied.
+ */
+size_t mem_cache_alert_peek(bool synced, uint32_t last_seq, sensor_sample_t *out, size_t max)
+{
+    k_spinlock_key_t key = k_spin_lock(&alerts.lock);
+    size_t n = 0;
+
+    for (size_t i = 0; i < alerts.count && n < max; i++) {
+        const sensor_sample_t *alert = &alerts.ring[(alerts.head + i) % ARRAY_SIZE(alerts.ring)];
+
+        /* Sequence numbers wrap, compare by distance */
+        if (!synced || (int32_t)(alert->hdr.seq - last_seq) > 0) {
+            memcpy(&out[n++], alert, sizeof(*alert));
+        }
+    }
+
+    k_spin_unlock(&alerts.lock, key);
+    return n;
+}
+
+/**
+ * @brief Release the alerts up to and including @p seq.
+ *
+ * @param seq Sequence number of the newest alert every consumer got.
+ */
+void mem_cache_alert_release(uint32_t seq)
+{
+    k_spinlock_key_t key = k_spin_lock(&alerts.lock);
+
+    while (alerts.count && (int32_t)(alerts.ring[alerts.head].hdr.seq - seq) <= 0) {
+        alerts.head = (alerts.head + 1) % ARRAY_SIZE(alerts.ring);
+        alerts.count--;
+    }
+
+    k_spin_unlock(&alerts.lock, key);
+}
+
+/**
+ * @brief Get the number of alerts held.
+ *
+ * @return Alerts not released yet.
+ */
+size_t mem_cache_alert_count(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&alerts.lock);
+    size_t n = alerts.count;
+
+    k_spin_unlock(&alerts.lock, key);
+    return n;
+}
+#endif /* CONFIG_MEM_CACHE_ALERT */
+
+#if defined(CONFIG_MEM_CACHE_BACKEND_SPSC) || defined(CONFIG_MEM_CACHE_BACKEND_MUTEX)
 SYS_INIT(mem_cache_init, POST_KERNEL, CONFIG_KERNEL_INIT_PRIORITY_DEVICE);
+#endif /* CONFIG_MEM_CACHE_BACKEND_SPSC || CONFIG_MEM_CACHE_BACKEND_MUTEX */
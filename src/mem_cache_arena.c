@@ -0,0 +1,478 @@
+#include <zephyr/kernel.h>
+#include <zephyr/init.h>
+#include <zephyr/sys/atomic.h>
+#include <string.h>
+#include "mem_cache.h"
+
+BUILD_ASSERT(IS_POWER_OF_TWO(CONFIG_CACHE_ARENA_SIZE),
+             "CONFIG_CACHE_ARENA_SIZE must be a power of two");
+
+#define ARENA_MASK (CONFIG_CACHE_ARENA_SIZE - 1)
+
+/* Records are aligned for in-place sample access. Codec records are byte
+ * streams, but the typed API still hands out any record as a sample */
+#define REC_ALIGN __alignof__(sensor_sample_t)
+
+/* Every record starts with a 16-bit length, padded to keep the payload aligned */
+#define REC_HDR_LEN REC_ALIGN
+
+/* Length value marking unused space up to the end of the arena */
+#define REC_WRAP 0xFFFF
+
+/* Arena bytes taken by a record with a payload of @p len bytes */
+#define REC_SPAN(len) ROUND_UP(REC_HDR_LEN + (len), REC_ALIGN)
+
+BUILD_ASSERT(CONFIG_CACHE_ARENA_SIZE >= 2 * __alignof__(sensor_sample_t),
+             "CONFIG_CACHE_ARENA_SIZE is smaller than the record alignment");
+
+/*
+ * Define a structure to hold the byte arena and its metadata.
+ *
+ * Records are stored contiguously behind a length prefix. A record that
+ * does not fit before the end of the arena is placed at offset 0 and the
+ * gap is marked with REC_WRAP, so every payload can be handed out as a
+ * single pointer. Like the SPSC backend, the producer only writes head and
+ * pushed and the consumer only writes tail and popped, so no lock is needed.
+ * Dropping old records on overflow is the exception and is serialized
+ * against consumer pins by the spinlock.
+ */
+struct mem_cache_t {
+    uint8_t data[CONFIG_CACHE_ARENA_SIZE] __aligned(REC_ALIGN); /* Record storage */
+    atomic_t head;                                              /* Free-running bytes written (producer owned) */
+    atomic_t tail;                                              /* Free-running bytes released (consumer owned) */
+    atomic_t pushed;                                            /* Records published (producer owned) */
+    atomic_t popped;                                            /* Records released (consumer owned) */
+    unsigned long resv;                                         /* Byte offset of the reserved record (producer only) */
+    atomic_t dropped;                                           /* Records lost to overflow */
+    struct k_spinlock lock;                                     /* Serializes overflow handling and pins */
+    unsigned int pins;                                          /* Outstanding consumer pins */
+};
+
+/* Create the module instance. */
+static struct mem_cache_t cache;
+
+/**
+ * @brief Access the length prefix stored at an arena offset.
+ */
+static inline uint16_t *rec_hdr(unsigned long off)
+{
+    return (uint16_t *)&cache.data[off & ARENA_MASK];
+}
+
+/**
+ * @brief Step over a wrap marker, if any.
+ *
+ * @param off Free-running offset of a record header or wrap marker.
+ * @return Free-running offset of the record header.
+ */
+static unsigned long rec_skip_wrap(unsigned long off)
+{
+    if (*rec_hdr(off) == REC_WRAP) {
+        off += CONFIG_CACHE_ARENA_SIZE - (off & ARENA_MASK);
+    }
+
+    return off;
+}
+
+/**
+ * @brief Find the @p idx-th oldest record.
+ *
+ * Only called by the consumer with @p idx below the published record count.
+ *
+ * @return Free-running offset of the record header.
+ */
+static unsigned long rec_find(size_t idx)
+{
+    unsigned long off = rec_skip_wrap((unsigned long)atomic_get(&cache.tail));
+
+    while (idx--) {
+        off = rec_skip_wrap(off + REC_SPAN(*rec_hdr(off)));
+    }
+
+    return off;
+}
+
+/**
+ * @brief Check whether @p need contiguous bytes fit behind the head.
+ *
+ * @param tail Tail counter to check against.
+ * @param need Bytes required, see REC_SPAN().
+ * @return true if the space is available.
+ */
+static bool rec_fits(unsigned long tail, size_t need)
+{
+    unsigned long head = (unsigned long)cache.head;
+    size_t free = CONFIG_CACHE_ARENA_SIZE - (size_t)(head - tail);
+    size_t pos = head & ARENA_MASK;
+    size_t skip = (need > CONFIG_CACHE_ARENA_SIZE - pos) ? CONFIG_CACHE_ARENA_SIZE - pos : 0;
+
+    return skip + need <= free;
+}
+
+/**
+ * @brief Apply the overflow policy when a record does not fit.
+ *
+ * Called by the producer. Old records are only dropped while no consumer
+ * holds a pin; otherwise the new record is rejected.
+ *
+ * @param need Bytes required, see REC_SPAN().
+ * @return true if room was made for the record.
+ */
+static bool rec_overflow(size_t need)
+{
+#if defined(CONFIG_MEM_CACHE_OVERFLOW_REJECT)
+    ARG_UNUSED(need);
+    atomic_inc(&cache.dropped);
+    return false;
+#else
+    k_spinlock_key_t key = k_spin_lock(&cache.lock);
+    unsigned long tail = (unsigned long)atomic_get(&cache.tail);
+    unsigned long popped = (unsigned long)atomic_get(&cache.popped);
+    unsigned long pushed = (unsigned long)cache.pushed;
+    bool room;
+
+    if (cache.pins) {
+        room = rec_fits(tail, need);
+    } else {
+        while (!rec_fits(tail, need) && popped != pushed) {
+            tail = rec_skip_wrap(tail);
+            tail += REC_SPAN(*rec_hdr(tail));
+            popped++;
+            atomic_inc(&cache.dropped);
+        }
+        atomic_set(&cache.tail, (atomic_val_t)tail);
+        atomic_set(&cache.popped, (atomic_val_t)popped);
+        room = rec_fits(tail, need);
+    }
+
+    if (!room) {
+        atomic_inc(&cache.dropped);
+    }
+
+    k_spin_unlock(&cache.lock, key);
+    return room;
+#endif /* CONFIG_MEM_CACHE_OVERFLOW_REJECT */
+}
+
+/**
+ * @brief Reserve contiguous space for a record of up to @p max_len bytes.
+ *
+ * @param max_len Largest payload the producer may write.
+ * @return Pointer to the payload area, or NULL if the arena is full.
+ */
+uint8_t *mem_cache_reserve_record(size_t max_len)
+{
+    unsigned long head = (unsigned long)cache.head;
+    size_t pos = head & ARENA_MASK;
+    size_t need = REC_SPAN(max_len);
+    size_t skip = (need > CONFIG_CACHE_ARENA_SIZE - pos) ? CONFIG_CACHE_ARENA_SIZE - pos : 0;
+
+    if (max_len >= REC_WRAP || skip + need > CONFIG_CACHE_ARENA_SIZE) {
+        return NULL;
+    }
+
+    if (!rec_fits((unsigned long)atomic_get(&cache.tail), need) && !rec_overflow(need)) {
+        return NULL;
+    }
+
+    if (skip) {
+        /* Not visible to the consumer until the record is committed */
+        *rec_hdr(head) = REC_WRAP;
+        head += skip;
+    }
+
+    cache.resv = head;
+    return &cache.data[(head & ARENA_MASK) + REC_HDR_LEN];
+}
+
+/**
+ * @brief Publish the record obtained from mem_cache_reserve_record().
+ *
+ * @param len Actual payload length, at most the reserved size.
+ */
+void mem_cache_commit_push_record(size_t len)
+{
+    *rec_hdr(cache.resv) = len;
+    atomic_set(&cache.head, (atomic_val_t)(cache.resv + REC_SPAN(len)));
+    atomic_inc(&cache.pushed);
+}
+
+/**
+ * @brief Copy a record into the arena.
+ *
+ * @param rec Record payload.
+ * @param len Payload length in bytes.
+ * @return true if the record was added, false if the arena is full.
+ */
+bool mem_cache_push_record(const void *rec, size_t len)
+{
+    uint8_t *dst = mem_cache_reserve_record(len);
+
+    if (!dst) {
+        return false;
+    }
+
+    memcpy(dst, rec, len);
+    mem_cache_commit_push_record(len);
+    return true;
+}
+
+/**
+ * @brief Get the @p idx-th oldest record without removing it.
+ *
+ * @param idx Position from the head of the FIFO.
+ * @param rec Set to the record payload.
+ * @return Payload length, or 0 if @p idx is past the newest record.
+ */
+size_t mem_cache_peek_record_at(size_t idx, const uint8_t **rec)
+{
+    unsigned long popped = (unsigned long)atomic_get(&cache.popped);
+    unsigned long pushed = (unsigned long)atomic_get(&cache.pushed);
+
+    if (idx >= (size_t)(pushed - popped)) {
+        return 0;
+    }
+
+    unsigned long off = rec_find(idx);
+
+    *rec = &cache.data[(off & ARENA_MASK) + REC_HDR_LEN];
+    return *rec_hdr(off);
+}
+
+/**
+ * @brief Get the oldest record without removing it.
+ *
+ * @param rec Set to the record payload.
+ * @return Payload length, or 0 if the arena is empty.
+ */
+size_t mem_cache_peek_record(const uint8_t **rec)
+{
+    return mem_cache_peek_record_at(0, rec);
+}
+
+/**
+ * @brief Pop the oldest record.
+ *
+ * @param buf Destination buffer.
+ * @param cap Size of @p buf in bytes.
+ * @return Payload length, or 0 if the arena is empty or the record does
+ *         not fit in @p cap (it is then left in place).
+ */
+size_t mem_cache_pop_record(void *buf, size_t cap)
+{
+    const uint8_t *rec;
+
+    mem_cache_pin();
+
+    size_t len = mem_cache_peek_record(&rec);
+
+    if (len == 0 || len > cap) {
+        len = 0;
+    } else {
+        memcpy(buf, rec, len);
+        mem_cache_commit_pop();
+    }
+
+    mem_cache_unpin();
+    return len;
+}
+
+/**
+ * @brief Release the @p n oldest records.
+ *
+ * @param n Number of records to release, at most mem_cache_count().
+ */
+void mem_cache_commit_pop_n(size_t n)
+{
+    if (n == 0) {
+        return;
+    }
+
+    unsigned long off = rec_find(n - 1);
+
+    atomic_set(&cache.tail, (atomic_val_t)(off + REC_SPAN(*rec_hdr(off))));
+    atomic_add(&cache.popped, (atomic_val_t)n);
+}
+
+/**
+ * @brief Release the record obtained from mem_cache_peek().
+ */
+void mem_cache_commit_pop(void)
+{
+    mem_cache_commit_pop_n(1);
+}
+
+/**
+ * @brief Push a sample into the FIFO cache.
+ *
+ * @param sample Pointer to the sensor sample to be added to the cache.
+ * @return true if the sample was added successfully, false if the cache is full.
+ */
+bool mem_cache_push(const sensor_sample_t *sample)
+{
+    return mem_cache_push_record(sample, sizeof(*sample));
+}
+
+/**
+ * @brief Push a burst of samples, one record each.
+ *
+ * @param samples Samples to add, oldest first.
+ * @param n       Number of samples.
+ * @return The number of samples added.
+ */
+size_t mem_cache_push_n(const sensor_sample_t *samples, size_t n)
+{
+    size_t pushed = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        pushed += mem_cache_push(&samples[i]);
+    }
+
+    return pushed;
+}
+
+/**
+ * @brief Pop the oldest sample from the cache.
+ *
+ * @param out Pointer to where the oldest sample will be stored.
+ * @return true if a sample was popped successfully, false if the cache is empty.
+ */
+bool mem_cache_pop(sensor_sample_t *out)
+{
+    return mem_cache_pop_record(out, sizeof(*out)) == sizeof(*out);
+}
+
+/**
+ * @brief Reserve the next free slot for in-place writing.
+ *
+ * @return Pointer to the reserved slot, or NULL if the cache is full.
+ */
+sensor_sample_t *mem_cache_reserve(void)
+{
+    return (sensor_sample_t *)mem_cache_reserve_record(sizeof(sensor_sample_t));
+}
+
+/**
+ * @brief Publish the slot obtained from mem_cache_reserve().
+ */
+void mem_cache_commit_push(void)
+{
+    mem_cache_commit_push_record(sizeof(sensor_sample_t));
+}
+
+/**
+ * @brief Get a pointer to the @p idx-th oldest sample without removing it.
+ *
+ * @param idx    Position from the head of the FIFO.
+ * @param sample Set to the requested sample.
+ * @return true if the sample exists, false if @p idx is past the newest sample.
+ */
+bool mem_cache_peek_at(size_t idx, const sensor_sample_t **sample)
+{
+    const uint8_t *rec;
+
+    if (mem_cache_peek_record_at(idx, &rec) != sizeof(sensor_sample_t)) {
+        return false;
+    }
+
+    *sample = (const sensor_sample_t *)rec;
+    return true;
+}
+
+/**
+ * @brief Get a pointer to the oldest sample without removing it.
+ *
+ * @param sample Set to the oldest sample in the cache.
+ * @return true if a sample is available, false if the cache is empty.
+ */
+bool mem_cache_peek(const sensor_sample_t **sample)
+{
+    return mem_cache_peek_at(0, sample);
+}
+
+/**
+ * @brief Copy up to @p max oldest samples without removing them.
+ *
+ * @param out Array of at least @p max samples to receive the data.
+ * @param max Maximum number of samples to copy.
+ * @return The number of samples copied (0 if the cache is empty).
+ */
+size_t mem_cache_peek_n(sensor_sample_t *out, size_t max)
+{
+    const sensor_sample_t *sample;
+    size_t n = 0;
+
+    while (n < max && mem_cache_peek_at(n, &sample)) {
+        memcpy(&out[n], sample, sizeof(*sample));
+        n++;
+    }
+
+    return n;
+}
+
+/**
+ * @brief Keep the oldest records in place while reading them.
+ */
+void mem_cache_pin(void)
+{
+#if !defined(CONFIG_MEM_CACHE_OVERFLOW_REJECT)
+    k_spinlock_key_t key = k_spin_lock(&cache.lock);
+    cache.pins++;
+    k_spin_unlock(&cache.lock, key);
+#endif /* !CONFIG_MEM_CACHE_OVERFLOW_REJECT */
+}
+
+/**
+ * @brief Release a pin taken with mem_cache_pin().
+ */
+void mem_cache_unpin(void)
+{
+#if !defined(CONFIG_MEM_CACHE_OVERFLOW_REJECT)
+    k_spinlock_key_t key = k_spin_lock(&cache.lock);
+    cache.pins--;
+    k_spin_unlock(&cache.lock, key);
+#endif /* !CONFIG_MEM_CACHE_OVERFLOW_REJECT */
+}
+
+/**
+ * @brief Get the overflow counters.
+ *
+ * @param stats Filled with the current counters.
+ */
+void mem_cache_get_stats(mem_cache_stats_t *stats)
+{
+    stats->dropped = (uint32_t)atomic_get(&cache.dropped);
+    stats->decimated = 0;
+}
+
+/**
+ * @brief Get the current count of records in the cache.
+ *
+ * @return The number of records currently stored in the cache.
+ */
+size_t mem_cache_count(void)
+{
+    unsigned long popped = (unsigned long)atomic_get(&cache.popped);
+    unsigned long pushed = (unsigned long)atomic_get(&cache.pushed);
+
+    return (size_t)(pushed - popped);
+}
+
+/**
+ * @brief Initialize the memory cache.
+ *
+ * This function resets the byte and record counters, preparing the arena
+ * for use.
+ */
+static int mem_cache_init(void)
+{
+    atomic_clear(&cache.head);
+    atomic_clear(&cache.tail);
+    atomic_clear(&cache.pushed);
+    atomic_clear(&cache.popped);
+    atomic_clear(&cache.dropped);
+
+    return 0;
+}
+
+SYS_INIT(mem_cache_init, POST_KERNEL, CONFIG_KERNEL_INIT_PRIORITY_DEVICE);
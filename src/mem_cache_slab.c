@@ -0,0 +1,549 @@
+#include <zephyr/kernel.h>
+#include <zephyr/init.h>
+#include <errno.h>
+#include <string.h>
+#include "dma_copy.h"
+#include "mem_cache.h"
+
+/* Samples per pool block, the unit the cache grows and shrinks by */
+#define CACHE_BLOCK_LEN CONFIG_CACHE_BLOCK_SAMPLES
+
+/* A cache at its largest capacity spans one more block while the tail is
+ * part-way through the oldest one */
+#define CACHE_RING_BLOCKS (CONFIG_CACHE_MAX_BLOCKS + 1)
+
+/* Slot positions the ring of blocks covers */
+#define CACHE_RING_LEN (CACHE_RING_BLOCKS * CACHE_BLOCK_LEN)
+
+BUILD_ASSERT(CONFIG_CACHE_MIN_BLOCKS <= CONFIG_CACHE_MAX_BLOCKS,
+             "CONFIG_CACHE_MIN_BLOCKS must not exceed CONFIG_CACHE_MAX_BLOCKS");
+BUILD_ASSERT(CONFIG_CACHE_MIN_BLOCKS <= CONFIG_CACHE_POOL_BLOCKS,
+             "Pool too small for the blocks the cache always keeps");
+BUILD_ASSERT(CACHE_RING_BLOCKS <= CONFIG_CACHE_POOL_BLOCKS,
+             "CONFIG_CACHE_MAX_BLOCKS must be below CONFIG_CACHE_POOL_BLOCKS");
+
+/*
+ * Define a structure to hold the block ring and its metadata.
+ *
+ * Slot i of the ring lives in blocks[i / CACHE_BLOCK_LEN]. Blocks are
+ * taken from the shared pool when the write position enters them and go
+ * back once the read position has left them, so an idle cache only holds
+ * the CONFIG_CACHE_MIN_BLOCKS it keeps in spare.
+ */
+struct mem_cache_t {
+    sensor_sample_t *blocks[CACHE_RING_BLOCKS];       /* Blocks in use, NULL if not held */
+    sensor_sample_t *spare[CONFIG_CACHE_MIN_BLOCKS];  /* Kept blocks not in use */
+    size_t spare_n;                                   /* Blocks in spare */
+    size_t held;                                      /* Blocks in use and in spare */
+    size_t capacity;                                  /* Most samples the cache may hold */
+    size_t read_idx;                                  /* Ring slot of the oldest sample */
+    size_t count;                                     /* Current count of samples in the cache */
+    uint32_t dropped;                                 /* Samples lost to overflow */
+    uint32_t decimated;                               /* Samples thinned out by decimation */
+    unsigned int pins;                                /* Outstanding consumer pins */
+    struct k_mutex lock;                              /* Mutex for thread safety */
+};
+
+/* Shared pool the cache and other subsystems take blocks from */
+K_MEM_SLAB_DEFINE_STATIC(cache_pool, MEM_CACHE_POOL_BLOCK_LEN, CONFIG_CACHE_POOL_BLOCKS,
+                         __alignof__(sensor_sample_t));
+
+/* Create the module instance. */
+static struct mem_cache_t cache;
+
+
+/******************************************************************************
+ * Blocks
+ ******************************************************************************/
+
+/**
+ * @brief Get the slot of the @p idx-th oldest sample.
+ *
+ * @param idx Position from the head of the FIFO, its block must be held.
+ * @return Pointer to the slot.
+ */
+static inline sensor_sample_t *cache_slot(size_t idx)
+{
+    size_t pos = (cache.read_idx + idx) % CACHE_RING_LEN;
+
+    return &cache.blocks[pos / CACHE_BLOCK_LEN][pos % CACHE_BLOCK_LEN];
+}
+
+/**
+ * @brief Give the ring a block for a slot position.
+ *
+ * Spare blocks are used before the pool is asked.
+ *
+ * @param blk Ring block index.
+ * @return true if the block is held.
+ */
+static bool cache_grow(size_t blk)
+{
+    void *block;
+
+    if (cache.blocks[blk]) {
+        return true;
+    }
+    if (cache.spare_n) {
+        cache.blocks[blk] = cache.spare[--cache.spare_n];
+        return true;
+    }
+    if (k_mem_slab_alloc(&cache_pool, &block, K_NO_WAIT)) {
+        return false;
+    }
+
+    cache.blocks[blk] = block;
+    cache.held++;
+    return true;
+}
+
+/**
+ * @brief Take a block off the ring once nothing lives in it.
+ *
+ * The block goes to spare while the cache holds no more than its minimum,
+ * otherwise back to the pool.
+ *
+ * @param blk Ring block index.
+ */
+static void cache_shrink(size_t blk)
+{
+    sensor_sample_t *block = cache.blocks[blk];
+
+    if (!block) {
+        return;
+    }
+
+    cache.blocks[blk] = NULL;
+    if (cache.held <= CONFIG_CACHE_MIN_BLOCKS) {
+        cache.spare[cache.spare_n++] = block;
+    } else {
+        k_mem_slab_free(&cache_pool, block);
+        cache.held--;
+    }
+}
+
+/**
+ * @brief Release the @p n oldest samples and the blocks they leave empty.
+ *
+ * The block of the read position stays on the ring, the next sample
+ * written after it goes there.
+ *
+ * @param n Number of samples, at most cache.count.
+ */
+static void cache_advance(size_t n)
+{
+    size_t from = cache.read_idx / CACHE_BLOCK_LEN;
+
+    cache.read_idx = (cache.read_idx + n) % CACHE_RING_LEN;
+    cache.count -= n;
+
+    for (size_t blk = from; blk != cache.read_idx / CACHE_BLOCK_LEN;
+         blk = (blk + 1) % CACHE_RING_BLOCKS) {
+        cache_shrink(blk);
+    }
+}
+
+
+/******************************************************************************
+ * Overflow
+ ******************************************************************************/
+
+/**
+ * @brief Apply the overflow policy to a full cache.
+ *
+ * Must be called with the lock held. Old samples are only touched while no
+ * consumer holds a pin; otherwise the new sample is rejected.
+ *
+ * @return true if room was made for one more sample.
+ */
+static bool cache_overflow(void)
+{
+#if defined(CONFIG_MEM_CACHE_OVERFLOW_REJECT)
+    cache.dropped++;
+    return false;
+#else
+    size_t freed = 0;
+
+    if (cache.pins) {
+        cache.dropped++;
+        return false;
+    }
+
+#if defined(CONFIG_MEM_CACHE_OVERFLOW_DECIMATE)
+    /* Keep every second sample of the older half, see the SPSC backend */
+    size_t half = cache.count / 2;
+    size_t kept = (half + 1) / 2;
+
+    for (size_t k = 1; k < kept; k++) {
+        memcpy(cache_slot(half - 1 - k), cache_slot(half - 1 - 2 * k), sizeof(sensor_sample_t));
+    }
+    freed = half - kept;
+    cache.decimated += freed;
+#endif /* CONFIG_MEM_CACHE_OVERFLOW_DECIMATE */
+    if (freed == 0) {
+        /* Drop-oldest, or a cache too small to decimate */
+        freed = 1;
+        cache.dropped++;
+    }
+
+    cache_advance(freed);
+    return true;
+#endif /* CONFIG_MEM_CACHE_OVERFLOW_REJECT */
+}
+
+/**
+ * @brief Find the slot the next sample is written to.
+ *
+ * Must be called with the lock held. A full cache is handled by the
+ * overflow policy. A pool that ran dry rejects the sample under every
+ * policy: dropping old samples cannot free a block that still holds
+ * newer ones.
+ *
+ * @return Pointer to the slot, or NULL if the sample has to be rejected.
+ */
+static sensor_sample_t *cache_write_slot(void)
+{
+    if (cache.count >= cache.capacity && !cache_overflow()) {
+        return NULL;
+    }
+
+    size_t pos = (cache.read_idx + cache.count) % CACHE_RING_LEN;
+
+    if (!cache_grow(pos / CACHE_BLOCK_LEN)) {
+        cache.dropped++;
+        return NULL;
+    }
+
+    return &cache.blocks[pos / CACHE_BLOCK_LEN][pos % CACHE_BLOCK_LEN];
+}
+
+
+/******************************************************************************
+ * Public API
+ ******************************************************************************/
+
+/**
+ * @brief Push a sample into the FIFO cache.
+ *
+ * @param sample Pointer to the sensor sample to be added to the cache.
+ * @return true if the sample was added successfully, false if the cache is full.
+ */
+bool mem_cache_push(const sensor_sample_t *sample)
+{
+    k_mutex_lock(&cache.lock, K_FOREVER);
+
+    sensor_sample_t *slot = cache_write_slot();
+
+    if (slot) {
+        memcpy(slot, sample, sizeof(sensor_sample_t));
+        cache.count++;
+    }
+
+    k_mutex_unlock(&cache.lock);
+    return slot != NULL;
+}
+
+/**
+ * @brief Push a burst of samples into the FIFO cache.
+ *
+ * The whole burst is added under a single lock.
+ *
+ * @param samples Samples to add, oldest first.
+ * @param n       Number of samples.
+ * @return The number of samples added.
+ */
+size_t mem_cache_push_n(const sensor_sample_t *samples, size_t n)
+{
+    size_t pushed = 0;
+
+    k_mutex_lock(&cache.lock, K_FOREVER);
+
+    for (size_t i = 0; i < n; i++) {
+        sensor_sample_t *slot = cache_write_slot();
+
+        if (!slot) {
+            continue;
+        }
+
+        memcpy(slot, &samples[i], sizeof(sensor_sample_t));
+        cache.count++;
+        pushed++;
+    }
+
+    k_mutex_unlock(&cache.lock);
+    return pushed;
+}
+
+/**
+ * @brief Pop the oldest sample from the cache.
+ *
+ * @param out Pointer to where the oldest sample will be stored.
+ * @return true if a sample was popped successfully, false if the cache is empty.
+ */
+bool mem_cache_pop(sensor_sample_t *out)
+{
+    k_mutex_lock(&cache.lock, K_FOREVER);
+
+    if (cache.count == 0) {
+        k_mutex_unlock(&cache.lock);
+        return false;
+    }
+
+    memcpy(out, cache_slot(0), sizeof(sensor_sample_t));
+    cache_advance(1);
+
+    k_mutex_unlock(&cache.lock);
+    return true;
+}
+
+/**
+ * @brief Copy up to @p max oldest samples without removing them.
+ *
+ * The copy is done in one dma_copy() chunk per block.
+ *
+ * @param out Array of at least @p max samples to receive the data.
+ * @param max Maximum number of samples to copy.
+ * @return The number of samples copied (0 if the cache is empty).
+ */
+size_t mem_cache_peek_n(sensor_sample_t *out, size_t max)
+{
+    k_mutex_lock(&cache.lock, K_FOREVER);
+
+    size_t n = MIN(cache.count, max);
+
+    for (size_t i = 0; i < n;) {
+        size_t pos = (cache.read_idx + i) % CACHE_RING_LEN;
+        size_t run = MIN(n - i, CACHE_BLOCK_LEN - pos % CACHE_BLOCK_LEN);
+
+        dma_copy(&out[i], cache_slot(i), run * sizeof(sensor_sample_t));
+        i += run;
+    }
+
+    k_mutex_unlock(&cache.lock);
+    return n;
+}
+
+/**
+ * @brief Release the @p n oldest samples.
+ *
+ * @param n Number of samples to release, at most mem_cache_count().
+ */
+void mem_cache_commit_pop_n(size_t n)
+{
+    k_mutex_lock(&cache.lock, K_FOREVER);
+    cache_advance(n);
+    k_mutex_unlock(&cache.lock);
+}
+
+/**
+ * @brief Reserve the next free slot for in-place writing.
+ *
+ * The slot is not visible to the consumer until committed, so it can be
+ * filled without holding the lock. Its block stays held until then.
+ *
+ * @return Pointer to the reserved slot, or NULL if the cache is full.
+ */
+sensor_sample_t *mem_cache_reserve(void)
+{
+    k_mutex_lock(&cache.lock, K_FOREVER);
+    sensor_sample_t *slot = cache_write_slot();
+    k_mutex_unlock(&cache.lock);
+
+    return slot;
+}
+
+/**
+ * @brief Publish the slot obtained from mem_cache_reserve().
+ */
+void mem_cache_commit_push(void)
+{
+    k_mutex_lock(&cache.lock, K_FOREVER);
+    cache.count++;
+    k_mutex_unlock(&cache.lock);
+}
+
+/**
+ * @brief Get a pointer to the oldest sample without removing it.
+ *
+ * The slot is not reused by the producer until committed, so it can be
+ * read without holding the lock.
+ *
+ * @param sample Set to the oldest sample in the cache.
+ * @return true if a sample is available, false if the cache is empty.
+ */
+bool mem_cache_peek(const sensor_sample_t **sample)
+{
+    return mem_cache_peek_at(0, sample);
+}
+
+/**
+ * @brief Release the sample obtained from mem_cache_peek().
+ */
+void mem_cache_commit_pop(void)
+{
+    mem_cache_commit_pop_n(1);
+}
+
+/**
+ * @brief Get a pointer to the @p idx-th oldest sample without removing it.
+ *
+ * @param idx    Position from the head of the FIFO.
+ * @param sample Set to the requested sample.
+ * @return true if the sample exists, false if @p idx is past the newest sample.
+ */
+bool mem_cache_peek_at(size_t idx, const sensor_sample_t **sample)
+{
+    bool available;
+
+    k_mutex_lock(&cache.lock, K_FOREVER);
+    available = (idx < cache.count);
+    if (available) {
+        *sample = cache_slot(idx);
+    }
+    k_mutex_unlock(&cache.lock);
+
+    return available;
+}
+
+/**
+ * @brief Get the current count of samples in the cache.
+ *
+ * @return The number of samples currently stored in the cache.
+ */
+size_t mem_cache_count(void)
+{
+    k_mutex_lock(&cache.lock, K_FOREVER);
+    size_t c = cache.count;
+    k_mutex_unlock(&cache.lock);
+    return c;
+}
+
+/**
+ * @brief Keep the oldest samples in place while reading them.
+ */
+void mem_cache_pin(void)
+{
+    k_mutex_lock(&cache.lock, K_FOREVER);
+    cache.pins++;
+    k_mutex_unlock(&cache.lock);
+}
+
+/**
+ * @brief Release a pin taken with mem_cache_pin().
+ */
+void mem_cache_unpin(void)
+{
+    k_mutex_lock(&cache.lock, K_FOREVER);
+    cache.pins--;
+    k_mutex_unlock(&cache.lock);
+}
+
+/**
+ * @brief Get the overflow counters.
+ *
+ * @param stats Filled with the current counters.
+ */
+void mem_cache_get_stats(mem_cache_stats_t *stats)
+{
+    k_mutex_lock(&cache.lock, K_FOREVER);
+    stats->dropped = cache.dropped;
+    stats->decimated = cache.decimated;
+    k_mutex_unlock(&cache.lock);
+}
+
+/**
+ * @brief Change the number of samples the cache may hold.
+ *
+ * Shrinking below the current fill level drops nothing: new samples are
+ * treated as overflow until the consumer has drained the excess.
+ *
+ * @param samples New capacity.
+ * @return 0 on success, or -EINVAL if @p samples is outside
+ *         [mem_cache_capacity_min(), mem_cache_capacity_max()].
+ */
+int mem_cache_set_capacity(size_t samples)
+{
+    if (samples < mem_cache_capacity_min() || samples > mem_cache_capacity_max()) {
+        return -EINVAL;
+    }
+
+    k_mutex_lock(&cache.lock, K_FOREVER);
+    cache.capacity = samples;
+    k_mutex_unlock(&cache.lock);
+
+    return 0;
+}
+
+/**
+ * @brief Get the number of samples the cache may hold.
+ *
+ * @return Current capacity.
+ */
+size_t mem_cache_capacity(void)
+{
+    k_mutex_lock(&cache.lock, K_FOREVER);
+    size_t c = cache.capacity;
+    k_mutex_unlock(&cache.lock);
+    return c;
+}
+
+/**
+ * @brief Get the number of pool blocks the cache holds.
+ *
+ * @return Blocks in use and kept in spare.
+ */
+size_t mem_cache_blocks(void)
+{
+    k_mutex_lock(&cache.lock, K_FOREVER);
+    size_t n = cache.held;
+    k_mutex_unlock(&cache.lock);
+    return n;
+}
+
+/**
+ * @brief Take a block from the shared pool.
+ *
+ * @param timeout How long to wait for a block to be freed.
+ * @return The block, MEM_CACHE_POOL_BLOCK_LEN bytes, or NULL on timeout.
+ */
+void *mem_cache_pool_alloc(k_timeout_t timeout)
+{
+    void *block;
+
+    return k_mem_slab_alloc(&cache_pool, &block, timeout) ? NULL : block;
+}
+
+/**
+ * @brief Return a block taken with mem_cache_pool_alloc().
+ *
+ * @param block The block.
+ */
+void mem_cache_pool_free(void *block)
+{
+    k_mem_slab_free(&cache_pool, block);
+}
+
+/**
+ * @brief Initialize the memory cache.
+ *
+ * This function initializes the mutex, takes the blocks the cache always
+ * keeps, and opens it up to its largest capacity.
+ */
+static int mem_cache_init(void)
+{
+    void *block;
+
+    memset(&cache, 0, sizeof(cache));
+    k_mutex_init(&cache.lock);
+    cache.capacity = mem_cache_capacity_max();
+
+    while (cache.held < CONFIG_CACHE_MIN_BLOCKS &&
+           k_mem_slab_alloc(&cache_pool, &block, K_NO_WAIT) == 0) {
+        cache.spare[cache.spare_n++] = block;
+        cache.held++;
+    }
+
+    return 0;
+}
+
+SYS_INIT(mem_cache_init, POST_KERNEL, CONFIG_KERNEL_INIT_PRIORITY_DEVICE);
@@ -0,0 +1,427 @@
+#include <zephyr/kernel.h>
+#include <zephyr/init.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/util.h>
+#if defined(CONFIG_PROFILE_TRACE)
+#include <zephyr/tracing/tracing.h>
+#endif /* CONFIG_PROFILE_TRACE */
+
+#include "profile.h"
+
+LOG_MODULE_REGISTER(profile, LOG_LEVEL_INF);
+
+
+/******************************************************************************
+ * Macro
+ ******************************************************************************/
+
+/* Histograms are log-linear in microseconds: exact below PROFILE_LINEAR,
+ * then 2^PROFILE_SUB_BITS buckets per power of two, so a percentile read
+ * from a bucket bound is at most 25% high */
+#define PROFILE_SUB_BITS 2
+#define PROFILE_LINEAR (2U << PROFILE_SUB_BITS)
+#define PROFILE_BUCKETS (PROFILE_LINEAR + (32 - PROFILE_SUB_BITS - 1) * (1U << PROFILE_SUB_BITS))
+
+#define PROFILE_STAMP_MASK (CONFIG_PROFILE_STAMPS - 1)
+
+BUILD_ASSERT(IS_POWER_OF_TWO(CONFIG_PROFILE_STAMPS), "CONFIG_PROFILE_STAMPS must be a power of two");
+
+
+/******************************************************************************
+ * Data Types
+ ******************************************************************************/
+
+/* Start of the queued span of one cached sample */
+typedef struct {
+    uint32_t seq;      /* Sample it belongs to */
+    uint32_t cycles;   /* When it was pushed */
+} profile_stamp_t;
+
+/* Link spans of one connection, in queueing order */
+typedef struct {
+    uint32_t cycles[CONFIG_TX_ENGINE_CREDITS];   /* When each notification was queued */
+    size_t head;                                 /* Slot of the oldest one */
+    size_t n;                                    /* Notifications in flight */
+} profile_link_t;
+
+typedef struct {
+    atomic_t pending;                                     /* A trigger is stamped */
+    atomic_t trigger;                                     /* Cycle count of that trigger */
+    atomic_t hist[PROFILE_STAGE_COUNT][PROFILE_BUCKETS];  /* Span histograms, this window */
+    atomic_t max[PROFILE_STAGE_COUNT];                    /* Longest span in us, this window */
+    struct k_spinlock lock;                               /* Protects everything below */
+    profile_stamp_t stamps[CONFIG_PROFILE_STAMPS];        /* Queued span starts, by seq */
+    profile_link_t link[CONFIG_BT_MAX_CONN];              /* Link span starts, by connection */
+    uint64_t busy[PROFILE_CPU_COUNT];                     /* CPU cycles since boot */
+    struct k_work_delayable report;                       /* Periodic report */
+    int64_t window_start;                                 /* Uptime in ms the window opened */
+    uint64_t window_busy[PROFILE_CPU_COUNT];              /* busy when it opened */
+} profile_t;
+
+
+/******************************************************************************
+ * Static Variables
+ ******************************************************************************/
+
+static profile_t prof;
+
+static const char *const stage_name[PROFILE_STAGE_COUNT] = {
+    "acquire", "queued", "link",
+};
+
+static const char *const cpu_name[PROFILE_CPU_COUNT] = {
+    "sampler", "tx", "flash",
+};
+
+
+/******************************************************************************
+ * Histograms
+ ******************************************************************************/
+
+/**
+ * @brief Find the bucket of a span.
+ *
+ * @param us Span in microseconds.
+ * @return Bucket index.
+ */
+static size_t profile_bucket(uint32_t us)
+{
+    if (us < PROFILE_LINEAR) {
+        return us;
+    }
+
+    unsigned int msb = 31 - __builtin_clz(us);
+    unsigned int shift = msb - PROFILE_SUB_BITS;
+
+    return PROFILE_LINEAR + (msb - PROFILE_SUB_BITS - 1) * (1U << PROFILE_SUB_BITS) +
+           ((us >> shift) & ((1U << PROFILE_SUB_BITS) - 1));
+}
+
+/**
+ * @brief Get the largest span a bucket counts.
+ *
+ * @param bucket Bucket index.
+ * @return Upper bound in microseconds.
+ */
+static uint32_t profile_bucket_max(size_t bucket)
+{
+    if (bucket < PROFILE_LINEAR) {
+        return bucket;
+    }
+
+    size_t log = bucket - PROFILE_LINEAR;
+    unsigned int shift = log >> PROFILE_SUB_BITS;
+    uint64_t low = (uint64_t)((1U << PROFILE_SUB_BITS) + (log & ((1U << PROFILE_SUB_BITS) - 1)))
+                   << (shift + 1);
+
+    return (uint32_t)MIN(low + (1ULL << (shift + 1)) - 1, UINT32_MAX);
+}
+
+/**
+ * @brief Add spans of equal length to a stage.
+ *
+ * @param stage  PROFILE_STAGE_* stage.
+ * @param cycles Span in k_cycle_get_32() cycles.
+ * @param n      Number of spans.
+ * @param tag    Sequence number or connection index, for the trace.
+ */
+static void profile_add(int stage, uint32_t cycles, size_t n, uint32_t tag)
+{
+    uint32_t us = k_cyc_to_us_floor32(cycles);
+    atomic_val_t max = atomic_get(&prof.max[stage]);
+
+    atomic_add(&prof.hist[stage][profile_bucket(us)], (atomic_val_t)n);
+    while ((uint32_t)max < us && !atomic_cas(&prof.max[stage], max, (atomic_val_t)us)) {
+        max = atomic_get(&prof.max[stage]);
+    }
+
+#if defined(CONFIG_PROFILE_TRACE)
+    sys_trace_named_event(stage_name[stage], tag, cycles);
+#else
+    ARG_UNUSED(tag);
+#endif /* CONFIG_PROFILE_TRACE */
+}
+
+/**
+ * @brief Log the percentiles of a stage and restart its histogram.
+ *
+ * @param stage PROFILE_STAGE_* stage.
+ */
+static void profile_report_stage(int stage)
+{
+    static uint32_t count[PROFILE_BUCKETS];
+    uint32_t total = 0;
+
+    for (size_t b = 0; b < PROFILE_BUCKETS; b++) {
+        count[b] = (uint32_t)atomic_clear(&prof.hist[stage][b]);
+        total += count[b];
+    }
+
+    uint32_t max = (uint32_t)atomic_clear(&prof.max[stage]);
+
+    if (total == 0) {
+        LOG_INF("%-8s no samples", stage_name[stage]);
+        return;
+    }
+
+    /* Ranks of the 50th and 99th percentile, rounded up */
+    uint32_t rank50 = (uint32_t)DIV_ROUND_UP((uint64_t)total * 50, 100);
+    uint32_t rank99 = (uint32_t)DIV_ROUND_UP((uint64_t)total * 99, 100);
+    uint32_t p50 = 0;
+    uint32_t p99 = 0;
+    uint32_t seen = 0;
+
+    for (size_t b = 0; b < PROFILE_BUCKETS && seen < rank99; b++) {
+        seen += count[b];
+        if (p50 == 0 && seen >= rank50) {
+            p50 = MIN(profile_bucket_max(b), max);
+        }
+        if (seen >= rank99) {
+            p99 = MIN(profile_bucket_max(b), max);
+        }
+    }
+
+    LOG_INF("%-8s n %u p50 %u us p99 %u us max %u us", stage_name[stage], total, p50, p99, max);
+
+#if defined(CONFIG_PROFILE_TRACE)
+    sys_trace_named_event(stage_name[stage], p50, p99);
+#endif /* CONFIG_PROFILE_TRACE */
+}
+
+/**
+ * @brief Periodic report of the stage latencies and CPU load.
+ *
+ * Every report covers the time since the previous one.
+ *
+ * @param work Pointer to the work item.
+ */
+static void profile_report_handler(struct k_work *work)
+{
+    uint64_t busy[PROFILE_CPU_COUNT];
+
+    k_spinlock_key_t key = k_spin_lock(&prof.lock);
+    int64_t now = k_uptime_get();
+    int64_t elapsed_ms = MAX(now - prof.window_start, 1);
+
+    for (int s = 0; s < PROFILE_CPU_COUNT; s++) {
+        busy[s] = prof.busy[s] - prof.window_busy[s];
+        prof.window_busy[s] = prof.busy[s];
+    }
+    prof.window_start = now;
+
+    k_spin_unlock(&prof.lock, key);
+
+    for (int stage = 0; stage < PROFILE_STAGE_COUNT; stage++) {
+        profile_report_stage(stage);
+    }
+
+    for (int s = 0; s < PROFILE_CPU_COUNT; s++) {
+        uint64_t us = k_cyc_to_us_floor64(busy[s]);
+        /* Load in 0.1% steps */
+        uint32_t permille = (uint32_t)MIN(us / (uint64_t)elapsed_ms, 1000);
+
+        LOG_INF("cpu %-8s %u us in %u ms (%u.%u%%)", cpu_name[s], (uint32_t)us,
+                (uint32_t)elapsed_ms, permille / 10, permille % 10);
+    }
+
+    k_work_schedule(&prof.report, K_MSEC(CONFIG_PROFILE_REPORT_INTERVAL_MS));
+}
+
+
+/******************************************************************************
+ * Public API
+ ******************************************************************************/
+
+/**
+ * @brief Stamp a sampler trigger.
+ */
+void profile_trigger(void)
+{
+    uint32_t now = k_cycle_get_32();
+
+    if (atomic_cas(&prof.pending, 0, 1)) {
+        atomic_set(&prof.trigger, (atomic_val_t)now);
+    }
+}
+
+/**
+ * @brief Take the stamp of the trigger that woke the sampling thread.
+ *
+ * A trigger arriving while the thread drains is stamped for its next
+ * wakeup.
+ *
+ * @return Cycle count of the trigger, or the current one if none was stamped.
+ */
+uint32_t profile_wakeup(void)
+{
+    uint32_t trigger = (uint32_t)atomic_get(&prof.trigger);
+
+    if (!atomic_clear(&prof.pending)) {
+        return k_cycle_get_32();
+    }
+
+    return trigger;
+}
+
+/**
+ * @brief Stamp samples that were just pushed into the cache.
+ *
+ * @param trigger Stamp from profile_wakeup().
+ * @param samples The samples, with their sequence numbers assigned.
+ * @param n       Number of samples.
+ */
+void profile_stored(uint32_t trigger, const sensor_sample_t *samples, size_t n)
+{
+    uint32_t now = k_cycle_get_32();
+
+    if (n == 0) {
+        return;
+    }
+
+    /* The burst was read in one go, all its samples share the span */
+    profile_add(PROFILE_STAGE_ACQUIRE, now - trigger, n, samples[0].hdr.seq);
+
+    k_spinlock_key_t key = k_spin_lock(&prof.lock);
+
+    for (size_t i = 0; i < n; i++) {
+        profile_stamp_t *stamp = &prof.stamps[samples[i].hdr.seq & PROFILE_STAMP_MASK];
+
+        stamp->seq = samples[i].hdr.seq;
+        stamp->cycles = now;
+    }
+
+    k_spin_unlock(&prof.lock, key);
+}
+
+/**
+ * @brief End the queued span of a sample handed to the stack.
+ *
+ * @param seq Sequence number of the sample.
+ */
+void profile_queued(uint32_t seq)
+{
+    const profile_stamp_t *stamp = &prof.stamps[seq & PROFILE_STAMP_MASK];
+    uint32_t now = k_cycle_get_32();
+
+    k_spinlock_key_t key = k_spin_lock(&prof.lock);
+    bool tracked = (stamp->seq == seq);
+    uint32_t pushed = stamp->cycles;
+
+    k_spin_unlock(&prof.lock, key);
+
+    if (tracked) {
+        profile_add(PROFILE_STAGE_QUEUED, now - pushed, 1, seq);
+    }
+}
+
+/**
+ * @brief Start the link span of a notification about to be queued.
+ *
+ * @param slot Connection index.
+ */
+void profile_link_begin(uint8_t slot)
+{
+    profile_link_t *link = &prof.link[slot];
+
+    k_spinlock_key_t key = k_spin_lock(&prof.lock);
+
+    if (link->n < ARRAY_SIZE(link->cycles)) {
+        link->cycles[(link->head + link->n) % ARRAY_SIZE(link->cycles)] = k_cycle_get_32();
+        link->n++;
+    }
+
+    k_spin_unlock(&prof.lock, key);
+}
+
+/**
+ * @brief Forget the span started last, its notification was not queued.
+ *
+ * @param slot Connection index.
+ */
+void profile_link_cancel(uint8_t slot)
+{
+    profile_link_t *link = &prof.link[slot];
+
+    k_spinlock_key_t key = k_spin_lock(&prof.lock);
+
+    if (link->n) {
+        link->n--;
+    }
+
+    k_spin_unlock(&prof.lock, key);
+}
+
+/**
+ * @brief End the link span of the oldest notification in flight.
+ *
+ * @param slot Connection index.
+ */
+void profile_link_end(uint8_t slot)
+{
+    profile_link_t *link = &prof.link[slot];
+    uint32_t now = k_cycle_get_32();
+    uint32_t queued;
+
+    k_spinlock_key_t key = k_spin_lock(&prof.lock);
+    bool tracked = (link->n != 0);
+
+    if (tracked) {
+        queued = link->cycles[link->head];
+        link->head = (link->head + 1) % ARRAY_SIZE(link->cycles);
+        link->n--;
+    }
+
+    k_spin_unlock(&prof.lock, key);
+
+    if (tracked) {
+        profile_add(PROFILE_STAGE_LINK, now - queued, 1, slot);
+    }
+}
+
+/**
+ * @brief Forget all spans of a connection, for a new subscription.
+ *
+ * @param slot Connection index.
+ */
+void profile_link_reset(uint8_t slot)
+{
+    k_spinlock_key_t key = k_spin_lock(&prof.lock);
+
+    prof.link[slot].n = 0;
+
+    k_spin_unlock(&prof.lock, key);
+}
+
+/**
+ * @brief Account CPU time to a subsystem.
+ *
+ * @param subsys PROFILE_CPU_* subsystem.
+ * @param cycles Time it was busy in k_cycle_get_32() cycles.
+ */
+void profile_cpu(int subsys, uint32_t cycles)
+{
+    k_spinlock_key_t key = k_spin_lock(&prof.lock);
+
+    prof.busy[subsys] += cycles;
+
+    k_spin_unlock(&prof.lock, key);
+}
+
+/**
+ * @brief Initialize the profiler and schedule the first report.
+ *
+ * It is automatically executed during the application initialization phase.
+ *
+ * @return 0 on successful initialization.
+ */
+static int profile_init(void)
+{
+    prof.window_start = k_uptime_get();
+    k_work_init_delayable(&prof.report, profile_report_handler);
+    k_work_schedule(&prof.report, K_MSEC(CONFIG_PROFILE_REPORT_INTERVAL_MS));
+
+    return 0;
+}
+
+SYS_INIT(profile_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -0,0 +1,398 @@
+#include <math.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/init.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+
+#include "aggregate.h"
+#include "float16.h"
+#include "imu_codec.h"
+#include "mem_cache.h"
+#include "profile.h"
+#include "sampler.h"
+#include "sensor_fifo.h"
+#include "telemetry.h"
+#include "tx_engine.h"
+
+LOG_MODULE_REGISTER(sampler, LOG_LEVEL_INF);
+
+
+/******************************************************************************
+ * Data Types
+ ******************************************************************************/
+
+typedef struct {
+    struct k_sem trigger;                         /* Given by the timer or a sensor interrupt */
+#if defined(CONFIG_SAMPLER_TIMER)
+    struct k_timer timer;                         /* Periodic FIFO poll */
+#endif /* CONFIG_SAMPLER_TIMER */
+    atomic_t interval;                            /* Requested sample interval in us */
+    uint32_t configured;                          /* Interval the sensor runs at, thread only */
+    uint32_t seq;                                 /* Sequence number of the next sample */
+#if defined(CONFIG_AGGREGATE)
+    uint32_t record_seq;                          /* Sequence number of the next record stored */
+#endif /* CONFIG_AGGREGATE */
+    sensor_sample_t burst[CONFIG_SAMPLER_BURST];  /* Samples of the current FIFO read */
+    struct k_spinlock latest_lock;                /* Protects latest and have_latest */
+    sensor_sample_t latest;                       /* Newest sample read */
+    bool have_latest;                             /* latest is valid */
+#if defined(CONFIG_IMU_CODEC_CACHE)
+    imu_codec_t codec;                            /* Encoder state for the records stored in the cache */
+#endif /* CONFIG_IMU_CODEC_CACHE */
+#if defined(CONFIG_MEM_CACHE_ALERT)
+    bool alert_raised;                            /* Over-temperature alert active, thread only */
+#endif /* CONFIG_MEM_CACHE_ALERT */
+} sampler_t;
+
+
+/******************************************************************************
+ * Macro
+ ******************************************************************************/
+
+#if defined(CONFIG_MEM_CACHE_ALERT)
+/* Alert thresholds in degC */
+#define SAMPLER_ALERT_RAISE (CONFIG_MEM_CACHE_ALERT_TEMP / 100.0f)
+#define SAMPLER_ALERT_CLEAR \
+    ((CONFIG_MEM_CACHE_ALERT_TEMP - CONFIG_MEM_CACHE_ALERT_HYSTERESIS) / 100.0f)
+#endif /* CONFIG_MEM_CACHE_ALERT */
+
+
+/******************************************************************************
+ * Static Variables
+ ******************************************************************************/
+
+static sampler_t sampler;
+
+
+/******************************************************************************
+ * Sampling thread
+ ******************************************************************************/
+
+/**
+ * @brief Store a burst of samples in the cache.
+ *
+ * With CONFIG_IMU_CODEC_CACHE every sample is delta-encoded into a reserved
+ * arena record; otherwise the burst goes in with one mem_cache_push_n().
+ *
+ * @param n Number of samples in the burst buffer.
+ * @return Number of samples the cache accepted.
+ */
+static size_t sampler_store(size_t n)
+{
+#if defined(CONFIG_IMU_CODEC_CACHE)
+    size_t stored = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        uint8_t *rec = mem_cache_reserve_record(IMU_CODEC_MAX_LEN);
+
+        if (!rec) {
+            /* Encoder state is untouched, the next delta stays valid */
+            continue;
+        }
+
+        mem_cache_commit_push_record(imu_codec_encode(&sampler.codec, &sampler.burst[i],
+                                                      rec, IMU_CODEC_MAX_LEN));
+        stored++;
+    }
+
+    return stored;
+#else
+    return mem_cache_push_n(sampler.burst, n);
+#endif /* CONFIG_IMU_CODEC_CACHE */
+}
+
+/**
+ * @brief Keep a copy of the newest sample of a burst.
+ *
+ * @param n Number of samples in the burst buffer, at least 1.
+ */
+static void sampler_keep_latest(size_t n)
+{
+    k_spinlock_key_t key = k_spin_lock(&sampler.latest_lock);
+
+    memcpy(&sampler.latest, &sampler.burst[n - 1], sizeof(sampler.latest));
+    sampler.have_latest = true;
+
+    k_spin_unlock(&sampler.latest_lock, key);
+}
+
+#if defined(CONFIG_MEM_CACHE_ALERT)
+/**
+ * @brief Route over-temperature samples of a burst to the alert stream.
+ *
+ * The first sample at or above the threshold raises the alert and is
+ * queued; the alert only re-arms once every reading of a sample is below
+ * the threshold minus the hysteresis. NaN readings are ignored. A queued
+ * alert kicks the TX engine right away instead of waiting for the next
+ * transmit tick.
+ *
+ * @param n Number of samples in the burst buffer.
+ */
+static void sampler_check_alerts(size_t n)
+{
+    bool queued = false;
+
+    for (size_t i = 0; i < n; i++) {
+        const sensor_sample_t *sample = &sampler.burst[i];
+        bool valid = false;
+        float hottest = 0.0f;
+
+        for (int t = 0; t < TEMP_SAMPLE_LEN; t++) {
+#if defined(CONFIG_SAMPLE_FORMAT_COMPACT)
+            float temp = float16_to_float(sample->temp[t]);
+#else
+            float temp = (float)sample->temp[t];
+#endif /* CONFIG_SAMPLE_FORMAT_COMPACT */
+
+            if (!isnan(temp) && (!valid || temp > hottest)) {
+                hottest = temp;
+                valid = true;
+            }
+        }
+
+        if (!valid) {
+            continue;
+        }
+        if (!sampler.alert_raised && hottest >= SAMPLER_ALERT_RAISE) {
+            sampler.alert_raised = true;
+            /* A full alert ring drops its oldest entry */
+            mem_cache_alert_push(sample);
+            queued = true;
+        } else if (sampler.alert_raised && hottest < SAMPLER_ALERT_CLEAR) {
+            sampler.alert_raised = false;
+        }
+    }
+
+    if (queued) {
+        tx_engine_kick();
+    }
+}
+#endif /* CONFIG_MEM_CACHE_ALERT */
+
+/**
+ * @brief Drain the sensor FIFO into the cache.
+ *
+ * Reads bursts of up to CONFIG_SAMPLER_BURST samples until the FIFO comes
+ * back short, numbering every sample on the way. Nothing is logged here;
+ * losses show up in the telemetry counters.
+ */
+static void sampler_drain(void)
+{
+    uint32_t start = k_cycle_get_32();
+    int n;
+#if defined(CONFIG_PROFILE)
+    uint32_t trigger = profile_wakeup();
+#endif /* CONFIG_PROFILE */
+
+    do {
+        n = sensor_fifo_read(sampler.burst, ARRAY_SIZE(sampler.burst));
+        if (n < 0) {
+            LOG_ERR("Sensor FIFO read failed (err %d)", n);
+            return;
+        }
+
+        for (int i = 0; i < n; i++) {
+            sampler.burst[i].hdr.seq = sampler.seq++;
+        }
+        if (n > 0) {
+            sampler_keep_latest(n);
+        }
+#if defined(CONFIG_MEM_CACHE_ALERT)
+        /* Before aggregation, alerts carry the raw sample */
+        sampler_check_alerts(n);
+#endif /* CONFIG_MEM_CACHE_ALERT */
+
+#if defined(CONFIG_AGGREGATE)
+        /*
+         * Summary mode swaps the burst for the windows it completed. The
+         * records are renumbered so the data stream has no gaps in any
+         * mode; alerts and the latest reading keep the sample numbers.
+         */
+        size_t records = aggregate_feed(sampler.burst, n, sampler.record_seq);
+
+        sampler.record_seq += records;
+#else
+        size_t records = n;
+#endif /* CONFIG_AGGREGATE */
+
+        /* Rejected samples are counted by the cache */
+        sampler_store(records);
+#if defined(CONFIG_PROFILE)
+        profile_stored(trigger, sampler.burst, records);
+#endif /* CONFIG_PROFILE */
+        telemetry_produced(n);
+        telemetry_cache_level(mem_cache_count());
+    } while (n == ARRAY_SIZE(sampler.burst));
+
+    uint32_t cycles = k_cycle_get_32() - start;
+
+    telemetry_cycles(TELEMETRY_HIST_SAMPLE, cycles);
+#if defined(CONFIG_PROFILE)
+    profile_cpu(PROFILE_CPU_SAMPLER, cycles);
+#endif /* CONFIG_PROFILE */
+
+#if defined(CONFIG_TX_BATCHING) && !defined(CONFIG_TX_SYNC_CONN_EVENT)
+    /* A full batch may be ready before the next transmit tick */
+    tx_engine_kick();
+#elif defined(CONFIG_FLASH_TIER)
+    /* The engine spills to flash even while nobody is subscribed */
+    if (mem_cache_count() >= CONFIG_FLASH_TIER_SPILL_THRESHOLD) {
+        tx_engine_kick();
+    }
+#endif /* CONFIG_TX_BATCHING && !CONFIG_TX_SYNC_CONN_EVENT */
+}
+
+/**
+ * @brief Apply a pending sample interval change.
+ *
+ * Runs after the FIFO has been drained, so every cached sample carries a
+ * timestamp from the rate it was taken at.
+ */
+static void sampler_reconfigure(void)
+{
+    uint32_t interval = atomic_get(&sampler.interval);
+
+    if (interval == sampler.configured) {
+        return;
+    }
+
+    int err = sensor_fifo_configure(interval);
+    if (err) {
+        LOG_ERR("Sensor rate change failed (err %d)", err);
+        atomic_set(&sampler.interval, sampler.configured);
+        return;
+    }
+    sampler.configured = interval;
+
+#if defined(CONFIG_SAMPLER_TIMER)
+    k_timeout_t period = K_USEC((uint64_t)interval * CONFIG_SAMPLER_WATERMARK);
+
+    k_timer_start(&sampler.timer, period, period);
+#endif /* CONFIG_SAMPLER_TIMER */
+
+    LOG_INF("Sample interval %u us", interval);
+}
+
+/**
+ * @brief Sampling thread.
+ *
+ * Sleeps until triggered, then drains the sensor FIFO. All bus traffic
+ * and sample conversion happens here instead of in interrupt context.
+ */
+static void sampler_thread(void *p1, void *p2, void *p3)
+{
+    while (1) {
+        k_sem_take(&sampler.trigger, K_FOREVER);
+        sampler_drain();
+        sampler_reconfigure();
+    }
+}
+
+K_THREAD_DEFINE(sampler_tid, CONFIG_SAMPLER_STACK_SIZE, sampler_thread,
+                NULL, NULL, NULL, CONFIG_SAMPLER_PRIORITY, 0, 0);
+
+#if defined(CONFIG_SAMPLER_TIMER)
+/**
+ * @brief Periodic timer callback, only wakes the sampling thread.
+ *
+ * @param timer Pointer to the kernel timer that triggered the callback.
+ */
+static void sampler_timer_handler(struct k_timer *timer)
+{
+    sampler_trigger();
+}
+#endif /* CONFIG_SAMPLER_TIMER */
+
+
+/******************************************************************************
+ * Public API
+ ******************************************************************************/
+
+/**
+ * @brief Wake the sampling thread to drain the sensor FIFO.
+ */
+void sampler_trigger(void)
+{
+#if defined(CONFIG_PROFILE)
+    profile_trigger();
+#endif /* CONFIG_PROFILE */
+    k_sem_give(&sampler.trigger);
+}
+
+/**
+ * @brief Change the sensor sampling interval.
+ *
+ * @param interval_us New interval in microseconds.
+ * @return 0 on success, or -EINVAL if the interval is out of range.
+ */
+int sampler_set_interval(uint32_t interval_us)
+{
+    if (interval_us < SAMPLER_INTERVAL_MIN_US || interval_us > SAMPLER_INTERVAL_MAX_US) {
+        return -EINVAL;
+    }
+
+    atomic_set(&sampler.interval, (atomic_val_t)interval_us);
+    sampler_trigger();
+
+    return 0;
+}
+
+/**
+ * @brief Get the sensor sampling interval.
+ *
+ * @return Interval in microseconds.
+ */
+uint32_t sampler_get_interval(void)
+{
+    return (uint32_t)atomic_get(&sampler.interval);
+}
+
+/**
+ * @brief Get the most recently read sample.
+ *
+ * @param out Filled with a copy of the sample.
+ * @return true on success, false if nothing has been read yet.
+ */
+bool sampler_get_latest(sensor_sample_t *out)
+{
+    k_spinlock_key_t key = k_spin_lock(&sampler.latest_lock);
+    bool valid = sampler.have_latest;
+
+    if (valid) {
+        memcpy(out, &sampler.latest, sizeof(*out));
+    }
+
+    k_spin_unlock(&sampler.latest_lock, key);
+    return valid;
+}
+
+/**
+ * @brief Initialize the sampler.
+ *
+ * Starts the FIFO poll timer with CONFIG_SAMPLER_TIMER. It is
+ * automatically executed during the application initialization phase.
+ *
+ * @return 0 on successful initialization.
+ */
+static int sampler_init(void)
+{
+    k_sem_init(&sampler.trigger, 0, 1);
+    atomic_set(&sampler.interval, CONFIG_SAMPLE_INTERVAL_US);
+    sampler.configured = CONFIG_SAMPLE_INTERVAL_US;
+#if defined(CONFIG_IMU_CODEC_CACHE)
+    imu_codec_reset(&sampler.codec);
+#endif /* CONFIG_IMU_CODEC_CACHE */
+
+#if defined(CONFIG_SAMPLER_TIMER)
+    k_timer_init(&sampler.timer, sampler_timer_handler, NULL);
+    k_timer_start(&sampler.timer,
+                  K_USEC((uint64_t)CONFIG_SAMPLE_INTERVAL_US * CONFIG_SAMPLER_WATERMARK),
+                  K_USEC((uint64_t)CONFIG_SAMPLE_INTERVAL_US * CONFIG_SAMPLER_WATERMARK));
+#endif /* CONFIG_SAMPLER_TIMER */
+
+    LOG_INF("Sampler initialized (burst %d)", CONFIG_SAMPLER_BURST);
+    return 0;
+}
+
+SYS_INIT(sampler_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -2,8 +2,10 @@
 #include <zephyr/random/random.h>
 #include <zephyr/logging/log.h>
 #include <zephyr/init.h>
-#include <math.h>
+#include "float16.h"
 #include "mem_cache.h"
+#include "sensor_fifo.h"
+#include "telemetry.h"
 #include <stdlib.h>
 
 LOG_MODULE_REGISTER(sensor_mock, LOG_LEVEL_INF);
@@ -11,95 +13,146 @@ LOG_MODULE_REGISTER(sensor_mock, LOG_LEVEL_INF);
 
 #define UINT16_TO_DOUBLE_SCALABLE 0
 
+/* Mock IMU readings span a 12-bit range like the real sensor */
+#define IMU_RAW_MASK 0x0FFF
+
 #if UINT16_TO_DOUBLE_SCALABLE
 #define TEMP_MIN  (-60)
 #define TEMP_MAX  (120)
 #endif /* UINT16_TO_DOUBLE_SCALABLE */
 
 
-static struct k_timer sample_timer;
+/* Output data rate of the mock sensor in microseconds */
+static uint32_t fifo_period_us = CONFIG_SAMPLE_INTERVAL_US;
+
+/* Uptime in microseconds at which the next emulated FIFO entry is due */
+static uint64_t fifo_next_us;
 
+#if UINT16_TO_DOUBLE_SCALABLE
 /**
- * @brief Convert 16-bit unsigned value to double-precision value.
+ * @brief Scale a 16-bit unsigned value linearly into the temperature range.
  * @param u16 Raw 16-bit raw value.
- * @return Converted value as double-precision floating point.
+ * @return Temperature between TEMP_MIN and TEMP_MAX.
  */
-static double uint16_to_double(uint16_t u16)
+static sample_temp_t uint16_to_temp(uint16_t u16)
 {
-#if UINT16_TO_DOUBLE_SCALABLE
     double normalized = (double)u16 / 65535.0;
     return TEMP_MIN + (normalized * (TEMP_MAX - TEMP_MIN));
+}
+#endif /* UINT16_TO_DOUBLE_SCALABLE */
+
+/**
+ * @brief Fill a sample with mock IMU and temperature data.
+ *
+ * @param sample    Sample to fill.
+ * @param timestamp Uptime in milliseconds the sample was taken at.
+ */
+static void sample_generate(sensor_sample_t *sample, uint32_t timestamp)
+{
+    sample->hdr.timestamp = timestamp;
+
+    /* Generate IMU data */
+    for (int i = 0; i < IMU_SAMPLE_LEN; i++) {
+        /* Using rand() since sys_rand32_get is not supported by my board */
+#if defined(CONFIG_SAMPLE_FORMAT_COMPACT)
+        sample->imu[i] = rand() & IMU_RAW_MASK;
 #else
-/*
-double 16 bit:
-     S | EEEEE | MMMMMMMMMM
-    15 | 14 10 | 9        0
- 
-double 64 bit:
-     S | EEEEEEEEEEE | MMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMMM
-    63 | 62       52 | 51                                                 0
-*/
-    uint16_t sign = (u16 >> 15) & 0x1;  /* Bit 15: sign (0 = positive, 1 = negative) */
-    uint16_t exp  = (u16 >> 10) & 0x1F; /* Bits 10–14: exponent (5 bits) */
-    uint16_t mant = u16 & 0x03FF;       /* Bits 0–9: mantissa (10 bits) */
-
-    /* Case 1: subnormal numbers (exponent == 0) */
-    if (exp == 0) {
-        /* Value = fraction × 2^(-24) */
-        double value = ldexp((double)mant, -24);
-        return sign ? -value : value;
+        sample->imu[i] = rand();
+#endif /* CONFIG_SAMPLE_FORMAT_COMPACT */
     }
 
-    /* Case 2: infinity or NaN (exponent == 31) */
-    if (exp == 31) {
-        return mant ? NAN : (sign ? -INFINITY : INFINITY);
+    /* Generate float16 temperature samples */
+#if defined(CONFIG_SAMPLE_FORMAT_COMPACT)
+    /* Compact format keeps the raw binary16 bits */
+    for (int i = 0; i < TEMP_SAMPLE_LEN; i++) {
+        sample->temp[i] = rand();
     }
+#else
+    uint16_t raw[TEMP_SAMPLE_LEN];
 
-    /* Case 3: normalized numbers */
-    /* Value = (1 + fraction/1024) × 2^(exp − 15) */
-    double value = ldexp(1.0 + (mant / 1024.0), exp - 15);
-    return sign ? -value : value;
+    for (int i = 0; i < TEMP_SAMPLE_LEN; i++) {
+        raw[i] = rand();
+    }
+
+    /* Widen the whole row in one pass, straight into the aligned sample */
+#if UINT16_TO_DOUBLE_SCALABLE
+    for (int i = 0; i < TEMP_SAMPLE_LEN; i++) {
+        sample->temp[i] = uint16_to_temp(raw[i]);
+    }
+#elif defined(CONFIG_SAMPLE_TEMP_FLOAT)
+    float16_to_float_n(raw, sample->temp, TEMP_SAMPLE_LEN);
+#else
+    float16_to_double_n(raw, sample->temp, TEMP_SAMPLE_LEN);
 #endif /* UINT16_TO_DOUBLE_SCALABLE */
+#endif /* CONFIG_SAMPLE_FORMAT_COMPACT */
 }
 
 /**
- * @brief Timer callback for generating mock sensor samples.
+ * @brief Get the uptime in microseconds.
  *
- * This handler is called periodically by a Zephyr kernel timer.
- * It generates mock IMU and temperature samples and pushes them
- * into the memory cache.
+ * @return Uptime, at tick resolution.
+ */
+static inline uint64_t fifo_now_us(void)
+{
+    return k_ticks_to_us_floor64(k_uptime_ticks());
+}
+
+/**
+ * @brief Read a burst of samples from the emulated sensor FIFO.
  *
- * If the cache is full, the generated sample is dropped and
- * a warning is logged.
+ * The mock produces one entry every fifo_period_us and holds up to
+ * CONFIG_SENSOR_MOCK_FIFO_DEPTH of them; anything older has been
+ * overwritten. Samples are timestamped with the instant they were due, so
+ * reading late adds no jitter.
  *
- * @param timer Pointer to the kernel timer that triggered the callback.
+ * @param out Destination for the samples, oldest first.
+ * @param max Maximum number of samples to read.
+ * @return Number of samples read.
  */
-static void sample_timer_handler(struct k_timer *timer)
+int sensor_fifo_read(sensor_sample_t *out, size_t max)
 {
-    sensor_sample_t sample;
+    uint64_t now = fifo_now_us();
+    uint64_t depth_us = (uint64_t)CONFIG_SENSOR_MOCK_FIFO_DEPTH * fifo_period_us;
+    size_t n = 0;
 
-    /* Generate IMU data */
-    for (int i = 0; i < IMU_SAMPLE_LEN; i++) {
-        /* Using rand() since sys_rand32_get is not supported by my board */
-        sample.imu[i] = rand();
-    }
+    if (now >= fifo_next_us + depth_us) {
+        uint64_t lost = (now - fifo_next_us) / fifo_period_us + 1 - CONFIG_SENSOR_MOCK_FIFO_DEPTH;
 
-    /* Generate float16 temperature samples */
-    for (int i = 0; i < TEMP_SAMPLE_LEN; i++) {
-        uint16_t raw = rand();
-        sample.temp[i] = uint16_to_double(raw);
+        telemetry_fifo_lost(lost);
+        fifo_next_us += lost * fifo_period_us;
     }
 
-    if (!mem_cache_push(&sample)) {
-        LOG_WRN("Sample cache full, dropping sample");
+    while (n < max && now >= fifo_next_us) {
+        /* Sample timestamps stay in milliseconds */
+        sample_generate(&out[n++], (uint32_t)(fifo_next_us / USEC_PER_MSEC));
+        fifo_next_us += fifo_period_us;
     }
+
+    return n;
+}
+
+/**
+ * @brief Set the output data rate of the emulated sensor.
+ *
+ * Like a real IMU changing its ODR, the FIFO restarts empty and the first
+ * sample at the new rate is due one period from now.
+ *
+ * @param interval_us Sample interval in microseconds.
+ * @return 0 on success.
+ */
+int sensor_fifo_configure(uint32_t interval_us)
+{
+    fifo_period_us = interval_us;
+    fifo_next_us = fifo_now_us() + fifo_period_us;
+
+    return 0;
 }
 
 /**
  * @brief Initialize mock sensor module.
  *
- * This function initializes and starts a periodic kernel timer
- * used to generate mock sensor samples.
+ * Seeds the random generator and starts the emulated FIFO; the first
+ * sample is due one period from now.
  *
  * It is automatically executed during the application initialization
  * phase.
@@ -109,10 +162,7 @@ static void sample_timer_handler(struct k_timer *timer)
 static int sensor_mock_init(void)
 {
     srand(k_cycle_get_32());
-    k_timer_init(&sample_timer, sample_timer_handler, NULL);
-    k_timer_start(&sample_timer,
-                  K_SECONDS(CONFIG_SAMPLE_INTERVAL_SEC),
-                  K_SECONDS(CONFIG_SAMPLE_INTERVAL_SEC));
+    fifo_next_us = fifo_now_us() + fifo_period_us;
 
     LOG_INF("Sensor mock initialized");
     return 0;
@@ -0,0 +1,306 @@
+#include <errno.h>
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/util.h>
+#if defined(CONFIG_TELEMETRY_SHELL)
+#include <zephyr/shell/shell.h>
+#endif /* CONFIG_TELEMETRY_SHELL */
+
+#include "mem_cache.h"
+#include "telemetry.h"
+
+
+/******************************************************************************
+ * Data Types
+ ******************************************************************************/
+
+/* Counters are only ever incremented, so producers never take a lock */
+typedef struct {
+    atomic_t produced;                                        /* Samples read from the sensor */
+    atomic_t fifo_lost;                                       /* Samples overwritten in the sensor FIFO */
+    atomic_t sent;                                            /* Samples sent, per connection */
+    atomic_t resent;                                          /* Samples retransmitted */
+    atomic_t bytes_sent;                                      /* Payload bytes sent */
+    atomic_t high_water;                                      /* Highest cache fill level seen */
+    atomic_t notify_err[TELEMETRY_ERR_COUNT];                 /* Failed notifications by code */
+    atomic_t hist[TELEMETRY_HIST_COUNT][TELEMETRY_HIST_BUCKETS];  /* Cycle histograms */
+    struct k_spinlock lock;                                   /* Protects the rate window */
+    int64_t window_start;                                     /* Uptime in ms the rate window opened */
+    uint32_t window_bytes;                                    /* bytes_sent when it opened */
+} telemetry_t;
+
+
+/******************************************************************************
+ * Static Variables
+ ******************************************************************************/
+
+static telemetry_t telemetry;
+
+
+/******************************************************************************
+ * Snapshot
+ ******************************************************************************/
+
+/**
+ * @brief Get all counters in CPU byte order.
+ *
+ * @param info Filled with the current values.
+ */
+static void telemetry_snapshot(telemetry_info_t *info)
+{
+    mem_cache_stats_t cache;
+
+    mem_cache_get_stats(&cache);
+
+    info->produced = (uint32_t)atomic_get(&telemetry.produced);
+    info->fifo_lost = (uint32_t)atomic_get(&telemetry.fifo_lost);
+    info->dropped = cache.dropped;
+    info->decimated = cache.decimated;
+    info->sent = (uint32_t)atomic_get(&telemetry.sent);
+    info->resent = (uint32_t)atomic_get(&telemetry.resent);
+    info->bytes_sent = (uint32_t)atomic_get(&telemetry.bytes_sent);
+    info->cache_count = MIN(mem_cache_count(), UINT16_MAX);
+    info->cache_high_water = MIN((uint32_t)atomic_get(&telemetry.high_water), UINT16_MAX);
+
+    for (int i = 0; i < TELEMETRY_ERR_COUNT; i++) {
+        info->notify_err[i] = (uint32_t)atomic_get(&telemetry.notify_err[i]);
+    }
+
+    for (int h = 0; h < TELEMETRY_HIST_COUNT; h++) {
+        for (int b = 0; b < TELEMETRY_HIST_BUCKETS; b++) {
+            info->hist[h][b] = (uint32_t)atomic_get(&telemetry.hist[h][b]);
+        }
+    }
+
+    /* Average over the time since the previous snapshot */
+    k_spinlock_key_t key = k_spin_lock(&telemetry.lock);
+    int64_t now = k_uptime_get();
+    int64_t elapsed = now - telemetry.window_start;
+
+    info->uptime_ms = (uint32_t)now;
+    info->bytes_per_sec = elapsed > 0 ?
+        (uint32_t)((uint64_t)(info->bytes_sent - telemetry.window_bytes) * MSEC_PER_SEC / elapsed) : 0;
+    telemetry.window_start = now;
+    telemetry.window_bytes = info->bytes_sent;
+
+    k_spin_unlock(&telemetry.lock, key);
+}
+
+
+/******************************************************************************
+ * Shell
+ ******************************************************************************/
+
+#if defined(CONFIG_TELEMETRY_SHELL)
+/**
+ * @brief Print a cycle histogram on one line.
+ *
+ * @param sh     The shell instance.
+ * @param name   Histogram name.
+ * @param bucket Bucket counts.
+ */
+static void telemetry_print_hist(const struct shell *sh, const char *name,
+                                 const uint32_t bucket[TELEMETRY_HIST_BUCKETS])
+{
+    shell_fprintf(sh, SHELL_NORMAL, "%-8s", name);
+    for (int b = 0; b < TELEMETRY_HIST_BUCKETS - 1; b++) {
+        shell_fprintf(sh, SHELL_NORMAL, " <%u:%u", 1U << (CONFIG_TELEMETRY_HIST_SHIFT + b + 1),
+                      bucket[b]);
+    }
+    shell_fprintf(sh, SHELL_NORMAL, " more:%u\n", bucket[TELEMETRY_HIST_BUCKETS - 1]);
+}
+
+/**
+ * @brief Shell command printing all counters.
+ *
+ * @param sh   The shell instance.
+ * @param argc Number of arguments.
+ * @param argv Arguments.
+ * @return 0.
+ */
+static int cmd_cache_stats(const struct shell *sh, size_t argc, char **argv)
+{
+    static const char *const err_name[TELEMETRY_ERR_COUNT] = {
+        "ENOMEM", "ENOTCONN", "EINVAL", "other",
+    };
+    telemetry_info_t info;
+
+    ARG_UNUSED(argc);
+    ARG_UNUSED(argv);
+
+    telemetry_snapshot(&info);
+
+    shell_print(sh, "uptime     %u ms", info.uptime_ms);
+    shell_print(sh, "produced   %u", info.produced);
+    shell_print(sh, "fifo lost  %u", info.fifo_lost);
+    shell_print(sh, "dropped    %u", info.dropped);
+    shell_print(sh, "decimated  %u", info.decimated);
+    shell_print(sh, "sent       %u", info.sent);
+    shell_print(sh, "resent     %u", info.resent);
+    shell_print(sh, "bytes      %u (%u B/s)", info.bytes_sent, info.bytes_per_sec);
+    shell_print(sh, "cached     %u (high water %u)", info.cache_count, info.cache_high_water);
+
+    for (int i = 0; i < TELEMETRY_ERR_COUNT; i++) {
+        shell_print(sh, "notify %-8s %u", err_name[i], info.notify_err[i]);
+    }
+
+    uint32_t hist[TELEMETRY_HIST_BUCKETS];
+
+    memcpy(hist, info.hist[TELEMETRY_HIST_SAMPLE], sizeof(hist));
+    telemetry_print_hist(sh, "sample", hist);
+    memcpy(hist, info.hist[TELEMETRY_HIST_TX], sizeof(hist));
+    telemetry_print_hist(sh, "tx", hist);
+
+    return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_cache,
+    SHELL_CMD(stats, NULL, "Show sample, cache and TX counters", cmd_cache_stats),
+    SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(cache, &sub_cache, "Sample cache commands", NULL);
+#endif /* CONFIG_TELEMETRY_SHELL */
+
+
+/******************************************************************************
+ * Public API
+ ******************************************************************************/
+
+/**
+ * @brief Count samples read from the sensor.
+ *
+ * @param n Number of samples.
+ */
+void telemetry_produced(size_t n)
+{
+    atomic_add(&telemetry.produced, (atomic_val_t)n);
+}
+
+/**
+ * @brief Count samples the sensor overwrote before they were read.
+ *
+ * @param n Number of samples.
+ */
+void telemetry_fifo_lost(size_t n)
+{
+    atomic_add(&telemetry.fifo_lost, (atomic_val_t)n);
+}
+
+/**
+ * @brief Record the cache fill level after a push.
+ *
+ * Only costs a compare unless a new maximum is reached.
+ *
+ * @param count Samples (records) in the cache.
+ */
+void telemetry_cache_level(size_t count)
+{
+    atomic_val_t high = atomic_get(&telemetry.high_water);
+
+    while ((atomic_val_t)count > high &&
+           !atomic_cas(&telemetry.high_water, high, (atomic_val_t)count)) {
+        high = atomic_get(&telemetry.high_water);
+    }
+}
+
+/**
+ * @brief Count samples handed to the stack.
+ *
+ * @param n     Number of samples.
+ * @param bytes Payload length they were sent in.
+ */
+void telemetry_sent(size_t n, size_t bytes)
+{
+    atomic_add(&telemetry.sent, (atomic_val_t)n);
+    atomic_add(&telemetry.bytes_sent, (atomic_val_t)bytes);
+}
+
+/**
+ * @brief Count samples retransmitted on request.
+ *
+ * @param n     Number of samples.
+ * @param bytes Payload length they were sent in.
+ */
+void telemetry_resent(size_t n, size_t bytes)
+{
+    atomic_add(&telemetry.resent, (atomic_val_t)n);
+    atomic_add(&telemetry.bytes_sent, (atomic_val_t)bytes);
+}
+
+/**
+ * @brief Count a failed notification.
+ *
+ * @param err Negative error code from bt_gatt_notify_cb().
+ */
+void telemetry_notify_error(int err)
+{
+    int idx;
+
+    switch (err) {
+    case -ENOMEM:
+        idx = TELEMETRY_ERR_NOMEM;
+        break;
+    case -ENOTCONN:
+        idx = TELEMETRY_ERR_NOTCONN;
+        break;
+    case -EINVAL:
+        idx = TELEMETRY_ERR_INVAL;
+        break;
+    default:
+        idx = TELEMETRY_ERR_OTHER;
+        break;
+    }
+
+    atomic_inc(&telemetry.notify_err[idx]);
+}
+
+/**
+ * @brief Add a call to a cycle histogram.
+ *
+ * @param hist   TELEMETRY_HIST_* histogram.
+ * @param cycles Duration of the call in k_cycle_get_32() cycles.
+ */
+void telemetry_cycles(int hist, uint32_t cycles)
+{
+    uint32_t scaled = cycles >> (CONFIG_TELEMETRY_HIST_SHIFT + 1);
+    int bucket = scaled ? MIN(32 - __builtin_clz(scaled), TELEMETRY_HIST_BUCKETS - 1) : 0;
+
+    atomic_inc(&telemetry.hist[hist][bucket]);
+}
+
+/**
+ * @brief Get a snapshot of all counters.
+ *
+ * Also restarts the window bytes_per_sec is averaged over.
+ *
+ * @param info Filled with the current values.
+ */
+void telemetry_get_info(telemetry_info_t *info)
+{
+    telemetry_snapshot(info);
+
+    info->uptime_ms = sys_cpu_to_le32(info->uptime_ms);
+    info->produced = sys_cpu_to_le32(info->produced);
+    info->fifo_lost = sys_cpu_to_le32(info->fifo_lost);
+    info->dropped = sys_cpu_to_le32(info->dropped);
+    info->decimated = sys_cpu_to_le32(info->decimated);
+    info->sent = sys_cpu_to_le32(info->sent);
+    info->resent = sys_cpu_to_le32(info->resent);
+    info->bytes_sent = sys_cpu_to_le32(info->bytes_sent);
+    info->bytes_per_sec = sys_cpu_to_le32(info->bytes_per_sec);
+    info->cache_count = sys_cpu_to_le16(info->cache_count);
+    info->cache_high_water = sys_cpu_to_le16(info->cache_high_water);
+
+    for (int i = 0; i < TELEMETRY_ERR_COUNT; i++) {
+        info->notify_err[i] = sys_cpu_to_le32(info->notify_err[i]);
+    }
+
+    for (int h = 0; h < TELEMETRY_HIST_COUNT; h++) {
+        for (int b = 0; b < TELEMETRY_HIST_BUCKETS; b++) {
+            info->hist[h][b] = sys_cpu_to_le32(info->hist[h][b]);
+        }
+    }
+}
@@ -0,0 +1,1823 @@
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+
+#include "dma_copy.h"
+#include "flash_tier.h"
+#include "imu_codec.h"
+#include "l2cap_bulk.h"
+#include "mem_cache.h"
+#include "profile.h"
+#include "telemetry.h"
+#include "tx_engine.h"
+
+LOG_MODULE_REGISTER(tx_engine, LOG_LEVEL_INF);
+
+
+/******************************************************************************
+ * Data Types
+ ******************************************************************************/
+
+/* Header prepended to every batched notification (little-endian) */
+typedef struct __attribute__((packed)) {
+    uint16_t seq;    /* Batch sequence number, incremented per sent batch */
+    uint8_t count;   /* Number of sensor_sample_t records that follow */
+} tx_batch_hdr_t;
+
+/* Read position of one consumer in the shared cache */
+typedef struct {
+    bool synced;         /* Something was sent, last_seq is valid */
+    uint32_t last_seq;   /* Sequence number of the last sample sent */
+} tx_cursor_t;
+
+/* Per-connection state, indexed by bt_conn_index() */
+typedef struct {
+    struct bt_conn *conn;               /* Subscribed connection, NULL if the slot is free */
+    atomic_t credits;                   /* Notifications that may still be queued */
+    atomic_t generation;                /* Bumped on every start/stop, tags completions */
+    uint16_t seq;                       /* Sequence number of the next batch */
+    tx_cursor_t cursor;                 /* Position in the cache */
+#if defined(CONFIG_MEM_CACHE_ALERT)
+    tx_cursor_t alert_cursor;           /* Position in the alert stream */
+#endif /* CONFIG_MEM_CACHE_ALERT */
+#if defined(CONFIG_IMU_CODEC) && !defined(CONFIG_IMU_CODEC_CACHE)
+    imu_codec_t codec;                  /* IMU delta encoder, reset on every start */
+#endif /* CONFIG_IMU_CODEC && !CONFIG_IMU_CODEC_CACHE */
+#if defined(CONFIG_TX_SYNC_CONN_EVENT)
+    struct k_work_delayable window;     /* Opens the TX window ahead of a connection event */
+    uint32_t interval_us;               /* Connection interval */
+    uint8_t phy;                        /* TX PHY, BT_GAP_LE_PHY_* */
+    uint16_t tx_max_len;                /* LL TX payload octets */
+    int64_t anchor;                     /* Uptime in ticks of the last event seen, sync_lock */
+    int64_t next_flush;                 /* Uptime in ticks the next periodic window is due */
+    int64_t event;                      /* Uptime in ticks of the event the window is for */
+    size_t budget;                      /* Notifications the open window may still queue */
+#endif /* CONFIG_TX_SYNC_CONN_EVENT */
+} tx_conn_t;
+
+#if defined(CONFIG_TX_RETRANSMIT)
+/* Pending retransmit request, in sample sequence numbers */
+typedef struct {
+    uint8_t slot;     /* Connection index the samples go back to */
+    uint32_t first;   /* Next sequence number to resend */
+    uint32_t count;   /* Sequence numbers left in the range */
+} tx_retx_range_t;
+#endif /* CONFIG_TX_RETRANSMIT */
+
+typedef struct {
+    struct k_work_q workq;              /* Dedicated TX work queue */
+    struct k_work work;                 /* Drain work item */
+    struct k_mutex lock;                /* Protects the connection slots against start/stop */
+    const struct bt_gatt_attr *attr;    /* Sensor data characteristic value */
+    tx_conn_t conns[CONFIG_BT_MAX_CONN];   /* One slot per possible connection */
+#if defined(CONFIG_TX_BATCHING)
+    atomic_t flush;                     /* Set on every transmit tick */
+    bool flushing;                      /* Partial batches go out during this pass */
+    size_t batch_target;                /* Samples a batch waits for between ticks */
+#endif /* CONFIG_TX_BATCHING */
+#if defined(CONFIG_L2CAP_BULK)
+    struct bt_l2cap_chan *bulk;         /* Bulk channel being served, NULL for notifications */
+    uint16_t bulk_seq;                  /* Sequence number of the next bulk SDU */
+    tx_cursor_t bulk_cursor;            /* Position of the bulk stream in the cache */
+#if defined(CONFIG_IMU_CODEC) && !defined(CONFIG_IMU_CODEC_CACHE)
+    imu_codec_t bulk_codec;             /* IMU delta encoder of the bulk stream */
+#endif /* CONFIG_IMU_CODEC && !CONFIG_IMU_CODEC_CACHE */
+#endif /* CONFIG_L2CAP_BULK */
+#if defined(CONFIG_IMU_CODEC_CACHE)
+    imu_codec_t chain;                  /* Decoder following every record released */
+    bool keyframe_due;                  /* A new stream starts, send the oldest record absolute */
+#endif /* CONFIG_IMU_CODEC_CACHE */
+#if defined(CONFIG_FLASH_TIER)
+    const sensor_sample_t *restored;    /* Samples restored from flash, sent before the cache */
+    size_t restored_n;                  /* Number of restored samples, 0 to send from the cache */
+#endif /* CONFIG_FLASH_TIER */
+#if defined(CONFIG_TX_RETRANSMIT)
+    const struct bt_gatt_attr *retx_attr;   /* Retransmit characteristic value */
+    tx_retx_range_t retx[CONFIG_TX_RETRANSMIT_REQUESTS];   /* Pending requests, oldest first */
+    size_t retx_n;                      /* Number of pending requests */
+    sensor_sample_t retained[CONFIG_TX_RETRANSMIT_WINDOW]; /* Last released samples, ring */
+    size_t retained_head;               /* Ring slot the next released sample goes to */
+    size_t retained_n;                  /* Samples held in the ring */
+    uint32_t retained_oldest;           /* Sequence number of the oldest retained sample */
+#endif /* CONFIG_TX_RETRANSMIT */
+#if defined(CONFIG_MEM_CACHE_ALERT)
+    const struct bt_gatt_attr *alert_attr;  /* Alert characteristic value */
+#endif /* CONFIG_MEM_CACHE_ALERT */
+#if defined(CONFIG_TX_SYNC_CONN_EVENT)
+    struct k_spinlock sync_lock;        /* Protects the anchors, set from completion callbacks */
+    uint32_t tx_interval_ms;            /* Period of the windows without a backlog */
+#endif /* CONFIG_TX_SYNC_CONN_EVENT */
+} tx_engine_t;
+
+
+/******************************************************************************
+ * Macro
+ ******************************************************************************/
+
+/* ATT notification header: opcode (1 byte) + attribute handle (2 bytes) */
+#define ATT_NOTIFY_HDR_LEN 3
+
+/* Largest notification payload the local L2CAP TX MTU allows */
+#define TX_BUF_LEN (CONFIG_BT_L2CAP_TX_MTU - ATT_NOTIFY_HDR_LEN)
+
+/* Notifications are assembled in tx_buf unless samples go out verbatim */
+#define TX_ASSEMBLE (IS_ENABLED(CONFIG_TX_BATCHING) || IS_ENABLED(CONFIG_IMU_CODEC))
+
+/* Header length in front of the sample records */
+#define TX_HDR_LEN (IS_ENABLED(CONFIG_TX_BATCHING) ? sizeof(tx_batch_hdr_t) : 0)
+
+/* Records per notification */
+#define TX_MAX_RECORDS (IS_ENABLED(CONFIG_TX_BATCHING) ? UINT8_MAX : 1)
+
+/* Largest record a notification or bulk SDU may have to carry */
+#define TX_RECORD_MAX_LEN (IS_ENABLED(CONFIG_IMU_CODEC) ? IMU_CODEC_MAX_LEN : SAMPLE_WIRE_LEN)
+
+#if defined(CONFIG_IMU_CODEC)
+BUILD_ASSERT(TX_HDR_LEN + IMU_CODEC_MAX_LEN <= TX_BUF_LEN,
+             "Worst-case IMU codec record does not fit in CONFIG_BT_L2CAP_TX_MTU");
+#endif /* CONFIG_IMU_CODEC */
+
+#if defined(CONFIG_L2CAP_BULK)
+BUILD_ASSERT(sizeof(tx_batch_hdr_t) + TX_RECORD_MAX_LEN <= CONFIG_L2CAP_BULK_SDU_LEN,
+             "Worst-case record does not fit in CONFIG_L2CAP_BULK_SDU_LEN");
+#endif /* CONFIG_L2CAP_BULK */
+
+#if defined(CONFIG_TX_RETRANSMIT)
+BUILD_ASSERT(SAMPLE_WIRE_LEN <= TX_BUF_LEN,
+             "A retransmitted sample does not fit in CONFIG_BT_L2CAP_TX_MTU");
+#endif /* CONFIG_TX_RETRANSMIT */
+
+#if defined(CONFIG_MEM_CACHE_ALERT)
+BUILD_ASSERT(SAMPLE_WIRE_LEN <= TX_BUF_LEN, "An alert does not fit in CONFIG_BT_L2CAP_TX_MTU");
+#endif /* CONFIG_MEM_CACHE_ALERT */
+
+/* Credits only alerts may use, the last one unless a connection has just one */
+#define TX_ALERT_CREDITS \
+    ((IS_ENABLED(CONFIG_MEM_CACHE_ALERT) && CONFIG_TX_ENGINE_CREDITS > 1) ? 1 : 0)
+
+#if defined(CONFIG_TX_SYNC_CONN_EVENT)
+/* Inter frame space between two packets of a connection event */
+#define TX_SYNC_T_IFS_US 150
+
+/* Preamble, access address, LL header and CRC around every LL payload */
+#define TX_SYNC_LL_OVERHEAD(phy) (((phy) == BT_GAP_LE_PHY_2M ? 2 : 1) + 4 + 2 + 3)
+
+/* L2CAP basic header in front of the ATT PDU */
+#define TX_SYNC_L2CAP_HDR_LEN 4
+
+/* LL payload octets before Data Length Extension */
+#define TX_SYNC_DEFAULT_TX_LEN 27
+
+/* Shortest connection interval the specification allows */
+#define TX_SYNC_MIN_INTERVAL_US 7500
+#endif /* CONFIG_TX_SYNC_CONN_EVENT */
+
+/* Slots that stopped making progress are tracked in a 32-bit mask */
+BUILD_ASSERT(CONFIG_BT_MAX_CONN <= 32, "Too many connections for the TX engine");
+
+
+/******************************************************************************
+ * Static Variables
+ ******************************************************************************/
+
+static tx_engine_t engine;
+
+K_THREAD_STACK_DEFINE(tx_engine_stack, CONFIG_TX_ENGINE_STACK_SIZE);
+
+#if defined(CONFIG_TX_BATCHING) || defined(CONFIG_IMU_CODEC)
+/* Notification assembly buffer: optional tx_batch_hdr_t followed by records */
+static uint8_t tx_buf[TX_BUF_LEN];
+#endif /* CONFIG_TX_BATCHING || CONFIG_IMU_CODEC */
+
+#if defined(CONFIG_TX_RETRANSMIT)
+/* Retransmit assembly buffer: samples from the retained window, serialized */
+static uint8_t retx_buf[TX_BUF_LEN];
+#endif /* CONFIG_TX_RETRANSMIT */
+
+#if defined(CONFIG_MEM_CACHE_ALERT)
+/* Alerts copied out of their ring, and the notification they are serialized into */
+static sensor_sample_t alert_samples[TX_BUF_LEN / SAMPLE_WIRE_LEN];
+static uint8_t alert_buf[TX_BUF_LEN];
+#endif /* CONFIG_MEM_CACHE_ALERT */
+
+
+/******************************************************************************
+ * Cursors
+ ******************************************************************************/
+
+/**
+ * @brief Pick the samples the next notification is built from.
+ *
+ * Samples restored from the flash tier are older than anything in the RAM
+ * cache and go out first; the cache is only read once the tier is empty.
+ *
+ * @return 0 on success, or -ENODATA while older samples are still being
+ *         restored from flash.
+ */
+static int tx_source_select(void)
+{
+#if defined(CONFIG_FLASH_TIER)
+    int n = flash_tier_peek(&engine.restored);
+    if (n < 0) {
+        return -ENODATA;
+    }
+    engine.restored_n = n;
+#endif /* CONFIG_FLASH_TIER */
+    return 0;
+}
+
+/**
+ * @brief Get the @p idx-th oldest pending sample of the selected source.
+ *
+ * @param idx    Position from the head of the source.
+ * @param sample Set to the requested sample.
+ * @return true if the sample exists.
+ */
+static inline bool tx_peek_at(size_t idx, const sensor_sample_t **sample)
+{
+#if defined(CONFIG_FLASH_TIER)
+    if (engine.restored_n) {
+        if (idx >= engine.restored_n) {
+            return false;
+        }
+        *sample = &engine.restored[idx];
+        return true;
+    }
+#endif /* CONFIG_FLASH_TIER */
+    return mem_cache_peek_at(idx, sample);
+}
+
+/**
+ * @brief Count what the selected source holds.
+ *
+ * @return Number of pending samples or records.
+ */
+static inline size_t tx_avail(void)
+{
+#if defined(CONFIG_FLASH_TIER)
+    if (engine.restored_n) {
+        return engine.restored_n;
+    }
+#endif /* CONFIG_FLASH_TIER */
+    return mem_cache_count();
+}
+
+#if !defined(CONFIG_IMU_CODEC_CACHE)
+/**
+ * @brief Count the leading samples of the selected source up to @p seq.
+ *
+ * Sequence numbers grow from head to tail even when the cache dropped or
+ * decimated samples, so a binary search finds the spot.
+ *
+ * @param seq Sequence number to look for.
+ * @return Number of samples with a sequence number not after @p seq.
+ */
+static size_t tx_seq_upper(uint32_t seq)
+{
+    const sensor_sample_t *sample;
+    size_t lo = 0;
+    size_t hi = tx_avail();
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        /* Sequence numbers wrap, compare by distance */
+        if (tx_peek_at(mid, &sample) && (int32_t)(sample->hdr.seq - seq) <= 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+#endif /* !CONFIG_IMU_CODEC_CACHE */
+
+/**
+ * @brief Find where a consumer continues in the selected source.
+ *
+ * @param cursor The consumer's cursor.
+ * @return Index of the first sample not sent to the consumer yet.
+ */
+static size_t tx_cursor_pos(const tx_cursor_t *cursor)
+{
+#if defined(CONFIG_IMU_CODEC_CACHE)
+    /* Records are released as soon as they are sent, the only cursor is the head */
+    return 0;
+#else
+    return cursor->synced ? tx_seq_upper(cursor->last_seq) : 0;
+#endif /* CONFIG_IMU_CODEC_CACHE */
+}
+
+#if defined(CONFIG_TX_RETRANSMIT)
+/**
+ * @brief Keep a copy of the @p n oldest samples of the selected source.
+ *
+ * Called right before they are released, so a client can still ask for
+ * them while they are in the retained window.
+ *
+ * @param n Number of samples released.
+ */
+static void tx_retain(size_t n)
+{
+    const sensor_sample_t *sample;
+
+    for (size_t i = 0; i < n && tx_peek_at(i, &sample); i++) {
+        memcpy(&engine.retained[engine.retained_head], sample, sizeof(*sample));
+        engine.retained_head = (engine.retained_head + 1) % CONFIG_TX_RETRANSMIT_WINDOW;
+        if (engine.retained_n < CONFIG_TX_RETRANSMIT_WINDOW) {
+            engine.retained_n++;
+        }
+    }
+
+    if (engine.retained_n) {
+        engine.retained_oldest =
+            engine.retained[(engine.retained_head + CONFIG_TX_RETRANSMIT_WINDOW -
+                             engine.retained_n) % CONFIG_TX_RETRANSMIT_WINDOW].hdr.seq;
+    }
+}
+#endif /* CONFIG_TX_RETRANSMIT */
+
+#if defined(CONFIG_IMU_CODEC_CACHE)
+/**
+ * @brief Follow the delta chain over the @p n oldest cached records.
+ *
+ * Called right before they are released, so the chain state always
+ * matches the record in front of the new oldest one.
+ *
+ * @param n Number of records released.
+ */
+static void tx_chain_advance(size_t n)
+{
+    const uint8_t *rec;
+    sensor_sample_t sample;
+    size_t len;
+    size_t used;
+
+    for (size_t i = 0; i < n && (len = mem_cache_peek_record_at(i, &rec)) != 0; i++) {
+        (void)imu_codec_decode(&engine.chain, rec, len, &sample, &used);
+    }
+    if (n) {
+        engine.keyframe_due = false;
+    }
+}
+
+/**
+ * @brief Re-encode the oldest cached record as a keyframe.
+ *
+ * A stream starting at a delta record would make its decoder drop every
+ * record up to the next keyframe the sampler encoded.
+ *
+ * @param buf Destination for the keyframe.
+ * @param cap Room in @p buf.
+ * @param len Set to the keyframe length, 0 if it does not fit in @p cap.
+ * @return true if @p len is valid, false to send the record as it is
+ *         because the chain was never synced.
+ */
+static bool tx_keyframe(uint8_t *buf, size_t cap, size_t *len)
+{
+    imu_codec_t chain = engine.chain;
+    imu_codec_t codec;
+    sensor_sample_t sample;
+    const uint8_t *rec;
+    size_t rec_len = mem_cache_peek_record_at(0, &rec);
+    size_t used;
+
+    if (rec_len == 0 || imu_codec_decode(&chain, rec, rec_len, &sample, &used)) {
+        return false;
+    }
+
+    imu_codec_reset(&codec);
+    *len = imu_codec_encode(&codec, &sample, buf, cap);
+    return true;
+}
+#endif /* CONFIG_IMU_CODEC_CACHE */
+
+/**
+ * @brief Release the @p n oldest samples of the selected source.
+ *
+ * @param n Number of samples every consumer is done with.
+ */
+static inline void tx_commit_n(size_t n)
+{
+#if defined(CONFIG_IMU_CODEC_CACHE)
+    tx_chain_advance(n);
+#endif /* CONFIG_IMU_CODEC_CACHE */
+#if defined(CONFIG_TX_RETRANSMIT)
+    tx_retain(n);
+#endif /* CONFIG_TX_RETRANSMIT */
+#if defined(CONFIG_FLASH_TIER)
+    if (engine.restored_n) {
+        flash_tier_commit(n);
+        return;
+    }
+#endif /* CONFIG_FLASH_TIER */
+    mem_cache_commit_pop_n(n);
+}
+
+/**
+ * @brief Move a cursor past @p n samples that were just sent.
+ *
+ * @param cursor The consumer's cursor.
+ * @param pos    Index the samples were taken from.
+ * @param n      Number of samples sent.
+ */
+static void tx_cursor_advance(tx_cursor_t *cursor, size_t pos, size_t n)
+{
+#if defined(CONFIG_IMU_CODEC_CACHE)
+    ARG_UNUSED(cursor);
+    ARG_UNUSED(pos);
+    tx_commit_n(n);
+#else
+    const sensor_sample_t *sample;
+
+    if (n && tx_peek_at(pos + n - 1, &sample)) {
+        cursor->last_seq = sample->hdr.seq;
+        cursor->synced = true;
+    }
+#if defined(CONFIG_PROFILE)
+    for (size_t i = 0; i < n && tx_peek_at(pos + i, &sample); i++) {
+        profile_queued(sample->hdr.seq);
+    }
+#endif /* CONFIG_PROFILE */
+#endif /* CONFIG_IMU_CODEC_CACHE */
+}
+
+/**
+ * @brief Check whether a connection is currently fed through the bulk channel.
+ *
+ * @param c The connection slot.
+ * @return true if its notifications are paused for a bulk transfer.
+ */
+static inline bool tx_is_bulk(const tx_conn_t *c)
+{
+#if defined(CONFIG_L2CAP_BULK)
+    return engine.bulk && engine.bulk->conn == c->conn;
+#else
+    return false;
+#endif /* CONFIG_L2CAP_BULK */
+}
+
+/**
+ * @brief Check whether anybody reads from the cache.
+ *
+ * @return true if a connection is subscribed or a bulk transfer runs.
+ */
+static bool tx_active(void)
+{
+#if defined(CONFIG_L2CAP_BULK)
+    if (engine.bulk) {
+        return true;
+    }
+#endif /* CONFIG_L2CAP_BULK */
+    for (size_t i = 0; i < ARRAY_SIZE(engine.conns); i++) {
+        if (engine.conns[i].conn) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Release the samples every active cursor has passed.
+ *
+ * A slot is only freed once it has gone out to all subscribers and the
+ * bulk stream, so a slow central holds samples back for itself without the
+ * cache being duplicated per connection.
+ */
+static void tx_release(void)
+{
+#if !defined(CONFIG_IMU_CODEC_CACHE)
+    size_t n = SIZE_MAX;
+
+#if defined(CONFIG_L2CAP_BULK)
+    if (engine.bulk) {
+        n = tx_cursor_pos(&engine.bulk_cursor);
+    }
+#endif /* CONFIG_L2CAP_BULK */
+    for (size_t i = 0; i < ARRAY_SIZE(engine.conns) && n; i++) {
+        const tx_conn_t *c = &engine.conns[i];
+
+        if (c->conn && !tx_is_bulk(c)) {
+            n = MIN(n, tx_cursor_pos(&c->cursor));
+        }
+    }
+
+    if (n != SIZE_MAX && n) {
+        tx_commit_n(n);
+    }
+#endif /* !CONFIG_IMU_CODEC_CACHE */
+}
+
+
+#if defined(CONFIG_TX_SYNC_CONN_EVENT)
+/******************************************************************************
+ * Connection events
+ ******************************************************************************/
+
+/**
+ * @brief Air time of one LL packet.
+ *
+ * @param phy TX PHY, BT_GAP_LE_PHY_*.
+ * @param len LL payload octets.
+ * @return Duration of the packet in microseconds.
+ */
+static uint32_t tx_sync_airtime_us(uint8_t phy, size_t len)
+{
+    uint32_t octets = TX_SYNC_LL_OVERHEAD(phy) + len;
+
+    switch (phy) {
+    case BT_GAP_LE_PHY_2M:
+        return octets * 4;
+    case BT_GAP_LE_PHY_CODED:
+        /* Worst case, S=8 coding */
+        return octets * 64;
+    default:
+        return octets * 8;
+    }
+}
+
+/**
+ * @brief Estimate how many full-MTU notifications one event can carry.
+ *
+ * Every LL fragment is answered by an empty packet of the central, each
+ * followed by an inter frame space.
+ *
+ * @param c The connection slot.
+ * @return Notifications per event, between 1 and the connection's credits.
+ */
+static size_t tx_sync_capacity(const tx_conn_t *c)
+{
+    size_t frag_len = MAX(c->tx_max_len, TX_SYNC_DEFAULT_TX_LEN);
+    size_t frags = DIV_ROUND_UP(bt_gatt_get_mtu(c->conn) + TX_SYNC_L2CAP_HDR_LEN, frag_len);
+    uint32_t pair_us = tx_sync_airtime_us(c->phy, frag_len) + TX_SYNC_T_IFS_US +
+                       tx_sync_airtime_us(c->phy, 0) + TX_SYNC_T_IFS_US;
+    uint32_t share_us = (uint64_t)c->interval_us * CONFIG_TX_SYNC_EVENT_SHARE / 100;
+    size_t n = share_us / (frags * pair_us);
+
+    return CLAMP(n, 1, CONFIG_TX_ENGINE_CREDITS);
+}
+
+/**
+ * @brief Record that the connection just had an event.
+ *
+ * Called on every notification completion, which the stack reports right
+ * after the event that carried it. Safe to call from any context.
+ *
+ * @param c The connection slot.
+ */
+static void tx_sync_seen(tx_conn_t *c)
+{
+    k_spinlock_key_t key = k_spin_lock(&engine.sync_lock);
+
+    c->anchor = k_uptime_ticks();
+    k_spin_unlock(&engine.sync_lock, key);
+}
+
+/**
+ * @brief Schedule the connection's next window.
+ *
+ * Picks the first predicted event the window can still open ahead of,
+ * right away with a backlog, otherwise once the transmit interval is up.
+ *
+ * @param c       The connection slot.
+ * @param backlog Whether the last window was filled.
+ */
+static void tx_sync_schedule(tx_conn_t *c, bool backlog)
+{
+    int64_t interval = k_us_to_ticks_ceil64(MAX(c->interval_us, TX_SYNC_MIN_INTERVAL_US));
+    int64_t lead = k_us_to_ticks_ceil64(CONFIG_TX_SYNC_LEAD_US);
+    int64_t now = k_uptime_ticks();
+    int64_t from = (backlog ? now : MAX(now, c->next_flush)) + lead;
+    k_spinlock_key_t key = k_spin_lock(&engine.sync_lock);
+    int64_t event = c->anchor;
+
+    k_spin_unlock(&engine.sync_lock, key);
+
+    if (from > event) {
+        event += DIV_ROUND_UP(from - event, interval) * interval;
+    }
+    c->event = event;
+    k_work_schedule_for_queue(&engine.workq, &c->window, K_TIMEOUT_ABS_TICKS(event - lead));
+}
+
+/**
+ * @brief Check whether a connection may queue bulk notifications now.
+ *
+ * A window closes once its budget is used up or the share of the
+ * interval it was sized for has passed.
+ *
+ * @param c The connection slot.
+ * @return true inside an open window.
+ */
+static bool tx_sync_open(const tx_conn_t *c)
+{
+    int64_t share = k_us_to_ticks_ceil64((uint64_t)c->interval_us *
+                                         CONFIG_TX_SYNC_EVENT_SHARE / 100);
+
+    return c->budget && k_uptime_ticks() < c->event + share;
+}
+#endif /* CONFIG_TX_SYNC_CONN_EVENT */
+
+
+/******************************************************************************
+ * TX path
+ ******************************************************************************/
+
+/**
+ * @brief Notification completion callback.
+ *
+ * Returns the credit taken for the notification and reschedules the drain
+ * work. Completions from a previous subscription are ignored.
+ *
+ * @param conn      The connection object.
+ * @param user_data Slot generation the notification was sent under.
+ */
+static void tx_complete_cb(struct bt_conn *conn, void *user_data)
+{
+    tx_conn_t *c = &engine.conns[bt_conn_index(conn)];
+
+    if ((atomic_val_t)(uintptr_t)user_data != atomic_get(&c->generation)) {
+        return;
+    }
+
+#if defined(CONFIG_PROFILE)
+    profile_link_end(bt_conn_index(conn));
+#endif /* CONFIG_PROFILE */
+#if defined(CONFIG_TX_SYNC_CONN_EVENT)
+    tx_sync_seen(c);
+#endif /* CONFIG_TX_SYNC_CONN_EVENT */
+    atomic_inc(&c->credits);
+    k_work_submit_to_queue(&engine.workq, &engine.work);
+}
+
+/**
+ * @brief Queue one notification, taking a credit for it.
+ *
+ * @param c    The connection slot to notify.
+ * @param attr Characteristic value to notify on.
+ * @param data Notification payload.
+ * @param len  Payload length.
+ * @return 0 on success or a negative error code from bt_gatt_notify_cb().
+ */
+static int tx_notify(tx_conn_t *c, const struct bt_gatt_attr *attr,
+                     const void *data, uint16_t len)
+{
+    struct bt_gatt_notify_params params = {
+        .attr = attr,
+        .data = data,
+        .len = len,
+        .func = tx_complete_cb,
+        .user_data = (void *)(uintptr_t)atomic_get(&c->generation),
+    };
+
+    atomic_dec(&c->credits);
+#if defined(CONFIG_PROFILE)
+    /* Before queueing, the completion may run first */
+    profile_link_begin(c - engine.conns);
+#endif /* CONFIG_PROFILE */
+
+    int err = bt_gatt_notify_cb(c->conn, &params);
+    if (err) {
+        atomic_inc(&c->credits);
+        telemetry_notify_error(err);
+#if defined(CONFIG_PROFILE)
+        profile_link_cancel(c - engine.conns);
+#endif /* CONFIG_PROFILE */
+    }
+
+    return err;
+}
+
+#if defined(CONFIG_TX_BATCHING) || defined(CONFIG_IMU_CODEC) || defined(CONFIG_L2CAP_BULK)
+#if defined(CONFIG_IMU_CODEC_CACHE)
+/**
+ * @brief Copy as many pre-encoded cache records as fit into @p buf.
+ *
+ * @param start Index of the first record.
+ * @param buf   Destination for the records.
+ * @param cap   Room left in @p buf.
+ * @param max   Maximum number of records.
+ * @param len   Set to the number of bytes written.
+ * @return Number of records copied.
+ */
+static size_t tx_fill_records(size_t start, uint8_t *buf, size_t cap, size_t max, size_t *len)
+{
+    const uint8_t *rec;
+    size_t rec_len;
+    size_t off = 0;
+    size_t n = 0;
+
+    if (start == 0 && engine.keyframe_due && tx_keyframe(buf, cap, &off)) {
+        if (off == 0) {
+            *len = 0;
+            return 0;
+        }
+        n = 1;
+    }
+
+    while (n < max && (rec_len = mem_cache_peek_record_at(start + n, &rec)) != 0) {
+        if (rec_len > cap - off) {
+            break;
+        }
+        memcpy(&buf[off], rec, rec_len);
+        off += rec_len;
+        n++;
+    }
+
+    *len = off;
+    return n;
+}
+#elif defined(CONFIG_IMU_CODEC)
+/**
+ * @brief Encode as many cached samples as fit into @p buf.
+ *
+ * Samples are read in place from the cache. @p codec is advanced for
+ * every record that fits; the caller only keeps it if the notification
+ * is queued.
+ *
+ * @param codec Scratch copy of the consumer's encoder state.
+ * @param start Index of the first sample.
+ * @param buf   Destination for the encoded records.
+ * @param cap   Room left in @p buf.
+ * @param max   Maximum number of records.
+ * @param len   Set to the number of bytes written.
+ * @return Number of samples encoded.
+ */
+static size_t tx_fill_records(imu_codec_t *codec, size_t start, uint8_t *buf, size_t cap,
+                              size_t max, size_t *len)
+{
+    const sensor_sample_t *sample;
+    size_t off = 0;
+    size_t n = 0;
+
+    while (n < max && tx_peek_at(start + n, &sample)) {
+        size_t rec = imu_codec_encode(codec, sample, &buf[off], cap - off);
+        if (rec == 0) {
+            break;
+        }
+        off += rec;
+        n++;
+    }
+
+    *len = off;
+    return n;
+}
+#else
+/**
+ * @brief Serialize as many cached samples as fit into @p buf.
+ *
+ * Slots without padding are already in the wire layout, so runs of
+ * samples that are adjacent in memory go out in one dma_copy().
+ *
+ * @param start Index of the first sample.
+ * @param buf   Destination for the samples in their wire layout.
+ * @param cap   Room left in @p buf.
+ * @param max   Maximum number of samples.
+ * @param len   Set to the number of bytes written.
+ * @return Number of samples written.
+ */
+static size_t tx_fill_records(size_t start, uint8_t *buf, size_t cap, size_t max, size_t *len)
+{
+    const sensor_sample_t *sample;
+    const sensor_sample_t *run = NULL;   /* First sample of the pending run */
+    size_t run_n = 0;                    /* Samples in the run, the last one at n - 1 */
+    size_t n = 0;
+
+    max = MIN(cap / SAMPLE_WIRE_LEN, max);
+    while (n < max && tx_peek_at(start + n, &sample)) {
+        if (SAMPLE_WIRE_LEN != sizeof(sensor_sample_t)) {
+            sample_serialize(&buf[n * SAMPLE_WIRE_LEN], sample);
+        } else if (run_n && sample == run + run_n) {
+            run_n++;
+        } else {
+            if (run_n) {
+                dma_copy(&buf[(n - run_n) * SAMPLE_WIRE_LEN], run, run_n * SAMPLE_WIRE_LEN);
+            }
+            run = sample;
+            run_n = 1;
+        }
+        n++;
+    }
+
+    if (run_n) {
+        dma_copy(&buf[(n - run_n) * SAMPLE_WIRE_LEN], run, run_n * SAMPLE_WIRE_LEN);
+    }
+
+    *len = n * SAMPLE_WIRE_LEN;
+    return n;
+}
+#endif /* CONFIG_IMU_CODEC */
+#endif /* CONFIG_TX_BATCHING || CONFIG_IMU_CODEC || CONFIG_L2CAP_BULK */
+
+#if defined(CONFIG_TX_BATCHING)
+/**
+ * @brief Decide whether a batch is worth a notification yet.
+ *
+ * A batch that is neither full nor at the target size is held back while
+ * the cache may still add to it, until the next transmit tick.
+ *
+ * @param pos Index of the first record of the batch.
+ * @param n   Number of records in the batch.
+ * @return true if the batch should be sent now.
+ */
+static bool tx_batch_ready(size_t pos, size_t n)
+{
+#if defined(CONFIG_FLASH_TIER)
+    if (engine.restored_n) {
+        /* Restored backlog is complete, nothing to wait for */
+        return true;
+    }
+#endif /* CONFIG_FLASH_TIER */
+    return engine.flushing || n >= engine.batch_target || pos + n < tx_avail();
+}
+#endif /* CONFIG_TX_BATCHING */
+
+#if defined(CONFIG_TX_BATCHING) || defined(CONFIG_IMU_CODEC)
+/**
+ * @brief Send as many samples as fit in one notification.
+ *
+ * The notification is sized to the negotiated ATT MTU (minus the
+ * notification header). With CONFIG_TX_BATCHING it is prefixed with a
+ * tx_batch_hdr_t and carries several records, otherwise exactly one.
+ * The connection's cursor only moves once the notification has been
+ * queued.
+ *
+ * @param c The connection slot to notify.
+ * @return 0 on success, -ENODATA if there is nothing to send yet, or a
+ *         negative error code from bt_gatt_notify_cb().
+ */
+static int tx_send_next(tx_conn_t *c)
+{
+    size_t payload = MIN((size_t)(bt_gatt_get_mtu(c->conn) - ATT_NOTIFY_HDR_LEN), sizeof(tx_buf));
+    size_t len;
+    size_t n;
+
+    if (payload <= TX_HDR_LEN || tx_source_select()) {
+        return -ENODATA;
+    }
+
+    size_t pos = tx_cursor_pos(&c->cursor);
+
+#if defined(CONFIG_IMU_CODEC) && !defined(CONFIG_IMU_CODEC_CACHE)
+    imu_codec_t codec = c->codec;
+
+    n = tx_fill_records(&codec, pos, &tx_buf[TX_HDR_LEN], payload - TX_HDR_LEN,
+                        TX_MAX_RECORDS, &len);
+#else
+    n = tx_fill_records(pos, &tx_buf[TX_HDR_LEN], payload - TX_HDR_LEN, TX_MAX_RECORDS, &len);
+#endif /* CONFIG_IMU_CODEC && !CONFIG_IMU_CODEC_CACHE */
+    if (n == 0) {
+        /* Caught up, or MTU exchange not done yet and not even one record fits */
+        return -ENODATA;
+    }
+
+#if defined(CONFIG_TX_BATCHING)
+    if (!tx_batch_ready(pos, n)) {
+        return -ENODATA;
+    }
+
+    tx_batch_hdr_t *hdr = (tx_batch_hdr_t *)tx_buf;
+
+    hdr->seq = sys_cpu_to_le16(c->seq);
+    hdr->count = n;
+#endif /* CONFIG_TX_BATCHING */
+
+    int err = tx_notify(c, engine.attr, tx_buf, TX_HDR_LEN + len);
+    if (err) {
+        return err;
+    }
+
+    telemetry_sent(n, TX_HDR_LEN + len);
+    tx_cursor_advance(&c->cursor, pos, n);
+    c->seq++;
+#if defined(CONFIG_IMU_CODEC) && !defined(CONFIG_IMU_CODEC_CACHE)
+    c->codec = codec;
+#endif /* CONFIG_IMU_CODEC && !CONFIG_IMU_CODEC_CACHE */
+    return 0;
+}
+#else
+/**
+ * @brief Send the connection's next sample straight from its cache slot.
+ *
+ * The connection's cursor only moves once the notification has been
+ * queued, so a failure keeps the sample pending for it.
+ *
+ * @param c The connection slot to notify.
+ * @return 0 on success, -ENODATA if there is nothing to send, or a
+ *         negative error code from bt_gatt_notify_cb().
+ */
+static int tx_send_next(tx_conn_t *c)
+{
+    const sensor_sample_t *sample;
+
+    if (tx_source_select()) {
+        return -ENODATA;
+    }
+
+    size_t pos = tx_cursor_pos(&c->cursor);
+
+    if (!tx_peek_at(pos, &sample)) {
+        return -ENODATA;
+    }
+
+    /* The wire layout is a prefix of the slot, send it in place */
+    int err = tx_notify(c, engine.attr, sample, SAMPLE_WIRE_LEN);
+    if (err) {
+        return err;
+    }
+
+    telemetry_sent(1, SAMPLE_WIRE_LEN);
+    tx_cursor_advance(&c->cursor, pos, 1);
+    return 0;
+}
+#endif /* CONFIG_TX_BATCHING || CONFIG_IMU_CODEC */
+
+#if defined(CONFIG_TX_RETRANSMIT)
+/**
+ * @brief Look up a sample that was already sent.
+ *
+ * Released samples are in the retained window; samples a slower consumer
+ * still holds are read from the selected source.
+ *
+ * @param seq Sequence number of the sample.
+ * @return The sample, or NULL if it was dropped or has been evicted.
+ */
+static const sensor_sample_t *tx_retained_find(uint32_t seq)
+{
+    const sensor_sample_t *sample;
+
+    for (size_t i = 0; i < engine.retained_n; i++) {
+        if (engine.retained[i].hdr.seq == seq) {
+            return &engine.retained[i];
+        }
+    }
+
+    size_t idx = tx_seq_upper(seq);
+
+    if (idx && tx_peek_at(idx - 1, &sample) && sample->hdr.seq == seq) {
+        return sample;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Drop all pending retransmit requests of a connection.
+ *
+ * @param slot Connection index.
+ */
+static void tx_retx_drop(uint8_t slot)
+{
+    size_t kept = 0;
+
+    for (size_t i = 0; i < engine.retx_n; i++) {
+        if (engine.retx[i].slot != slot) {
+            engine.retx[kept++] = engine.retx[i];
+        }
+    }
+    engine.retx_n = kept;
+}
+
+/**
+ * @brief Resend samples of the connection's oldest pending request.
+ *
+ * Packs as many raw samples as fit in one notification on the retransmit
+ * characteristic. Sequence numbers no longer available, or never sent
+ * because the cache dropped them, are skipped; the client sees the gap in
+ * the seq fields of what comes back.
+ *
+ * @param c The connection slot to notify.
+ * @return 0 on success, -ENODATA if no request is pending, or a negative
+ *         error code from bt_gatt_notify_cb().
+ */
+static int tx_retx_send_next(tx_conn_t *c)
+{
+    uint8_t slot = c - engine.conns;
+    size_t max = MIN((size_t)(bt_gatt_get_mtu(c->conn) - ATT_NOTIFY_HDR_LEN),
+                     sizeof(retx_buf)) / SAMPLE_WIRE_LEN;
+    size_t req = 0;
+
+    while (req < engine.retx_n && engine.retx[req].slot != slot) {
+        req++;
+    }
+    if (req == engine.retx_n || max == 0) {
+        /* Nothing requested, or MTU exchange not done yet */
+        return -ENODATA;
+    }
+    if (!bt_gatt_is_subscribed(c->conn, engine.retx_attr, BT_GATT_CCC_NOTIFY)) {
+        /* Nobody listens for the answer */
+        tx_retx_drop(slot);
+        return -ENODATA;
+    }
+    if (tx_source_select()) {
+        return -ENODATA;
+    }
+
+    tx_retx_range_t *range = &engine.retx[req];
+    uint32_t first = range->first;
+    uint32_t count = range->count;
+    size_t n = 0;
+
+    while (count && n < max) {
+        const sensor_sample_t *sample = tx_retained_find(first);
+        if (sample) {
+            sample_serialize(&retx_buf[n++ * SAMPLE_WIRE_LEN], sample);
+        }
+        first++;
+        count--;
+    }
+
+    if (n) {
+        int err = tx_notify(c, engine.retx_attr, retx_buf, n * SAMPLE_WIRE_LEN);
+        if (err) {
+            return err;
+        }
+        telemetry_resent(n, n * SAMPLE_WIRE_LEN);
+    }
+
+    if (count) {
+        range->first = first;
+        range->count = count;
+    } else {
+        engine.retx_n--;
+        memmove(range, range + 1, (engine.retx_n - req) * sizeof(*range));
+    }
+
+    return 0;
+}
+#endif /* CONFIG_TX_RETRANSMIT */
+
+#if defined(CONFIG_MEM_CACHE_ALERT)
+/**
+ * @brief Check whether a connection listens on the Alert characteristic.
+ *
+ * @param c The connection slot.
+ * @return true if it enabled alert notifications.
+ */
+static inline bool tx_alert_subscribed(const tx_conn_t *c)
+{
+    return bt_gatt_is_subscribed(c->conn, engine.alert_attr, BT_GATT_CCC_NOTIFY);
+}
+
+/**
+ * @brief Release the alerts every listening connection has been sent.
+ *
+ * Connections that did not enable alerts do not hold any back. Without a
+ * listener alerts stay until the ring overflows, so the next client to
+ * subscribe still gets them.
+ */
+static void tx_alert_release(void)
+{
+    bool held = false;
+    uint32_t seq = 0;
+
+    for (size_t i = 0; i < ARRAY_SIZE(engine.conns); i++) {
+        const tx_conn_t *c = &engine.conns[i];
+
+        if (!c->conn || !tx_alert_subscribed(c)) {
+            continue;
+        }
+        if (!c->alert_cursor.synced) {
+            /* Still waits for everything held */
+            return;
+        }
+        /* Sequence numbers wrap, compare by distance */
+        if (!held || (int32_t)(c->alert_cursor.last_seq - seq) < 0) {
+            seq = c->alert_cursor.last_seq;
+            held = true;
+        }
+    }
+
+    if (held) {
+        mem_cache_alert_release(seq);
+    }
+}
+
+/**
+ * @brief Send the connection's pending alerts.
+ *
+ * Packs as many raw samples from the alert stream as fit in one
+ * notification on the Alert characteristic.
+ *
+ * @param c The connection slot to notify.
+ * @return 0 on success, -ENODATA if no alert is pending for it, or a
+ *         negative error code from bt_gatt_notify_cb().
+ */
+static int tx_alert_send_next(tx_conn_t *c)
+{
+    size_t max = MIN((size_t)(bt_gatt_get_mtu(c->conn) - ATT_NOTIFY_HDR_LEN),
+                     sizeof(alert_buf)) / SAMPLE_WIRE_LEN;
+
+    if (max == 0 || !tx_alert_subscribed(c)) {
+        /* MTU exchange not done yet, or nobody listens */
+        return -ENODATA;
+    }
+
+    size_t n = mem_cache_alert_peek(c->alert_cursor.synced, c->alert_cursor.last_seq,
+                                    alert_samples, max);
+    if (n == 0) {
+        return -ENODATA;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        sample_serialize(&alert_buf[i * SAMPLE_WIRE_LEN], &alert_samples[i]);
+    }
+
+    int err = tx_notify(c, engine.alert_attr, alert_buf, n * SAMPLE_WIRE_LEN);
+    if (err) {
+        return err;
+    }
+
+    c->alert_cursor.last_seq = alert_samples[n - 1].hdr.seq;
+    c->alert_cursor.synced = true;
+    tx_alert_release();
+    return 0;
+}
+
+/**
+ * @brief Check whether a connection is down to its alert credits.
+ *
+ * @param c The connection slot.
+ * @return true if only alerts may use its remaining credits.
+ */
+static inline bool tx_alert_reserved(const tx_conn_t *c)
+{
+    return atomic_get(&c->credits) <= TX_ALERT_CREDITS && tx_alert_subscribed(c);
+}
+#endif /* CONFIG_MEM_CACHE_ALERT */
+
+#if defined(CONFIG_L2CAP_BULK)
+/**
+ * @brief Stream the next SDU of the backlog over the bulk channel.
+ *
+ * Every SDU starts with a tx_batch_hdr_t and carries as many records as
+ * fit in the peer's SDU MTU. Once the backlog is drained an SDU with a
+ * record count of 0 marks the end of the transfer.
+ *
+ * @return 0 on success, -ENODATA once the end marker has been queued,
+ *         -ENOMEM while all SDU buffers are in flight, -EAGAIN while older
+ *         samples are being restored from flash or still wait for a
+ *         slower subscriber, -EMSGSIZE if the peer's SDU MTU is too small
+ *         for a record, or a negative error code from bt_l2cap_chan_send().
+ */
+static int tx_bulk_send_next(void)
+{
+    size_t cap;
+    size_t len;
+    size_t n;
+
+    if (tx_source_select()) {
+        return -EAGAIN;
+    }
+
+    size_t pos = tx_cursor_pos(&engine.bulk_cursor);
+
+#if defined(CONFIG_FLASH_TIER)
+    if (engine.restored_n && pos == engine.restored_n) {
+        /* The cache comes next once every subscriber is through the flash backlog */
+        return -EAGAIN;
+    }
+#endif /* CONFIG_FLASH_TIER */
+
+    struct net_buf *buf = l2cap_bulk_alloc(&cap);
+    if (!buf) {
+        return -ENOMEM;
+    }
+
+    tx_batch_hdr_t *hdr = net_buf_add(buf, sizeof(*hdr));
+
+#if defined(CONFIG_IMU_CODEC) && !defined(CONFIG_IMU_CODEC_CACHE)
+    imu_codec_t codec = engine.bulk_codec;
+
+    n = tx_fill_records(&codec, pos, net_buf_tail(buf), cap - sizeof(*hdr), UINT8_MAX, &len);
+#else
+    n = tx_fill_records(pos, net_buf_tail(buf), cap - sizeof(*hdr), UINT8_MAX, &len);
+#endif /* CONFIG_IMU_CODEC && !CONFIG_IMU_CODEC_CACHE */
+    if (n == 0 && pos < tx_avail()) {
+        net_buf_unref(buf);
+        return -EMSGSIZE;
+    }
+
+    net_buf_add(buf, len);
+    hdr->seq = sys_cpu_to_le16(engine.bulk_seq);
+    hdr->count = n;
+
+    size_t sdu_len = buf->len;
+    int err = l2cap_bulk_send(buf);
+    if (err) {
+        return err;
+    }
+
+    telemetry_sent(n, sdu_len);
+    tx_cursor_advance(&engine.bulk_cursor, pos, n);
+    engine.bulk_seq++;
+#if defined(CONFIG_IMU_CODEC) && !defined(CONFIG_IMU_CODEC_CACHE)
+    engine.bulk_codec = codec;
+#endif /* CONFIG_IMU_CODEC && !CONFIG_IMU_CODEC_CACHE */
+    return n ? 0 : -ENODATA;
+}
+
+/**
+ * @brief End the bulk transfer and resume notifying its connection.
+ *
+ * The connection's notification cursor continues where the bulk stream
+ * stopped, so nothing it already got over L2CAP is notified again.
+ */
+static void tx_bulk_end(void)
+{
+    struct bt_conn *conn = engine.bulk->conn;
+
+    if (conn && engine.bulk_cursor.synced) {
+        tx_conn_t *c = &engine.conns[bt_conn_index(conn)];
+
+        if (c->conn) {
+            c->cursor = engine.bulk_cursor;
+        }
+    }
+#if defined(CONFIG_IMU_CODEC_CACHE)
+    /* The notification decoder missed what went over L2CAP */
+    engine.keyframe_due = true;
+#endif /* CONFIG_IMU_CODEC_CACHE */
+    engine.bulk = NULL;
+}
+
+/**
+ * @brief Keep the bulk channel busy until the backlog is drained.
+ *
+ * Ends the transfer after the end marker or on a hard error, handing live
+ * samples back to the notification path.
+ */
+static void tx_bulk_drain(void)
+{
+    while (engine.bulk) {
+        mem_cache_pin();
+        int err = tx_bulk_send_next();
+        if (err == 0) {
+            tx_release();
+        }
+        mem_cache_unpin();
+
+        if (err == 0) {
+            continue;
+        }
+        if (err == -ENOMEM || err == -EAGAIN) {
+            /* Resumed by the SDU sent callback, the flash tier or a subscriber */
+            break;
+        }
+        if (err == -ENODATA) {
+            LOG_INF("Bulk transfer complete, next seq %u", engine.bulk_seq);
+        } else {
+            LOG_WRN("Bulk transfer aborted (err %d)", err);
+        }
+        tx_bulk_end();
+    }
+}
+#endif /* CONFIG_L2CAP_BULK */
+
+/**
+ * @brief Queue the next notification for one connection.
+ *
+ * Pending alerts go first, also to a connection fed through the bulk
+ * channel, whose live samples are part of the bulk stream.
+ *
+ * @param c The connection slot to notify.
+ * @return 0 on success, -ENODATA if it is caught up, or a negative error
+ *         code from bt_gatt_notify_cb().
+ */
+static int tx_conn_send(tx_conn_t *c)
+{
+#if defined(CONFIG_MEM_CACHE_ALERT)
+    /* Alerts overtake retransmissions and the backlog */
+    int alert_err = tx_alert_send_next(c);
+    if (alert_err != -ENODATA) {
+        return alert_err;
+    }
+    if (tx_alert_reserved(c)) {
+        return -ENODATA;
+    }
+#endif /* CONFIG_MEM_CACHE_ALERT */
+    if (tx_is_bulk(c)) {
+        return -ENODATA;
+    }
+#if defined(CONFIG_TX_SYNC_CONN_EVENT)
+    if (!tx_sync_open(c)) {
+        /* Held back for the next connection event */
+        return -ENODATA;
+    }
+#endif /* CONFIG_TX_SYNC_CONN_EVENT */
+
+    /* Samples are read in place until released */
+    mem_cache_pin();
+#if defined(CONFIG_TX_RETRANSMIT)
+    /* Requested retransmissions go out ahead of new samples */
+    int err = tx_retx_send_next(c);
+    if (err == -ENODATA) {
+        err = tx_send_next(c);
+    }
+#else
+    int err = tx_send_next(c);
+#endif /* CONFIG_TX_RETRANSMIT */
+    if (err == 0) {
+        tx_release();
+#if defined(CONFIG_TX_SYNC_CONN_EVENT)
+        c->budget--;
+#endif /* CONFIG_TX_SYNC_CONN_EVENT */
+    }
+    mem_cache_unpin();
+
+    return err;
+}
+
+/**
+ * @brief Drain work handler.
+ *
+ * Serves the subscribed connections round-robin, one notification each
+ * per pass, while they have credits and samples they have not seen yet.
+ * Alerts are sent to a connection ahead of anything else.
+ * Partial batches only go out on a pass started by tx_engine_flush().
+ * With CONFIG_TX_SYNC_CONN_EVENT everything but alerts waits for the
+ * connection's window.
+ * Running out of credits or controller buffers is not an error: the next
+ * completion callback resubmits the work. Without any subscriber the
+ * oldest samples are spilled to the flash tier instead.
+ *
+ * @param work Pointer to the work item.
+ */
+static void tx_engine_work_handler(struct k_work *work)
+{
+    uint32_t start = k_cycle_get_32();
+    uint32_t idle = 0;
+    bool progress;
+
+    k_mutex_lock(&engine.lock, K_FOREVER);
+
+#if defined(CONFIG_TX_BATCHING)
+    engine.flushing = atomic_clear(&engine.flush);
+#endif /* CONFIG_TX_BATCHING */
+
+#if defined(CONFIG_L2CAP_BULK)
+    tx_bulk_drain();
+#endif /* CONFIG_L2CAP_BULK */
+
+#if defined(CONFIG_FLASH_TIER)
+    if (!tx_active()) {
+        flash_tier_spill();
+    }
+#endif /* CONFIG_FLASH_TIER */
+
+    do {
+        progress = false;
+
+        for (size_t i = 0; i < ARRAY_SIZE(engine.conns); i++) {
+            tx_conn_t *c = &engine.conns[i];
+
+            if ((idle & BIT(i)) || !c->conn || atomic_get(&c->credits) <= 0) {
+                continue;
+            }
+
+            /* Samples stay pending on failure, tx_notify() counts the error */
+            if (tx_conn_send(c) == 0) {
+                progress = true;
+                continue;
+            }
+
+            idle |= BIT(i);
+        }
+    } while (progress);
+
+    k_mutex_unlock(&engine.lock);
+
+    uint32_t cycles = k_cycle_get_32() - start;
+
+    telemetry_cycles(TELEMETRY_HIST_TX, cycles);
+#if defined(CONFIG_PROFILE)
+    profile_cpu(PROFILE_CPU_TX, cycles);
+#endif /* CONFIG_PROFILE */
+}
+
+#if defined(CONFIG_TX_SYNC_CONN_EVENT)
+/**
+ * @brief Window work handler.
+ *
+ * Opens the connection's window with the budget of one event and fills
+ * it right away; completions during the event may top it up. A window
+ * that used up its budget, or found every credit still in flight, means
+ * a backlog and the next event gets a window too. Otherwise only the
+ * periodic window is scheduled, which also sends partial batches.
+ *
+ * @param work Pointer to the work item.
+ */
+static void tx_sync_window_handler(struct k_work *work)
+{
+    struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+    tx_conn_t *c = CONTAINER_OF(dwork, tx_conn_t, window);
+    int64_t now = k_uptime_ticks();
+
+    k_mutex_lock(&engine.lock, K_FOREVER);
+    if (!c->conn) {
+        k_mutex_unlock(&engine.lock);
+        return;
+    }
+
+    c->budget = tx_sync_capacity(c);
+    if (now >= c->next_flush) {
+        c->next_flush = now + k_ms_to_ticks_ceil64(engine.tx_interval_ms);
+#if defined(CONFIG_TX_BATCHING)
+        atomic_set(&engine.flush, 1);
+#endif /* CONFIG_TX_BATCHING */
+    }
+    k_mutex_unlock(&engine.lock);
+
+    /* Same queue as the drain work, so the two never run concurrently */
+    tx_engine_work_handler(&engine.work);
+
+    k_mutex_lock(&engine.lock, K_FOREVER);
+    if (c->conn) {
+        tx_sync_schedule(c, c->budget == 0 || atomic_get(&c->credits) <= 0);
+    }
+    k_mutex_unlock(&engine.lock);
+}
+#endif /* CONFIG_TX_SYNC_CONN_EVENT */
+
+
+#if defined(CONFIG_TX_SYNC_CONN_EVENT)
+/******************************************************************************
+ * Connection Callbacks
+ ******************************************************************************/
+
+/**
+ * @brief Connection parameters updated callback.
+ *
+ * The event phase moves with the new interval; the next completion
+ * corrects the anchor.
+ *
+ * @param conn     The connection object.
+ * @param interval Connection interval in 1.25 ms units.
+ * @param latency  Peripheral latency.
+ * @param timeout  Supervision timeout in 10 ms units.
+ */
+static void tx_sync_param_updated(struct bt_conn *conn, uint16_t interval,
+                                  uint16_t latency, uint16_t timeout)
+{
+    ARG_UNUSED(latency);
+    ARG_UNUSED(timeout);
+
+    k_mutex_lock(&engine.lock, K_FOREVER);
+    engine.conns[bt_conn_index(conn)].interval_us = interval * 1250U;
+    k_mutex_unlock(&engine.lock);
+}
+
+/**
+ * @brief PHY updated callback.
+ *
+ * @param conn  The connection object.
+ * @param param The new PHY.
+ */
+static void tx_sync_phy_updated(struct bt_conn *conn, struct bt_conn_le_phy_info *param)
+{
+    k_mutex_lock(&engine.lock, K_FOREVER);
+    engine.conns[bt_conn_index(conn)].phy = param->tx_phy;
+    k_mutex_unlock(&engine.lock);
+}
+
+/**
+ * @brief Data length updated callback.
+ *
+ * @param conn The connection object.
+ * @param info The new data length.
+ */
+static void tx_sync_data_len_updated(struct bt_conn *conn, struct bt_conn_le_data_len_info *info)
+{
+    k_mutex_lock(&engine.lock, K_FOREVER);
+    engine.conns[bt_conn_index(conn)].tx_max_len = info->tx_max_len;
+    k_mutex_unlock(&engine.lock);
+}
+
+BT_CONN_CB_DEFINE(tx_sync_callbacks) = {
+    .le_param_updated = tx_sync_param_updated,
+    .le_phy_updated = tx_sync_phy_updated,
+    .le_data_len_updated = tx_sync_data_len_updated,
+};
+#endif /* CONFIG_TX_SYNC_CONN_EVENT */
+
+
+/******************************************************************************
+ * Public API
+ ******************************************************************************/
+
+/**
+ * @brief Start serving a subscribed connection.
+ *
+ * @param conn The connection to notify.
+ */
+void tx_engine_start(struct bt_conn *conn)
+{
+    tx_conn_t *c = &engine.conns[bt_conn_index(conn)];
+
+    k_mutex_lock(&engine.lock, K_FOREVER);
+
+    if (c->conn) {
+        bt_conn_unref(c->conn);
+    }
+    c->conn = bt_conn_ref(conn);
+    atomic_inc(&c->generation);
+    /* A new subscriber starts at the oldest sample still cached */
+    c->cursor.synced = false;
+    c->seq = 0;
+#if defined(CONFIG_MEM_CACHE_ALERT)
+    /* and at the oldest alert nobody has been sent */
+    c->alert_cursor.synced = false;
+#endif /* CONFIG_MEM_CACHE_ALERT */
+#if defined(CONFIG_IMU_CODEC) && !defined(CONFIG_IMU_CODEC_CACHE)
+    /* A new subscriber has no decoder state, start with a keyframe */
+    imu_codec_reset(&c->codec);
+#elif defined(CONFIG_IMU_CODEC_CACHE)
+    /* The cached chain goes on, only its first record is re-encoded */
+    engine.keyframe_due = true;
+#endif /* CONFIG_IMU_CODEC && !CONFIG_IMU_CODEC_CACHE */
+    atomic_set(&c->credits, CONFIG_TX_ENGINE_CREDITS);
+#if defined(CONFIG_PROFILE)
+    /* Completions of the previous subscription are ignored, so are their spans */
+    profile_link_reset(bt_conn_index(conn));
+#endif /* CONFIG_PROFILE */
+#if defined(CONFIG_TX_RETRANSMIT)
+    /* Requests of a previous subscription are void */
+    tx_retx_drop(bt_conn_index(conn));
+#endif /* CONFIG_TX_RETRANSMIT */
+#if defined(CONFIG_TX_SYNC_CONN_EVENT)
+    struct bt_conn_info info;
+
+    c->interval_us = 0;
+    c->phy = BT_GAP_LE_PHY_1M;
+    c->tx_max_len = TX_SYNC_DEFAULT_TX_LEN;
+    if (bt_conn_get_info(conn, &info) == 0) {
+        c->interval_us = info.le.interval * 1250U;
+        c->phy = info.le.phy->tx_phy;
+        c->tx_max_len = info.le.data_len->tx_max_len;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&engine.sync_lock);
+
+    /* No event seen yet, any phase will do until the first completion */
+    c->anchor = k_uptime_ticks();
+    k_spin_unlock(&engine.sync_lock, key);
+
+    c->budget = 0;
+    c->next_flush = c->anchor;
+    tx_sync_schedule(c, true);
+#endif /* CONFIG_TX_SYNC_CONN_EVENT */
+
+    k_mutex_unlock(&engine.lock);
+
+    tx_engine_kick();
+}
+
+/**
+ * @brief Stop serving a connection and release its reference.
+ *
+ * Notifications already queued still complete, but their callbacks no
+ * longer return credits since the generation has moved on. Samples only
+ * this connection was still holding are released.
+ *
+ * @param conn The connection to stop notifying.
+ */
+void tx_engine_stop(struct bt_conn *conn)
+{
+    tx_conn_t *c = &engine.conns[bt_conn_index(conn)];
+
+    k_mutex_lock(&engine.lock, K_FOREVER);
+
+    if (c->conn) {
+        bt_conn_unref(c->conn);
+        c->conn = NULL;
+    }
+    atomic_inc(&c->generation);
+#if defined(CONFIG_TX_RETRANSMIT)
+    tx_retx_drop(bt_conn_index(conn));
+#endif /* CONFIG_TX_RETRANSMIT */
+#if defined(CONFIG_TX_SYNC_CONN_EVENT)
+    k_work_cancel_delayable(&c->window);
+#endif /* CONFIG_TX_SYNC_CONN_EVENT */
+
+    mem_cache_pin();
+    if (tx_active() && tx_source_select() == 0) {
+        tx_release();
+    }
+    mem_cache_unpin();
+
+    k_mutex_unlock(&engine.lock);
+}
+
+#if defined(CONFIG_L2CAP_BULK)
+/**
+ * @brief Stream the backlog over an L2CAP channel instead of notifying.
+ *
+ * @param chan The connected bulk channel.
+ * @param seq  Sequence number of the first SDU.
+ */
+void tx_engine_bulk_start(struct bt_l2cap_chan *chan, uint16_t seq)
+{
+    k_mutex_lock(&engine.lock, K_FOREVER);
+
+    engine.bulk = chan;
+    engine.bulk_seq = seq;
+    engine.bulk_cursor.synced = false;
+#if defined(CONFIG_IMU_CODEC) && !defined(CONFIG_IMU_CODEC_CACHE)
+    imu_codec_reset(&engine.bulk_codec);
+#elif defined(CONFIG_IMU_CODEC_CACHE)
+    engine.keyframe_due = true;
+#endif /* CONFIG_IMU_CODEC && !CONFIG_IMU_CODEC_CACHE */
+
+    k_mutex_unlock(&engine.lock);
+
+    LOG_INF("Bulk transfer started at seq %u", seq);
+    tx_engine_kick();
+}
+
+/**
+ * @brief Stop a bulk transfer and return to notifications.
+ */
+void tx_engine_bulk_stop(void)
+{
+    k_mutex_lock(&engine.lock, K_FOREVER);
+    if (engine.bulk) {
+        tx_bulk_end();
+    }
+    k_mutex_unlock(&engine.lock);
+
+    tx_engine_kick();
+}
+
+/**
+ * @brief Get the bulk transfer state.
+ *
+ * @param next_seq Set to the sequence number of the next bulk SDU.
+ * @return true while a bulk transfer is running.
+ */
+bool tx_engine_bulk_status(uint16_t *next_seq)
+{
+    k_mutex_lock(&engine.lock, K_FOREVER);
+
+    bool active = (engine.bulk != NULL);
+
+    *next_seq = engine.bulk_seq;
+    k_mutex_unlock(&engine.lock);
+
+    return active;
+}
+#endif /* CONFIG_L2CAP_BULK */
+
+#if defined(CONFIG_TX_RETRANSMIT)
+/**
+ * @brief Set the characteristic retransmitted samples are notified on.
+ *
+ * @param attr The retransmit characteristic value attribute.
+ */
+void tx_engine_retransmit_init(const struct bt_gatt_attr *attr)
+{
+    engine.retx_attr = attr;
+}
+
+/**
+ * @brief Queue a range of samples for retransmission.
+ *
+ * @param conn  The requesting connection.
+ * @param first Sequence number of the first sample.
+ * @param count Number of consecutive sequence numbers.
+ * @return 0 on success, -EINVAL for an empty range, -ERANGE if the range
+ *         was not sent to @p conn yet or has left the retained window, or
+ *         -ENOMEM if too many requests are pending.
+ */
+int tx_engine_retransmit(struct bt_conn *conn, uint32_t first, uint32_t count)
+{
+    uint8_t slot = bt_conn_index(conn);
+    const tx_conn_t *c = &engine.conns[slot];
+    int err = 0;
+
+    if (count == 0) {
+        return -EINVAL;
+    }
+
+    k_mutex_lock(&engine.lock, K_FOREVER);
+
+    /* Sequence numbers wrap, compare by distance */
+    if (!c->conn || !c->cursor.synced ||
+        (int32_t)(c->cursor.last_seq - (first + count - 1)) < 0 ||
+        (engine.retained_n && (int32_t)(first - engine.retained_oldest) < 0)) {
+        err = -ERANGE;
+    } else if (engine.retx_n == ARRAY_SIZE(engine.retx)) {
+        err = -ENOMEM;
+    } else {
+        engine.retx[engine.retx_n++] = (tx_retx_range_t){
+            .slot = slot,
+            .first = first,
+            .count = count,
+        };
+    }
+
+    k_mutex_unlock(&engine.lock);
+
+    if (!err) {
+        tx_engine_kick();
+    }
+
+    return err;
+}
+#endif /* CONFIG_TX_RETRANSMIT */
+
+#if defined(CONFIG_MEM_CACHE_ALERT)
+/**
+ * @brief Set the characteristic alerts are notified on.
+ *
+ * @param attr The alert characteristic value attribute.
+ */
+void tx_engine_alert_init(const struct bt_gatt_attr *attr)
+{
+    engine.alert_attr = attr;
+}
+#endif /* CONFIG_MEM_CACHE_ALERT */
+
+/**
+ * @brief Signal that new samples may be available.
+ */
+void tx_engine_kick(void)
+{
+    k_work_submit_to_queue(&engine.workq, &engine.work);
+}
+
+/**
+ * @brief Send partially filled batches on the next pass.
+ */
+void tx_engine_flush(void)
+{
+#if defined(CONFIG_TX_BATCHING)
+    atomic_set(&engine.flush, 1);
+#endif /* CONFIG_TX_BATCHING */
+    tx_engine_kick();
+}
+
+/**
+ * @brief Adapt the batch size and window period to the sample and transmit rates.
+ *
+ * @param sample_interval_us Sensor sampling interval in microseconds.
+ * @param tx_interval_ms     Transmit interval in milliseconds.
+ */
+void tx_engine_configure(uint32_t sample_interval_us, uint32_t tx_interval_ms)
+{
+#if defined(CONFIG_TX_SYNC_CONN_EVENT)
+    /* Picked up when the next periodic window is scheduled */
+    k_mutex_lock(&engine.lock, K_FOREVER);
+    engine.tx_interval_ms = tx_interval_ms;
+    k_mutex_unlock(&engine.lock);
+#endif /* CONFIG_TX_SYNC_CONN_EVENT */
+#if defined(CONFIG_TX_BATCHING)
+    uint64_t per_tick = (uint64_t)tx_interval_ms * USEC_PER_MSEC / sample_interval_us;
+    size_t target = CLAMP(per_tick, 1, TX_MAX_RECORDS);
+
+    k_mutex_lock(&engine.lock, K_FOREVER);
+    engine.batch_target = target;
+    k_mutex_unlock(&engine.lock);
+
+    LOG_INF("Batch target %u samples", (unsigned int)target);
+#else
+    ARG_UNUSED(sample_interval_us);
+    ARG_UNUSED(tx_interval_ms);
+#endif /* CONFIG_TX_BATCHING */
+}
+
+/**
+ * @brief Initialize the TX engine and start its work queue.
+ *
+ * @param attr The characteristic value attribute samples are notified on.
+ */
+void tx_engine_init(const struct bt_gatt_attr *attr)
+{
+    const struct k_work_queue_config cfg = {
+        .name = "tx_engine",
+    };
+
+    engine.attr = attr;
+    k_mutex_init(&engine.lock);
+#if defined(CONFIG_IMU_CODEC_CACHE)
+    imu_codec_reset(&engine.chain);
+#endif /* CONFIG_IMU_CODEC_CACHE */
+    tx_engine_configure(CONFIG_SAMPLE_INTERVAL_US, CONFIG_TRANSMIT_INTERVAL_MS);
+    k_work_init(&engine.work, tx_engine_work_handler);
+#if defined(CONFIG_TX_SYNC_CONN_EVENT)
+    for (size_t i = 0; i < ARRAY_SIZE(engine.conns); i++) {
+        k_work_init_delayable(&engine.conns[i].window, tx_sync_window_handler);
+    }
+#endif /* CONFIG_TX_SYNC_CONN_EVENT */
+    k_work_queue_init(&engine.workq);
+    k_work_queue_start(&engine.workq, tx_engine_stack,
+                       K_THREAD_STACK_SIZEOF(tx_engine_stack),
+                       CONFIG_TX_ENGINE_PRIORITY, &cfg);
+
+    LOG_INF("TX engine initialized (%d credits, %d connections)",
+            CONFIG_TX_ENGINE_CREDITS, CONFIG_BT_MAX_CONN);
+}
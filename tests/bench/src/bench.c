@@ -0,0 +1,48 @@
+#include <string.h>
+#include "bench.h"
+
+/**
+ * @brief Fill a sample with random payload.
+ *
+ * @param sample Sample to fill.
+ * @param seq    Sequence number to stamp it with.
+ * @param rng    Generator state.
+ */
+void bench_sample_fill(sensor_sample_t *sample, uint32_t seq, uint32_t *rng)
+{
+    sample->hdr.seq = seq;
+    sample->hdr.timestamp = seq * 5;
+
+    for (int i = 0; i < IMU_SAMPLE_LEN; i++) {
+        sample->imu[i] = bench_rand(rng) & BENCH_IMU_MASK;
+    }
+
+    for (int i = 0; i < TEMP_SAMPLE_LEN; i++) {
+#if defined(CONFIG_SAMPLE_FORMAT_COMPACT)
+        sample->temp[i] = (uint16_t)bench_rand(rng);
+#else
+        sample->temp[i] = (sample_temp_t)(bench_rand(rng) % 1000) / 10;
+#endif /* CONFIG_SAMPLE_FORMAT_COMPACT */
+    }
+}
+
+/**
+ * @brief Release everything left in the cache.
+ */
+void bench_cache_drain(void)
+{
+    mem_cache_commit_pop_n(mem_cache_count());
+}
+
+/**
+ * @brief Get the overflow counters as a single loss count.
+ *
+ * @return Samples dropped plus samples decimated so far.
+ */
+uint32_t bench_cache_lost(void)
+{
+    mem_cache_stats_t stats;
+
+    mem_cache_get_stats(&stats);
+    return stats.dropped + stats.decimated;
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <stdint.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+#include "mem_cache.h"
+
+/*
+ * Results are printed as "BENCH <backend> <name> <value> <unit>" lines so
+ * a CI job can grep them out of the twister log and compare builds.
+ *
+ * Timings come from k_cycle_get_32(). On native_sim code runs in zero
+ * simulated time, so cycle counts there only show the benchmark ran;
+ * compare numbers from qemu_cortex_m3 or hardware.
+ */
+
+#if defined(CONFIG_MEM_CACHE_BACKEND_ARENA)
+#define BENCH_BACKEND "arena"
+#elif defined(CONFIG_MEM_CACHE_BACKEND_SPSC)
+#define BENCH_BACKEND "spsc"
+#elif defined(CONFIG_MEM_CACHE_BACKEND_SLAB)
+#define BENCH_BACKEND "slab"
+#else
+#define BENCH_BACKEND "mutex"
+#endif /* CONFIG_MEM_CACHE_BACKEND_ARENA */
+
+/* IMU words the generators produce fit the field of both sample formats */
+#if defined(CONFIG_SAMPLE_FORMAT_COMPACT)
+#define BENCH_IMU_MASK 0x0FFF
+#else
+#define BENCH_IMU_MASK 0xFFFFFFFF
+#endif /* CONFIG_SAMPLE_FORMAT_COMPACT */
+
+/**
+ * @brief Print one benchmark result.
+ *
+ * @param name  Result name, unique per backend.
+ * @param value Measured value.
+ * @param unit  Unit of @p value.
+ */
+#define BENCH_REPORT(name, value, unit) \
+    TC_PRINT("BENCH %s %s %u %s\n", BENCH_BACKEND, name, (unsigned int)(value), unit)
+
+/**
+ * @brief Deterministic xorshift32 generator, so failures reproduce.
+ *
+ * @param state Generator state, never 0.
+ * @return Next pseudo-random value.
+ */
+static inline uint32_t bench_rand(uint32_t *state)
+{
+    uint32_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+
+    return x;
+}
+
+/**
+ * @brief Fill a sample with random payload.
+ *
+ * @param sample Sample to fill.
+ * @param seq    Sequence number to stamp it with.
+ * @param rng    Generator state.
+ */
+void bench_sample_fill(sensor_sample_t *sample, uint32_t seq, uint32_t *rng);
+
+/**
+ * @brief Release everything left in the cache.
+ */
+void bench_cache_drain(void);
+
+/**
+ * @brief Get the overflow counters as a single loss count.
+ *
+ * @return Samples dropped plus samples decimated so far.
+ */
+uint32_t bench_cache_lost(void);
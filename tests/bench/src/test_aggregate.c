@@ -0,0 +1,352 @@
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include "aggregate.h"
+#include "mem_cache.h"
+
+
+/******************************************************************************
+ * Macro
+ ******************************************************************************/
+
+#define AGG_CHANNELS CONFIG_AGGREGATE_CHANNELS
+#define AGG_FRAMES   (IMU_SAMPLE_LEN / AGG_CHANNELS)
+
+/* Largest burst fed at once */
+#define AGG_BURST 12
+
+/* Readings stay small so float sums of squares in the legacy format are exact */
+#define AGG_READING_MAX 200
+
+
+/******************************************************************************
+ * Static Variables
+ ******************************************************************************/
+
+static sensor_sample_t burst[AGG_BURST];
+static sensor_sample_t raw[AGG_BURST];
+static uint32_t next_sample = 1000;   /* Apart from the records, as after summary mode */
+static uint32_t next_record;
+
+
+/******************************************************************************
+ * Helpers
+ ******************************************************************************/
+
+/**
+ * @brief Fill a burst with numbered samples and keep a copy of it.
+ *
+ * @param n Number of samples, at most AGG_BURST.
+ */
+static void agg_make_burst(size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        sensor_sample_t *s = &burst[i];
+        uint32_t seq = next_sample++;
+
+        memset(s, 0, sizeof(*s));
+        s->hdr.seq = seq;
+        s->hdr.timestamp = seq * 1000U;
+        for (int w = 0; w < IMU_SAMPLE_LEN; w++) {
+            s->imu[w] = (seq * 7U + w * 13U) % AGG_READING_MAX;
+        }
+        memset(s->temp, (int)seq, sizeof(s->temp));
+    }
+
+    memcpy(raw, burst, n * sizeof(raw[0]));
+}
+
+/**
+ * @brief Summarize raw samples with a plain loop.
+ *
+ * @param ref     Expected summary.
+ * @param samples Raw samples of the window, oldest first.
+ * @param n       Number of samples.
+ */
+static void agg_summary_ref(sensor_sample_t *ref, const sensor_sample_t *samples, size_t n)
+{
+    uint32_t frames = n * AGG_FRAMES;
+
+    memset(ref, 0, sizeof(*ref));
+    ref->hdr.timestamp = samples[n - 1].hdr.timestamp;
+    memcpy(ref->temp, samples[n - 1].temp, sizeof(ref->temp));
+
+    for (int c = 0; c < AGG_CHANNELS; c++) {
+        uint32_t min = UINT32_MAX;
+        uint32_t max = 0;
+        uint64_t sum = 0;
+        double sumsq = 0;
+
+        for (size_t s = 0; s < n; s++) {
+            for (int f = 0; f < AGG_FRAMES; f++) {
+                uint32_t v = samples[s].imu[f * AGG_CHANNELS + c];
+
+                min = MIN(min, v);
+                max = MAX(max, v);
+                sum += v;
+                sumsq += (double)v * v;
+            }
+        }
+
+        ref->imu[AGGREGATE_IMU_MIN + c] = min;
+        ref->imu[AGGREGATE_IMU_MAX + c] = max;
+        ref->imu[AGGREGATE_IMU_MEAN + c] = (sum + frames / 2) / frames;
+        ref->imu[AGGREGATE_IMU_RMS + c] = MIN((uint32_t)(sqrt(sumsq / frames) + 0.5), max);
+    }
+    ref->imu[AGGREGATE_IMU_COUNT] = n;
+}
+
+/**
+ * @brief Feed the burst and check the records come back numbered on.
+ *
+ * @param n Number of samples in the burst.
+ * @return Number of records.
+ */
+static size_t agg_feed(size_t n)
+{
+    size_t records = aggregate_feed(burst, n, next_record);
+
+    for (size_t i = 0; i < records; i++) {
+        zassert_equal(burst[i].hdr.seq, next_record + i, "record %zu seq %u, expected %u", i,
+                      burst[i].hdr.seq, next_record + (uint32_t)i);
+    }
+    next_record += records;
+
+    return records;
+}
+
+/**
+ * @brief Check a summary against the reference of its raw samples.
+ *
+ * The sequence number is checked by agg_feed() or the caller.
+ *
+ * @param summary Summary produced by the aggregation stage.
+ * @param samples Raw samples of the window, oldest first.
+ * @param n       Number of samples.
+ */
+static void agg_check(const sensor_sample_t *summary, const sensor_sample_t *samples, size_t n)
+{
+    sensor_sample_t ref;
+
+    agg_summary_ref(&ref, samples, n);
+
+    zassert_equal(summary->hdr.timestamp, ref.hdr.timestamp, "summary timestamp");
+    zassert_mem_equal(summary->temp, ref.temp, sizeof(ref.temp), "summary temperatures");
+    for (int w = 0; w < IMU_SAMPLE_LEN; w++) {
+        zassert_equal(summary->imu[w], ref.imu[w], "seq %u word %d: %u, expected %u",
+                      summary->hdr.seq, w, summary->imu[w], ref.imu[w]);
+    }
+}
+
+/**
+ * @brief Switch mode and apply it with an empty burst.
+ *
+ * @param mode   AGGREGATE_MODE_*.
+ * @param window Samples per summary.
+ */
+static void agg_set_mode(uint8_t mode, uint16_t window)
+{
+    bool changed = mode != aggregate_get_mode() || window != aggregate_get_window();
+    uint32_t first_seq;
+    uint32_t expected;
+
+    /* Setting the mode in effect again keeps its records where they start */
+    aggregate_get_stored_mode(&expected);
+    if (changed) {
+        expected = next_record;
+    }
+
+    zassert_ok(aggregate_set_mode(mode, window), "mode %u window %u rejected", mode, window);
+    zassert_equal(agg_feed(0), 0, "empty burst returned records");
+    zassert_equal(aggregate_get_stored_mode(&first_seq), mode, "mode %u not applied", mode);
+    zassert_equal(first_seq, expected, "mode %u starts at %u, expected %u", mode, first_seq,
+                  expected);
+}
+
+/**
+ * @brief Give the kept copy of the burst the record numbers it is stored with.
+ *
+ * @param n Number of samples.
+ */
+static void agg_number_raw(size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        raw[i].hdr.seq = next_record - n + i;
+    }
+}
+
+
+/******************************************************************************
+ * Tests
+ ******************************************************************************/
+
+/**
+ * @brief Start every test in raw mode with the window discarded.
+ */
+static void aggregate_before(void *fixture)
+{
+    ARG_UNUSED(fixture);
+
+    agg_set_mode(AGGREGATE_MODE_RAW, CONFIG_AGGREGATE_WINDOW);
+}
+
+/**
+ * @brief Raw mode hands the burst on, only renumbered.
+ */
+ZTEST(aggregate, test_raw)
+{
+    agg_make_burst(AGG_BURST);
+
+    zassert_equal(agg_feed(AGG_BURST), AGG_BURST, "raw mode dropped samples");
+    agg_number_raw(AGG_BURST);
+    zassert_mem_equal(burst, raw, sizeof(burst), "raw mode changed the burst");
+}
+
+/**
+ * @brief Summaries replace the samples of their window in place.
+ */
+ZTEST(aggregate, test_summary_in_place)
+{
+    agg_set_mode(AGGREGATE_MODE_SUMMARY, 4);
+    agg_make_burst(AGG_BURST);
+
+    zassert_equal(agg_feed(AGG_BURST), 3, "expected one summary per 4 samples");
+    for (size_t i = 0; i < 3; i++) {
+        agg_check(&burst[i], &raw[i * 4], 4);
+    }
+}
+
+/**
+ * @brief A window keeps filling across bursts.
+ */
+ZTEST(aggregate, test_summary_spans_bursts)
+{
+    sensor_sample_t window[5];
+
+    agg_set_mode(AGGREGATE_MODE_SUMMARY, 5);
+
+    agg_make_burst(3);
+    memcpy(window, raw, 3 * sizeof(raw[0]));
+    zassert_equal(agg_feed(3), 0, "window closed early");
+
+    agg_make_burst(3);
+    memcpy(&window[3], raw, 2 * sizeof(raw[0]));
+    zassert_equal(agg_feed(3), 1, "window did not close");
+    agg_check(&burst[0], window, 5);
+
+    /* The third sample of the burst opened the next window */
+    window[0] = raw[2];
+    agg_make_burst(4);
+    memcpy(&window[1], raw, 4 * sizeof(raw[0]));
+    zassert_equal(agg_feed(4), 1, "second window did not close");
+    agg_check(&burst[0], window, 5);
+}
+
+/**
+ * @brief Mean and RMS round to the nearest reading, RMS never above the maximum.
+ */
+ZTEST(aggregate, test_rounding)
+{
+    agg_set_mode(AGGREGATE_MODE_SUMMARY, 2);
+
+    /* 0 then 3 everywhere: mean 1.5 rounds up, RMS sqrt(4.5) = 2.12 rounds down */
+    agg_make_burst(2);
+    for (int w = 0; w < IMU_SAMPLE_LEN; w++) {
+        burst[0].imu[w] = 0;
+        burst[1].imu[w] = 3;
+    }
+    zassert_equal(agg_feed(2), 1, "window of 2 did not close");
+    for (int c = 0; c < AGG_CHANNELS; c++) {
+        zassert_equal(burst[0].imu[AGGREGATE_IMU_MIN + c], 0, "channel %d min", c);
+        zassert_equal(burst[0].imu[AGGREGATE_IMU_MAX + c], 3, "channel %d max", c);
+        zassert_equal(burst[0].imu[AGGREGATE_IMU_MEAN + c], 2, "channel %d mean", c);
+        zassert_equal(burst[0].imu[AGGREGATE_IMU_RMS + c], 2, "channel %d rms", c);
+    }
+    zassert_equal(burst[0].imu[AGGREGATE_IMU_COUNT], 2, "sample count");
+
+    /* 0 then 4: RMS sqrt(8) = 2.83 rounds up */
+    agg_make_burst(2);
+    for (int w = 0; w < IMU_SAMPLE_LEN; w++) {
+        burst[0].imu[w] = 0;
+        burst[1].imu[w] = 4;
+    }
+    zassert_equal(agg_feed(2), 1, "window of 2 did not close");
+    zassert_equal(burst[0].imu[AGGREGATE_IMU_MEAN], 2, "mean of 0 and 4");
+    zassert_equal(burst[0].imu[AGGREGATE_IMU_RMS], 3, "rms of 0 and 4");
+
+    /* A constant full-scale reading: the float RMS must not exceed it */
+    agg_make_burst(2);
+    for (int w = 0; w < IMU_SAMPLE_LEN; w++) {
+        burst[0].imu[w] = 4095;
+        burst[1].imu[w] = 4095;
+    }
+    zassert_equal(agg_feed(2), 1, "window of 2 did not close");
+    for (int c = 0; c < AGG_CHANNELS; c++) {
+        zassert_equal(burst[0].imu[AGGREGATE_IMU_RMS + c], 4095, "channel %d rms", c);
+    }
+}
+
+/**
+ * @brief Hybrid mode keeps the burst and publishes the summary.
+ */
+ZTEST(aggregate, test_hybrid)
+{
+    sensor_sample_t summary;
+
+    agg_set_mode(AGGREGATE_MODE_HYBRID, 6);
+    agg_make_burst(AGG_BURST);
+
+    zassert_equal(agg_feed(AGG_BURST), AGG_BURST, "hybrid mode dropped samples");
+    agg_number_raw(AGG_BURST);
+    zassert_mem_equal(burst, raw, sizeof(burst), "hybrid mode changed the burst");
+    zassert_true(aggregate_get_summary(&summary), "no summary published");
+    agg_check(&summary, &raw[6], 6);
+
+    /* Summaries are numbered on their own, without gaps */
+    uint32_t seq = summary.hdr.seq;
+
+    agg_make_burst(AGG_BURST);
+    zassert_equal(agg_feed(AGG_BURST), AGG_BURST, "hybrid mode dropped samples");
+    zassert_true(aggregate_get_summary(&summary), "no summary published");
+    zassert_equal(summary.hdr.seq, seq + 2, "summary seq %u, expected %u", summary.hdr.seq,
+                  seq + 2);
+}
+
+/**
+ * @brief A mode change discards the window in progress.
+ */
+ZTEST(aggregate, test_mode_change)
+{
+    sensor_sample_t window[3];
+
+    agg_set_mode(AGGREGATE_MODE_SUMMARY, 4);
+    agg_make_burst(3);
+    zassert_equal(agg_feed(3), 0, "window closed early");
+
+    /* The three samples above must not count towards the new window */
+    zassert_ok(aggregate_set_mode(AGGREGATE_MODE_SUMMARY, 3), "window 3 rejected");
+    agg_make_burst(3);
+    memcpy(window, raw, sizeof(window));
+    zassert_equal(agg_feed(3), 1, "new window did not close");
+    agg_check(&burst[0], window, 3);
+
+    /* Through raw mode and back, again starting empty */
+    agg_make_burst(2);
+    zassert_equal(agg_feed(2), 0, "window closed early");
+    agg_set_mode(AGGREGATE_MODE_RAW, 3);
+    agg_make_burst(2);
+    zassert_equal(agg_feed(2), 2, "raw mode dropped samples");
+    agg_set_mode(AGGREGATE_MODE_SUMMARY, 3);
+    agg_make_burst(3);
+    memcpy(window, raw, sizeof(window));
+    zassert_equal(agg_feed(3), 1, "window did not close");
+    agg_check(&burst[0], window, 3);
+
+    zassert_equal(aggregate_set_mode(AGGREGATE_MODE_COUNT, 3), -EINVAL, "bad mode accepted");
+    zassert_equal(aggregate_set_mode(AGGREGATE_MODE_SUMMARY, AGGREGATE_WINDOW_MIN - 1), -EINVAL,
+                  "window below the minimum accepted");
+}
+
+ZTEST_SUITE(aggregate, NULL, NULL, aggregate_before, NULL, NULL);
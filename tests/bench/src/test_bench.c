@@ -0,0 +1,158 @@
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+#include "bench.h"
+#include "mem_cache.h"
+
+
+/******************************************************************************
+ * Macro
+ ******************************************************************************/
+
+/* Samples per round, fits every backend at its default size */
+#define BENCH_BATCH   16
+#define BENCH_ROUNDS  256
+#define BENCH_OPS     (BENCH_BATCH * BENCH_ROUNDS)
+
+
+/******************************************************************************
+ * Static Variables
+ ******************************************************************************/
+
+static sensor_sample_t batch[BENCH_BATCH];
+static sensor_sample_t out[BENCH_BATCH];
+
+
+/******************************************************************************
+ * Benchmarks
+ ******************************************************************************/
+
+/**
+ * @brief Fill the batch buffer once, so generating payload is not timed.
+ */
+static void *bench_setup(void)
+{
+    uint32_t rng = 0x1b873593;
+
+    for (size_t i = 0; i < BENCH_BATCH; i++) {
+        bench_sample_fill(&batch[i], i, &rng);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Start every benchmark with an empty cache.
+ */
+static void bench_before(void *fixture)
+{
+    ARG_UNUSED(fixture);
+
+    bench_cache_drain();
+}
+
+/**
+ * @brief Single-sample push and pop.
+ */
+ZTEST(bench, test_push_pop)
+{
+    uint32_t push = 0;
+    uint32_t pop = 0;
+
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        uint32_t t0 = k_cycle_get_32();
+
+        for (size_t i = 0; i < BENCH_BATCH; i++) {
+            zassert_true(mem_cache_push(&batch[i]), "push failed");
+        }
+
+        uint32_t t1 = k_cycle_get_32();
+
+        for (size_t i = 0; i < BENCH_BATCH; i++) {
+            zassert_true(mem_cache_pop(&out[i]), "pop failed");
+        }
+
+        uint32_t t2 = k_cycle_get_32();
+
+        push += t1 - t0;
+        pop += t2 - t1;
+    }
+
+    BENCH_REPORT("push", push / BENCH_OPS, "cycles/sample");
+    BENCH_REPORT("pop", pop / BENCH_OPS, "cycles/sample");
+}
+
+/**
+ * @brief Burst push and pop of BENCH_BATCH samples.
+ */
+ZTEST(bench, test_push_pop_n)
+{
+    uint32_t push = 0;
+    uint32_t pop = 0;
+
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        uint32_t t0 = k_cycle_get_32();
+
+        zassert_equal(mem_cache_push_n(batch, BENCH_BATCH), BENCH_BATCH, "push_n short");
+
+        uint32_t t1 = k_cycle_get_32();
+
+        zassert_equal(mem_cache_pop_n(out, BENCH_BATCH), BENCH_BATCH, "pop_n short");
+
+        uint32_t t2 = k_cycle_get_32();
+
+        push += t1 - t0;
+        pop += t2 - t1;
+    }
+
+    BENCH_REPORT("push_n", push / BENCH_OPS, "cycles/sample");
+    BENCH_REPORT("pop_n", pop / BENCH_OPS, "cycles/sample");
+}
+
+/**
+ * @brief Zero-copy consumer path: pin, peek every sample in place, commit.
+ */
+ZTEST(bench, test_peek_commit)
+{
+    const sensor_sample_t *sample;
+    uint32_t peek = 0;
+
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        zassert_equal(mem_cache_push_n(batch, BENCH_BATCH), BENCH_BATCH, "push_n short");
+
+        uint32_t t0 = k_cycle_get_32();
+
+        mem_cache_pin();
+        for (size_t i = 0; i < BENCH_BATCH; i++) {
+            zassert_true(mem_cache_peek_at(i, &sample), "peek_at failed");
+        }
+        mem_cache_commit_pop_n(BENCH_BATCH);
+        mem_cache_unpin();
+
+        peek += k_cycle_get_32() - t0;
+    }
+
+    BENCH_REPORT("peek_at_commit", peek / BENCH_OPS, "cycles/sample");
+}
+
+/**
+ * @brief mem_cache_count() on a half-full cache.
+ */
+ZTEST(bench, test_count)
+{
+    volatile size_t sink = 0;
+
+    zassert_equal(mem_cache_push_n(batch, BENCH_BATCH), BENCH_BATCH, "push_n short");
+
+    uint32_t t0 = k_cycle_get_32();
+
+    for (int i = 0; i < BENCH_OPS; i++) {
+        sink += mem_cache_count();
+    }
+
+    uint32_t cycles = k_cycle_get_32() - t0;
+
+    zassert_equal(sink, (size_t)BENCH_OPS * BENCH_BATCH, "count changed");
+    BENCH_REPORT("count", cycles / BENCH_OPS, "cycles/call");
+}
+
+ZTEST_SUITE(bench, NULL, bench_setup, bench_before, NULL, NULL);
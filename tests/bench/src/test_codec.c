@@ -0,0 +1,258 @@
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include "bench.h"
+#include "float16.h"
+#include "imu_codec.h"
+
+
+/******************************************************************************
+ * Macro
+ ******************************************************************************/
+
+/* Values converted per timed call */
+#define F16_CHUNK 256
+
+#define CODEC_SAMPLES   4096
+#define CODEC_WALK_STEP 32   /* Largest IMU change between two random-walk samples */
+#define CODEC_FUZZ_RUNS 20000
+
+
+/******************************************************************************
+ * Float16 conversion
+ ******************************************************************************/
+
+#if defined(CONFIG_SAMPLE_FORMAT_LEGACY)
+/**
+ * @brief The ldexp() based conversion the mock sensor used before.
+ *
+ * Reference for the exhaustive check and baseline for the benchmark.
+ *
+ * @param u16 Raw binary16 bits.
+ * @return Converted value.
+ */
+static double uint16_to_double_ref(uint16_t u16)
+{
+    uint16_t sign = (u16 >> 15) & 0x1;
+    uint16_t exp  = (u16 >> 10) & 0x1F;
+    uint16_t mant = u16 & 0x03FF;
+
+    if (exp == 0) {
+        double value = ldexp((double)mant, -24);
+        return sign ? -value : value;
+    }
+
+    if (exp == 31) {
+        return mant ? NAN : (sign ? -INFINITY : INFINITY);
+    }
+
+    double value = ldexp(1.0 + (mant / 1024.0), exp - 15);
+    return sign ? -value : value;
+}
+
+/**
+ * @brief Every binary16 input converts to exactly the reference value.
+ */
+ZTEST(codec, test_float16_exhaustive)
+{
+    for (uint32_t h = 0; h <= UINT16_MAX; h++) {
+        double ref = uint16_to_double_ref(h);
+        double d = float16_to_double(h);
+        float f = float16_to_float(h);
+
+        if (isnan(ref)) {
+            zassert_true(isnan(d) && isnan(f), "0x%04x not NaN", h);
+            continue;
+        }
+        zassert_true(memcmp(&d, &ref, sizeof(d)) == 0, "0x%04x double mismatch", h);
+        zassert_true((double)f == ref && !signbit(f) == !signbit(ref),
+                     "0x%04x float mismatch", h);
+    }
+}
+
+/**
+ * @brief Cycles per value of the reference and both array conversions.
+ */
+ZTEST(codec, test_float16_bench)
+{
+    static uint16_t in[F16_CHUNK];
+    static double out64[F16_CHUNK];
+    static float out32[F16_CHUNK];
+    uint32_t ref = 0;
+    uint32_t to64 = 0;
+    uint32_t to32 = 0;
+
+    for (uint32_t base = 0; base <= UINT16_MAX; base += F16_CHUNK) {
+        for (int i = 0; i < F16_CHUNK; i++) {
+            in[i] = base + i;
+        }
+
+        uint32_t t0 = k_cycle_get_32();
+
+        for (int i = 0; i < F16_CHUNK; i++) {
+            out64[i] = uint16_to_double_ref(in[i]);
+        }
+
+        uint32_t t1 = k_cycle_get_32();
+
+        float16_to_double_n(in, out64, F16_CHUNK);
+
+        uint32_t t2 = k_cycle_get_32();
+
+        float16_to_float_n(in, out32, F16_CHUNK);
+
+        uint32_t t3 = k_cycle_get_32();
+
+        ref += t1 - t0;
+        to64 += t2 - t1;
+        to32 += t3 - t2;
+    }
+
+    BENCH_REPORT("uint16_to_double_ldexp", ref / (UINT16_MAX + 1), "cycles/value");
+    BENCH_REPORT("float16_to_double", to64 / (UINT16_MAX + 1), "cycles/value");
+    BENCH_REPORT("float16_to_float", to32 / (UINT16_MAX + 1), "cycles/value");
+}
+#endif /* CONFIG_SAMPLE_FORMAT_LEGACY */
+
+
+/******************************************************************************
+ * IMU codec
+ ******************************************************************************/
+
+#if defined(CONFIG_IMU_CODEC)
+/**
+ * @brief Step a sample to the next one of a slowly changing signal.
+ *
+ * @param sample Previous sample, becomes the next one.
+ * @param rng    Generator state.
+ */
+static void codec_walk(sensor_sample_t *sample, uint32_t *rng)
+{
+    sample->hdr.seq++;
+    sample->hdr.timestamp += 5;
+
+    for (int i = 0; i < IMU_SAMPLE_LEN; i++) {
+        int32_t step = (int32_t)(bench_rand(rng) % (2 * CODEC_WALK_STEP + 1)) - CODEC_WALK_STEP;
+
+        sample->imu[i] = (sample->imu[i] + step) & BENCH_IMU_MASK;
+    }
+}
+
+/**
+ * @brief Encode and decode a stream, reporting bytes per sample.
+ *
+ * @param name Result name.
+ * @param walk true for a random-walk signal, false for white noise.
+ */
+static void codec_round_trip(const char *name, bool walk)
+{
+    static uint8_t rec[IMU_CODEC_MAX_LEN];
+    imu_codec_t enc;
+    imu_codec_t dec;
+    sensor_sample_t sample;
+    sensor_sample_t decoded;
+    uint32_t rng = 0x85ebca6b;
+    uint32_t bytes = 0;
+    uint32_t cycles = 0;
+
+    imu_codec_reset(&enc);
+    imu_codec_reset(&dec);
+    bench_sample_fill(&sample, 0, &rng);
+
+    for (int i = 0; i < CODEC_SAMPLES; i++) {
+        if (walk) {
+            codec_walk(&sample, &rng);
+        } else {
+            bench_sample_fill(&sample, i, &rng);
+        }
+
+        uint32_t t0 = k_cycle_get_32();
+        size_t len = imu_codec_encode(&enc, &sample, rec, sizeof(rec));
+
+        cycles += k_cycle_get_32() - t0;
+        zassert_true(len > 0 && len <= IMU_CODEC_MAX_LEN, "record %d has length %u",
+                     i, (unsigned int)len);
+
+        size_t used;
+
+        zassert_equal(imu_codec_decode(&dec, rec, len, &decoded, &used), 0,
+                      "record %d does not decode", i);
+        zassert_equal(used, len, "record %d decoded %u of %u bytes", i,
+                      (unsigned int)used, (unsigned int)len);
+        zassert_mem_equal(&decoded, &sample, SAMPLE_WIRE_LEN, "record %d differs", i);
+        bytes += len;
+    }
+
+    TC_PRINT("%s: %u samples, %u bytes raw, %u bytes encoded\n", name, CODEC_SAMPLES,
+             (unsigned int)(CODEC_SAMPLES * SAMPLE_WIRE_LEN), bytes);
+    BENCH_REPORT(name, bytes * 100 / CODEC_SAMPLES, "bytes/100 samples");
+    BENCH_REPORT("imu_codec_encode", cycles / CODEC_SAMPLES, "cycles/sample");
+}
+
+/**
+ * @brief Slowly changing IMU data compresses well below the raw size.
+ */
+ZTEST(codec, test_imu_codec_walk)
+{
+    codec_round_trip("imu_codec_walk", true);
+}
+
+/**
+ * @brief White noise still round-trips within the worst-case record size.
+ */
+ZTEST(codec, test_imu_codec_noise)
+{
+    codec_round_trip("imu_codec_noise", false);
+}
+
+/**
+ * @brief Truncated records are rejected, random bytes never overrun.
+ */
+ZTEST(codec, test_imu_codec_fuzz)
+{
+    static uint8_t rec[IMU_CODEC_MAX_LEN];
+    imu_codec_t enc;
+    imu_codec_t dec;
+    sensor_sample_t sample;
+    sensor_sample_t decoded;
+    uint32_t rng = 0xc2b2ae35;
+    size_t used;
+
+    /* Every strict prefix of a keyframe is malformed */
+    imu_codec_reset(&enc);
+    bench_sample_fill(&sample, 0, &rng);
+    size_t len = imu_codec_encode(&enc, &sample, rec, sizeof(rec));
+
+    for (size_t cut = 0; cut < len; cut++) {
+        imu_codec_reset(&dec);
+        zassert_equal(imu_codec_decode(&dec, rec, cut, &decoded, &used), -EINVAL,
+                      "%u of %u bytes accepted", (unsigned int)cut, (unsigned int)len);
+    }
+
+    /* Random input either decodes inside its bounds or is refused */
+    for (int run = 0; run < CODEC_FUZZ_RUNS; run++) {
+        len = bench_rand(&rng) % sizeof(rec);
+        for (size_t i = 0; i < len; i++) {
+            rec[i] = bench_rand(&rng);
+        }
+
+        imu_codec_reset(&dec);
+        /* Half of the runs decode deltas against a synced decoder */
+        if (run & 1) {
+            dec.synced = true;
+        }
+
+        int err = imu_codec_decode(&dec, rec, len, &decoded, &used);
+
+        zassert_true(err == 0 || err == -EAGAIN || err == -EINVAL, "err %d", err);
+        if (err == 0) {
+            zassert_true(used <= len, "used %u of %u bytes", (unsigned int)used,
+                         (unsigned int)len);
+        }
+    }
+}
+#endif /* CONFIG_IMU_CODEC */
+
+ZTEST_SUITE(codec, NULL, NULL, NULL, NULL, NULL);
@@ -0,0 +1,190 @@
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+#include "bench.h"
+#include "imu_kernels.h"
+
+
+/******************************************************************************
+ * Macro
+ ******************************************************************************/
+
+#define KERNEL_SAMPLES 4096
+
+/* Most channels the schema's IMU block splits into */
+#define KERNEL_CHANNELS \
+    ((IMU_SAMPLE_LEN % 4 == 0) ? 4 : (IMU_SAMPLE_LEN % 2 == 0) ? 2 : 1)
+
+
+/******************************************************************************
+ * Static Variables
+ ******************************************************************************/
+
+static sensor_sample_t blocks[KERNEL_SAMPLES];
+
+
+/******************************************************************************
+ * Helpers
+ ******************************************************************************/
+
+/**
+ * @brief Fill the blocks with random readings, a few at the range ends.
+ */
+static void *kernels_setup(void)
+{
+    uint32_t rng = 0x27d4eb2f;
+
+    for (int i = 0; i < KERNEL_SAMPLES; i++) {
+        bench_sample_fill(&blocks[i], i, &rng);
+    }
+
+    /* Largest steps either way, and flat blocks at both ends */
+    for (int i = 0; i < IMU_SAMPLE_LEN; i++) {
+        blocks[0].imu[i] = 0;
+        blocks[1].imu[i] = BENCH_IMU_MASK;
+        blocks[2].imu[i] = 0;
+        blocks[3].imu[i] = (i & 1) ? BENCH_IMU_MASK : 0;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief The 32-bit zigzag delta the codec used before the kernels.
+ */
+static uint32_t delta_ref(uint32_t cur, uint32_t prev)
+{
+    int32_t v = (int32_t)(cur - prev);
+
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+/**
+ * @brief Check a reduction against a plain per-reading loop.
+ *
+ * @param st       Kernel result.
+ * @param imu      Its input.
+ * @param channels Channel count it ran with.
+ * @param name     Kernel name for the failure message.
+ */
+static void reduce_check(const imu_kernel_stats_t *st, const sample_imu_t *imu, int channels,
+                         const char *name)
+{
+    for (int c = 0; c < channels; c++) {
+        uint32_t min = UINT32_MAX;
+        uint32_t max = 0;
+        uint32_t sum = 0;
+        uint32_t sumsq = 0;
+
+        for (int i = c; i < IMU_SAMPLE_LEN; i += channels) {
+            min = MIN(min, imu[i]);
+            max = MAX(max, imu[i]);
+            sum += imu[i];
+            sumsq += (uint32_t)imu[i] * imu[i];
+        }
+
+        zassert_equal(st->min[c], min, "%s: channel %d/%d min", name, c, channels);
+        zassert_equal(st->max[c], max, "%s: channel %d/%d max", name, c, channels);
+        zassert_equal(st->sum[c], sum, "%s: channel %d/%d sum", name, c, channels);
+        zassert_equal(st->sumsq[c], sumsq, "%s: channel %d/%d sumsq", name, c, channels);
+    }
+}
+
+
+/******************************************************************************
+ * Tests
+ ******************************************************************************/
+
+/**
+ * @brief Both delta kernels match the 32-bit zigzag of 12-bit readings.
+ */
+ZTEST(kernels, test_delta)
+{
+    uint16_t scalar[IMU_SAMPLE_LEN];
+    uint16_t zz[IMU_SAMPLE_LEN];
+
+    for (int s = 1; s < KERNEL_SAMPLES; s++) {
+        const sample_imu_t *cur = blocks[s].imu;
+        const sample_imu_t *prev = blocks[s - 1].imu;
+
+        imu_kernel_delta_scalar(scalar, cur, prev);
+        imu_kernel_delta(zz, cur, prev);
+
+        for (int i = 0; i < IMU_SAMPLE_LEN; i++) {
+            uint32_t ref = delta_ref(cur[i], prev[i]);
+
+            zassert_equal(scalar[i], ref, "sample %d word %d: scalar %u, expected %u",
+                          s, i, scalar[i], ref);
+            zassert_equal(zz[i], ref, "sample %d word %d: %u, expected %u", s, i, zz[i], ref);
+        }
+    }
+}
+
+/**
+ * @brief Both reduction kernels match a plain loop for every channel count.
+ */
+ZTEST(kernels, test_reduce)
+{
+    static const int channel_counts[] = { 1, 2, 3, 4 };
+    imu_kernel_stats_t st;
+
+    for (size_t n = 0; n < ARRAY_SIZE(channel_counts); n++) {
+        int channels = channel_counts[n];
+
+        if (IMU_SAMPLE_LEN % channels) {
+            continue;
+        }
+
+        for (int s = 0; s < KERNEL_SAMPLES; s++) {
+            imu_kernel_reduce_scalar(&st, blocks[s].imu, channels);
+            reduce_check(&st, blocks[s].imu, channels, "scalar");
+            imu_kernel_reduce(&st, blocks[s].imu, channels);
+            reduce_check(&st, blocks[s].imu, channels, "selected");
+        }
+    }
+}
+
+/**
+ * @brief Cycles per sample of the scalar and, where built, the SIMD kernels.
+ */
+ZTEST(kernels, test_kernels_bench)
+{
+    uint16_t zz[IMU_SAMPLE_LEN];
+    imu_kernel_stats_t st;
+    uint32_t t0 = k_cycle_get_32();
+
+    for (int s = 1; s < KERNEL_SAMPLES; s++) {
+        imu_kernel_delta_scalar(zz, blocks[s].imu, blocks[s - 1].imu);
+    }
+
+    uint32_t t1 = k_cycle_get_32();
+
+    for (int s = 0; s < KERNEL_SAMPLES; s++) {
+        imu_kernel_reduce_scalar(&st, blocks[s].imu, KERNEL_CHANNELS);
+    }
+
+    uint32_t t2 = k_cycle_get_32();
+
+    BENCH_REPORT("kernel_delta_scalar", (t1 - t0) / (KERNEL_SAMPLES - 1), "cycles/sample");
+    BENCH_REPORT("kernel_reduce_scalar", (t2 - t1) / KERNEL_SAMPLES, "cycles/sample");
+
+#if IMU_KERNEL_SIMD
+    t0 = k_cycle_get_32();
+
+    for (int s = 1; s < KERNEL_SAMPLES; s++) {
+        imu_kernel_delta_simd(zz, blocks[s].imu, blocks[s - 1].imu);
+    }
+
+    t1 = k_cycle_get_32();
+
+    for (int s = 0; s < KERNEL_SAMPLES; s++) {
+        imu_kernel_reduce_simd(&st, blocks[s].imu, KERNEL_CHANNELS);
+    }
+
+    t2 = k_cycle_get_32();
+
+    BENCH_REPORT("kernel_delta_simd", (t1 - t0) / (KERNEL_SAMPLES - 1), "cycles/sample");
+    BENCH_REPORT("kernel_reduce_simd", (t2 - t1) / KERNEL_SAMPLES, "cycles/sample");
+#endif /* IMU_KERNEL_SIMD */
+}
+
+ZTEST_SUITE(kernels, NULL, kernels_setup, NULL, NULL, NULL);
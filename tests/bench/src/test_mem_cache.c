@@ -0,0 +1,472 @@
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+#include "bench.h"
+#include "mem_cache.h"
+
+
+/******************************************************************************
+ * Macro
+ ******************************************************************************/
+
+/* Upper bound of the samples the cache can hold */
+#if defined(CONFIG_MEM_CACHE_BACKEND_ARENA)
+#define CACHE_MAX_SAMPLES (CONFIG_CACHE_ARENA_SIZE / sizeof(sensor_sample_t))
+#elif defined(CONFIG_MEM_CACHE_BACKEND_SLAB)
+#define CACHE_MAX_SAMPLES (CONFIG_CACHE_MAX_BLOCKS * CONFIG_CACHE_BLOCK_SAMPLES)
+#else
+#define CACHE_MAX_SAMPLES CONFIG_CACHE_SIZE
+#endif /* CONFIG_MEM_CACHE_BACKEND_ARENA */
+
+#define FUZZ_OPS        20000
+#define FUZZ_MAX_BURST  8
+
+#define STRESS_SAMPLES      20000
+#define STRESS_MAX_PUSH     16   /* Producer bursts are up to twice the consumer's, */
+#define STRESS_MAX_POP      8    /* so the cache overflows now and then */
+#define STRESS_STACK_SIZE   2048
+#define STRESS_PRIORITY     K_PRIO_PREEMPT(1)
+
+
+/******************************************************************************
+ * Data Types
+ ******************************************************************************/
+
+/* What a consumer has seen so far */
+typedef struct {
+    bool synced;         /* last_seq is valid */
+    uint32_t last_seq;   /* Last sequence number taken from the cache */
+    uint32_t taken;      /* Samples taken from the cache */
+} order_check_t;
+
+#if defined(CONFIG_MEM_CACHE_OVERFLOW_REJECT)
+/* Sequence numbers the cache must hold, oldest first. Only exact for the
+ * reject policy, the others discard from the old end. */
+typedef struct {
+    uint32_t seq[CACHE_MAX_SAMPLES + 1];
+    size_t head;
+    size_t n;
+} cache_model_t;
+#endif /* CONFIG_MEM_CACHE_OVERFLOW_REJECT */
+
+
+/******************************************************************************
+ * Static Variables
+ ******************************************************************************/
+
+#if defined(CONFIG_MEM_CACHE_OVERFLOW_REJECT)
+static cache_model_t model;
+#endif /* CONFIG_MEM_CACHE_OVERFLOW_REJECT */
+
+static sensor_sample_t burst[MAX(FUZZ_MAX_BURST, STRESS_MAX_PUSH)];
+static sensor_sample_t popped[MAX(FUZZ_MAX_BURST, STRESS_MAX_POP)];
+
+K_THREAD_STACK_DEFINE(producer_stack, STRESS_STACK_SIZE);
+K_THREAD_STACK_DEFINE(consumer_stack, STRESS_STACK_SIZE);
+static struct k_thread producer_thread;
+static struct k_thread consumer_thread;
+static atomic_t producer_done;
+static order_check_t consumer_order;
+static uint32_t consumer_errors;   /* Out-of-order samples, asserted by the test thread */
+
+
+/******************************************************************************
+ * Helpers
+ ******************************************************************************/
+
+/**
+ * @brief Record that the cache accepted a sample.
+ *
+ * @param seq Sequence number of the sample.
+ */
+static void model_push(uint32_t seq)
+{
+#if defined(CONFIG_MEM_CACHE_OVERFLOW_REJECT)
+    zassert_true(model.n < ARRAY_SIZE(model.seq), "cache holds more than it can");
+    model.seq[(model.head + model.n) % ARRAY_SIZE(model.seq)] = seq;
+    model.n++;
+#else
+    ARG_UNUSED(seq);
+#endif /* CONFIG_MEM_CACHE_OVERFLOW_REJECT */
+}
+
+/**
+ * @brief Check a sample leaving the cache.
+ *
+ * Under every policy samples leave in push order, without duplicates.
+ *
+ * @param order The consumer's history.
+ * @param seq   Sequence number of the sample.
+ * @return true if @p seq is newer than anything taken before.
+ */
+static bool order_take(order_check_t *order, uint32_t seq)
+{
+    bool ok = !order->synced || (int32_t)(seq - order->last_seq) > 0;
+
+    order->synced = true;
+    order->last_seq = seq;
+    order->taken++;
+
+    return ok;
+}
+
+/**
+ * @brief Check a sample popped by the fuzz test.
+ *
+ * Under the reject policy it must also be exactly the oldest one accepted.
+ *
+ * @param order The fuzz consumer's history.
+ * @param seq   Sequence number of the sample.
+ */
+static void fuzz_take(order_check_t *order, uint32_t seq)
+{
+    uint32_t last = order->last_seq;
+
+    zassert_true(order_take(order, seq), "seq %u after %u", seq, last);
+
+#if defined(CONFIG_MEM_CACHE_OVERFLOW_REJECT)
+    zassert_true(model.n > 0, "cache returned seq %u while empty", seq);
+    zassert_equal(model.seq[model.head], seq, "expected seq %u, got %u",
+                  model.seq[model.head], seq);
+    model.head = (model.head + 1) % ARRAY_SIZE(model.seq);
+    model.n--;
+#endif /* CONFIG_MEM_CACHE_OVERFLOW_REJECT */
+}
+
+/**
+ * @brief Reset the cache and the model before a test.
+ */
+static void mem_cache_before(void *fixture)
+{
+    ARG_UNUSED(fixture);
+
+    bench_cache_drain();
+#if defined(CONFIG_MEM_CACHE_OVERFLOW_REJECT)
+    model.head = 0;
+    model.n = 0;
+#endif /* CONFIG_MEM_CACHE_OVERFLOW_REJECT */
+}
+
+
+/******************************************************************************
+ * Fuzz test
+ ******************************************************************************/
+
+/**
+ * @brief Random mix of every producer and consumer call on one thread.
+ *
+ * Checks ordering after each call and, at the end, that every pushed
+ * sample was either popped or counted as lost.
+ */
+ZTEST(mem_cache, test_fuzz)
+{
+    order_check_t order = {0};
+    uint32_t rng = 0x2545f491;
+    uint32_t lost = bench_cache_lost();
+    uint32_t seq = 0;
+
+    for (int op = 0; op < FUZZ_OPS; op++) {
+        size_t n = 1 + bench_rand(&rng) % FUZZ_MAX_BURST;
+        const sensor_sample_t *sample;
+        sensor_sample_t *slot;
+
+        switch (bench_rand(&rng) % 6) {
+        case 0:
+            bench_sample_fill(&burst[0], seq, &rng);
+            if (mem_cache_push(&burst[0])) {
+                model_push(seq);
+            }
+            seq++;
+            break;
+        case 1:
+            for (size_t i = 0; i < n; i++) {
+                bench_sample_fill(&burst[i], seq + i, &rng);
+            }
+            /* Under the reject policy the accepted part is a prefix */
+            for (size_t i = 0, pushed = mem_cache_push_n(burst, n); i < pushed; i++) {
+                model_push(seq + i);
+            }
+            seq += n;
+            break;
+        case 2:
+            if (mem_cache_pop(&popped[0])) {
+                fuzz_take(&order, popped[0].hdr.seq);
+            }
+            break;
+        case 3:
+            n = mem_cache_pop_n(popped, n);
+            for (size_t i = 0; i < n; i++) {
+                fuzz_take(&order, popped[i].hdr.seq);
+            }
+            break;
+        case 4:
+            /* Zero-copy consumer path, as used by the TX engine */
+            mem_cache_pin();
+            n = MIN(n, mem_cache_count());
+            for (size_t i = 0; i < n; i++) {
+                zassert_true(mem_cache_peek_at(i, &sample), "peek_at(%u) failed", (unsigned int)i);
+                zassert_true(IS_ALIGNED(sample, __alignof__(sensor_sample_t)),
+                             "peek_at(%u) misaligned", (unsigned int)i);
+                fuzz_take(&order, sample->hdr.seq);
+            }
+            zassert_false(mem_cache_peek_at(mem_cache_count(), &sample),
+                          "peek_at past the newest sample");
+            mem_cache_commit_pop_n(n);
+            mem_cache_unpin();
+            break;
+        case 5:
+            slot = mem_cache_reserve();
+            if (slot) {
+                bench_sample_fill(slot, seq, &rng);
+                mem_cache_commit_push();
+                model_push(seq);
+            } else {
+                /* Counted as lost, like a rejected push */
+                zassert_true(mem_cache_count() > 0, "reserve failed on an empty cache");
+            }
+            seq++;
+            break;
+        }
+
+        zassert_true(mem_cache_count() <= CACHE_MAX_SAMPLES, "count %u over capacity",
+                     (unsigned int)mem_cache_count());
+#if defined(CONFIG_MEM_CACHE_OVERFLOW_REJECT)
+        zassert_equal(mem_cache_count(), model.n, "count %u, model %u",
+                      (unsigned int)mem_cache_count(), (unsigned int)model.n);
+#endif /* CONFIG_MEM_CACHE_OVERFLOW_REJECT */
+    }
+
+    while (mem_cache_pop(&popped[0])) {
+        fuzz_take(&order, popped[0].hdr.seq);
+    }
+
+    lost = bench_cache_lost() - lost;
+    zassert_equal(order.taken + lost, seq, "%u popped + %u lost != %u pushed",
+                  order.taken, lost, seq);
+}
+
+
+/******************************************************************************
+ * Producer/consumer stress test
+ ******************************************************************************/
+
+/**
+ * @brief Push STRESS_SAMPLES in random bursts, yielding after each.
+ */
+static void stress_producer(void *p1, void *p2, void *p3)
+{
+    uint32_t rng = 0x9e3779b9;
+    uint32_t seq = 0;
+
+    while (seq < STRESS_SAMPLES) {
+        /* MIN() evaluates its arguments twice, draw the size first */
+        size_t n = 1 + bench_rand(&rng) % STRESS_MAX_PUSH;
+
+        n = MIN(n, STRESS_SAMPLES - seq);
+
+        for (size_t i = 0; i < n; i++) {
+            bench_sample_fill(&burst[i], seq++, &rng);
+        }
+        if (n == 1) {
+            mem_cache_push(&burst[0]);
+        } else {
+            mem_cache_push_n(burst, n);
+        }
+        k_yield();
+    }
+
+    atomic_set(&producer_done, 1);
+}
+
+/**
+ * @brief Take samples in random bursts until the producer is done.
+ *
+ * Alternates between copying pops and the pinned zero-copy path, so the
+ * overflow policy runs against a pinned cache too.
+ */
+static void stress_consumer(void *p1, void *p2, void *p3)
+{
+    uint32_t rng = 0x7f4a7c15;
+
+    while (!atomic_get(&producer_done) || mem_cache_count()) {
+        size_t n = 1 + bench_rand(&rng) % STRESS_MAX_POP;
+
+        if (bench_rand(&rng) & 1) {
+            n = mem_cache_pop_n(popped, n);
+            for (size_t i = 0; i < n; i++) {
+                consumer_errors += !order_take(&consumer_order, popped[i].hdr.seq);
+            }
+        } else {
+            const sensor_sample_t *sample;
+            size_t i = 0;
+
+            mem_cache_pin();
+            while (i < n && mem_cache_peek_at(i, &sample)) {
+                consumer_errors += !order_take(&consumer_order, sample->hdr.seq);
+                i++;
+                /* Let the producer run into the pin */
+                k_yield();
+            }
+            mem_cache_commit_pop_n(i);
+            mem_cache_unpin();
+        }
+        k_yield();
+    }
+}
+
+/**
+ * @brief Run a producer and a consumer thread against each other.
+ *
+ * Every sample must come out in order or be accounted for by the
+ * overflow counters.
+ */
+ZTEST(mem_cache, test_stress)
+{
+    uint32_t lost = bench_cache_lost();
+
+    consumer_order = (order_check_t){0};
+    consumer_errors = 0;
+    atomic_set(&producer_done, 0);
+
+    uint32_t start = k_cycle_get_32();
+
+    k_thread_create(&consumer_thread, consumer_stack, K_THREAD_STACK_SIZEOF(consumer_stack),
+                    stress_consumer, NULL, NULL, NULL, STRESS_PRIORITY, 0, K_NO_WAIT);
+    k_thread_create(&producer_thread, producer_stack, K_THREAD_STACK_SIZEOF(producer_stack),
+                    stress_producer, NULL, NULL, NULL, STRESS_PRIORITY, 0, K_NO_WAIT);
+    k_thread_join(&producer_thread, K_FOREVER);
+    k_thread_join(&consumer_thread, K_FOREVER);
+
+    uint32_t cycles = k_cycle_get_32() - start;
+
+    lost = bench_cache_lost() - lost;
+    zassert_equal(consumer_errors, 0, "%u samples out of order", consumer_errors);
+    zassert_equal(consumer_order.taken + lost, STRESS_SAMPLES,
+                  "%u consumed + %u lost != %u produced",
+                  consumer_order.taken, lost, STRESS_SAMPLES);
+
+    BENCH_REPORT("stress_cycles_per_sample", cycles / STRESS_SAMPLES, "cycles");
+    BENCH_REPORT("stress_lost", lost, "samples");
+}
+
+#if defined(CONFIG_MEM_CACHE_ALERT)
+/******************************************************************************
+ * Alert stream
+ ******************************************************************************/
+
+/**
+ * @brief Alerts come out by sequence number, the oldest dropped when full.
+ *
+ * Starts close to the 32-bit wrap, so every cursor comparison crosses it.
+ */
+ZTEST(mem_cache, test_alert)
+{
+    const uint32_t first = UINT32_MAX - 2;
+    const size_t pushed = CONFIG_MEM_CACHE_ALERT_SIZE + 2;
+    sensor_sample_t alert = {0};
+    static sensor_sample_t out[CONFIG_MEM_CACHE_ALERT_SIZE + 1];
+
+    for (size_t i = 0; i < pushed; i++) {
+        alert.hdr.seq = first + i;
+        zassert_equal(mem_cache_alert_push(&alert), i < CONFIG_MEM_CACHE_ALERT_SIZE,
+                      "push %u: wrong loss report", (unsigned int)i);
+    }
+    zassert_equal(mem_cache_alert_count(), CONFIG_MEM_CACHE_ALERT_SIZE, "ring not full");
+
+    /* A new consumer gets everything held, oldest first */
+    size_t n = mem_cache_alert_peek(false, 0, out, ARRAY_SIZE(out));
+
+    zassert_equal(n, CONFIG_MEM_CACHE_ALERT_SIZE, "got %u alerts", (unsigned int)n);
+    for (size_t i = 0; i < n; i++) {
+        zassert_equal(out[i].hdr.seq, (uint32_t)(first + 2 + i), "alert %u: seq %u",
+                      (unsigned int)i, out[i].hdr.seq);
+    }
+
+    /* A synced consumer only what is newer than its last alert */
+    uint32_t last = (uint32_t)(first + pushed - 2);
+
+    n = mem_cache_alert_peek(true, last, out, ARRAY_SIZE(out));
+    zassert_equal(n, 1, "got %u alerts after seq %u", (unsigned int)n, last);
+    zassert_equal(out[0].hdr.seq, last + 1, "seq %u after %u", out[0].hdr.seq, last);
+    zassert_equal(mem_cache_alert_peek(true, last + 1, out, ARRAY_SIZE(out)), 0,
+                  "alert newer than the newest");
+
+    mem_cache_alert_release(last);
+    zassert_equal(mem_cache_alert_count(), 1, "release went past seq %u", last);
+    mem_cache_alert_release(last + 1);
+    zassert_equal(mem_cache_alert_count(), 0, "alerts left after the last release");
+}
+#endif /* CONFIG_MEM_CACHE_ALERT */
+
+#if defined(CONFIG_MEM_CACHE_BACKEND_SLAB)
+/******************************************************************************
+ * Runtime capacity
+ ******************************************************************************/
+
+/**
+ * @brief Push @p n fresh samples, one at a time.
+ *
+ * @param n   Number of samples.
+ * @param rng Generator state.
+ */
+static void resize_push(size_t n, uint32_t *rng)
+{
+    static uint32_t seq;
+
+    for (size_t i = 0; i < n; i++) {
+        bench_sample_fill(&burst[0], seq++, rng);
+        mem_cache_push(&burst[0]);
+    }
+}
+
+/**
+ * @brief The cache grows up to its capacity and hands drained blocks back.
+ *
+ * Blocks other users hold stop it from growing, whatever its capacity.
+ */
+ZTEST(mem_cache, test_resize)
+{
+    static void *taken[CONFIG_CACHE_POOL_BLOCKS];
+    size_t min = mem_cache_capacity_min();
+    size_t max = mem_cache_capacity_max();
+    uint32_t rng = 0x9e3779b9;
+    size_t n = 0;
+
+    zassert_equal(mem_cache_set_capacity(min - 1), -EINVAL, "capacity below the minimum");
+    zassert_equal(mem_cache_set_capacity(max + 1), -EINVAL, "capacity above the maximum");
+
+    zassert_ok(mem_cache_set_capacity(min), "minimum capacity refused");
+    resize_push(min + 1, &rng);
+    zassert_true(mem_cache_count() <= min, "%u samples over a capacity of %u",
+                 (unsigned int)mem_cache_count(), (unsigned int)min);
+
+    /* Growing keeps what is cached and takes blocks as they fill */
+    zassert_ok(mem_cache_set_capacity(max), "maximum capacity refused");
+    resize_push(max - mem_cache_count(), &rng);
+    zassert_equal(mem_cache_count(), max, "%u samples at a capacity of %u",
+                  (unsigned int)mem_cache_count(), (unsigned int)max);
+    zassert_true(mem_cache_blocks() <= CONFIG_CACHE_MAX_BLOCKS + 1, "%u blocks held",
+                 (unsigned int)mem_cache_blocks());
+
+    /* Drained, only the kept blocks stay with the cache */
+    bench_cache_drain();
+    zassert_equal(mem_cache_blocks(), CONFIG_CACHE_MIN_BLOCKS, "%u blocks held once drained",
+                  (unsigned int)mem_cache_blocks());
+
+    while (n < ARRAY_SIZE(taken) && (taken[n] = mem_cache_pool_alloc(K_NO_WAIT)) != NULL) {
+        n++;
+    }
+    zassert_equal(n, CONFIG_CACHE_POOL_BLOCKS - CONFIG_CACHE_MIN_BLOCKS,
+                  "%u pool blocks free", (unsigned int)n);
+
+    resize_push(max, &rng);
+    zassert_true(mem_cache_count() <= min, "%u samples in %u kept blocks",
+                 (unsigned int)mem_cache_count(), CONFIG_CACHE_MIN_BLOCKS);
+
+    while (n) {
+        mem_cache_pool_free(taken[--n]);
+    }
+    bench_cache_drain();
+}
+#endif /* CONFIG_MEM_CACHE_BACKEND_SLAB */
+
+ZTEST_SUITE(mem_cache, NULL, NULL, mem_cache_before, NULL, NULL);